@@ -0,0 +1,296 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <actor.h>
+#include <bench.h>
+#include <noc.h>
+
+/**
+ * @brief Default number of messages per test.
+ */
+#define NMESSAGES 10000
+
+/**
+ * @brief Default message size (in bytes).
+ */
+#define MESSAGE_SIZE 16
+
+/**
+ * @brief Messages sent by a streamer before yielding.
+ */
+#define BURST 64
+
+/**
+ * @name Behaviours.
+ */
+/**@{*/
+#define PONG   0 /**< Echoes messages back.             */
+#define PING   1 /**< Drives a ping-pong test.          */
+#define SINK   2 /**< Counts messages.                  */
+#define STREAM 3 /**< Drives a one-way streaming test.  */
+/**@}*/
+
+/**
+ * @brief Spawn argument of the test drivers.
+ */
+struct driver_arg
+{
+	actor_t peer; /**< Pong or sink actor. */
+	long count;   /**< Messages to send.   */
+};
+
+/**
+ * @brief State of the test drivers.
+ */
+struct driver
+{
+	actor_t peer;   /**< Pong or sink actor.  */
+	long remaining; /**< Messages to go.      */
+};
+
+/**
+ * @brief State of a sink.
+ */
+struct sink
+{
+	long expected; /**< Messages expected. */
+	long got;      /**< Messages received. */
+};
+
+/**
+ * @brief Message size.
+ */
+static long msgsize;
+
+/**
+ * @brief Message payload.
+ */
+static char payload[ACTOR_MSG_MAX];
+
+/**
+ * @brief Elapsed time of the last test (ns).
+ */
+static uint64_t t0, elapsed;
+
+/**
+ * @brief Ends a test.
+ */
+static void done(struct actor *self)
+{
+	elapsed = bench_now() - t0;
+	actor_exit(self);
+	actor_shutdown(0);
+}
+
+/**
+ * @brief Echoes messages back to their senders.
+ */
+static void pong(struct actor *self, actor_t from, const void *msg, size_t len)
+{
+	if (from == ACTOR_NONE)
+		return;
+
+	if (len == 0)
+	{
+		actor_exit(self);
+		return;
+	}
+
+	actor_send(actor_self(self), from, msg, len);
+}
+
+/**
+ * @brief Sends a message and waits for the echo, count times.
+ */
+static void ping(struct actor *self, actor_t from, const void *msg, size_t len)
+{
+	struct driver *d = actor_state(self);
+
+	if (from == ACTOR_NONE)
+	{
+		const struct driver_arg *arg = msg;
+
+		d->peer = arg->peer;
+		d->remaining = arg->count;
+		t0 = bench_now();
+	}
+	else if (--d->remaining == 0)
+	{
+		actor_send(actor_self(self), d->peer, NULL, 0);
+		done(self);
+		return;
+	}
+
+	actor_send(actor_self(self), d->peer, payload, msgsize);
+}
+
+/**
+ * @brief Counts messages and reports back once all have arrived.
+ */
+static void sink(struct actor *self, actor_t from, const void *msg, size_t len)
+{
+	struct sink *s = actor_state(self);
+
+	if (from == ACTOR_NONE)
+	{
+		memcpy(&s->expected, msg, sizeof(long));
+		return;
+	}
+
+	if (++s->got == s->expected)
+	{
+		actor_send(actor_self(self), from, NULL, 0);
+		actor_exit(self);
+	}
+}
+
+/**
+ * @brief Streams count messages to a sink.
+ *
+ * @details Sends in bursts and messages itself in between, so that it
+ * never holds the scheduler for long.
+ */
+static void stream(struct actor *self, actor_t from, const void *msg, size_t len)
+{
+	struct driver *d = actor_state(self);
+
+	if (from == ACTOR_NONE)
+	{
+		const struct driver_arg *arg = msg;
+
+		d->peer = arg->peer;
+		d->remaining = arg->count;
+		t0 = bench_now();
+	}
+	else if (from == d->peer)
+	{
+		done(self);
+		return;
+	}
+
+	for (int i = 0; (i < BURST) && (d->remaining > 0); i++, d->remaining--)
+		actor_send(actor_self(self), d->peer, payload, msgsize);
+
+	if (d->remaining > 0)
+		actor_send(actor_self(self), actor_self(self), NULL, 0);
+}
+
+/**
+ * @brief Runs one test.
+ *
+ * @returns Elapsed time in nanoseconds.
+ */
+static uint64_t run(int driver, int peer, int tile, long count)
+{
+	struct driver_arg arg;
+
+	arg.peer = actor_spawn(tile, peer, &count, sizeof(long));
+	arg.count = count;
+	if ((arg.peer == ACTOR_NONE) || (actor_spawn(noc_tile(), driver, &arg, sizeof(arg)) == ACTOR_NONE))
+	{
+		perror("actor_spawn");
+		exit(EXIT_FAILURE);
+	}
+
+	if (actor_run() < 0)
+	{
+		perror("actor_run");
+		exit(EXIT_FAILURE);
+	}
+
+	return (elapsed);
+}
+
+/**
+ * @brief Actor runtime benchmark.
+ *
+ * @details Usage: actorbench [messages] [size]
+ *
+ * Tile 0 measures ping-pong round trips and one-way streaming, first
+ * between two actors of its own (local mailboxes) and then against an
+ * actor on tile 1 (NoC). The other tiles just host actors.
+ */
+int main(int argc, char **argv)
+{
+	int ntests;
+	long count = bench_arg(argc, argv, 1, NMESSAGES);
+	struct actor_stats stats;
+
+	msgsize = bench_arg(argc, argv, 2, MESSAGE_SIZE);
+	if ((count < 1) || (msgsize < 1) || (msgsize > ACTOR_MSG_MAX))
+	{
+		fprintf(stderr, "usage: actorbench [messages] [size]\n");
+		return (EXIT_FAILURE);
+	}
+	memset(payload, 0x5a, msgsize);
+
+	if ((noc_init() < 0) || (actor_init() < 0))
+	{
+		perror("init");
+		return (EXIT_FAILURE);
+	}
+
+	actor_register(PONG, pong, 0);
+	actor_register(PING, ping, sizeof(struct driver));
+	actor_register(SINK, sink, sizeof(struct sink));
+	actor_register(STREAM, stream, sizeof(struct driver));
+
+	if (noc_tile() != 0)
+	{
+		if (actor_run() < 0)
+		{
+			perror("actor_run");
+			return (EXIT_FAILURE);
+		}
+	}
+	else
+	{
+		ntests = (noc_ntiles() > 1) ? 2 : 1;
+
+		for (int tile = 0; tile < ntests; tile++)
+		{
+			const char *where = (tile == 0) ? "local" : "remote";
+			uint64_t tping, tstream;
+
+			tping = run(PING, PONG, tile, count);
+			tstream = run(STREAM, SINK, tile, count);
+
+			printf("actor %s messages=%ld size=%ld pingpong_rtt_ns=%" PRIu64
+				" pingpong_msgs_per_sec=%" PRIu64 " stream_msgs_per_sec=%" PRIu64 "\n",
+				where, count, msgsize, tping/count,
+				(uint64_t)((2*count*1000000000ULL)/(tping + 1)),
+				(uint64_t)((count*1000000000ULL)/(tstream + 1)));
+		}
+
+		actor_shutdown(1);
+	}
+
+	actor_get_stats(&stats);
+	printf("actor tile=%d delivered=%" PRIu64 " local_sent=%" PRIu64 " remote_sent=%" PRIu64
+		" remote_recv=%" PRIu64 " dropped=%" PRIu64 "\n",
+		noc_tile(), stats.delivered, stats.local_sent, stats.remote_sent,
+		stats.remote_recv, stats.dropped);
+
+	noc_finalize();
+
+	return (EXIT_SUCCESS);
+}
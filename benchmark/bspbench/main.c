@@ -0,0 +1,188 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <bench.h>
+#include <bsp.h>
+
+/**
+ * @brief Default number of supersteps per measurement.
+ */
+#define NITERATIONS 100
+
+/**
+ * @brief Default number of words put to each peer.
+ */
+#define HWORDS 64
+
+/**
+ * @brief Runs supersteps and prints their average cost.
+ *
+ * @param name  Measurement name.
+ * @param niter Number of supersteps.
+ * @param fn    Communication issued in every superstep (optional).
+ */
+static int measure(const char *name, long niter, int (*fn)(long), long arg)
+{
+	uint64_t t0, t1;
+	struct bsp_stats s0, s1;
+
+	bsp_get_stats(&s0);
+	t0 = bench_now();
+	for (long i = 0; i < niter; i++)
+	{
+		if ((fn != NULL) && (fn(arg) < 0))
+			return (-1);
+		if (bsp_sync() < 0)
+			return (-1);
+	}
+	t1 = bench_now();
+	bsp_get_stats(&s1);
+
+	printf("bsp %s pid=%d nprocs=%d h=%ld superstep_us=%" PRIu64
+		" msgs_per_step=%" PRIu64 " bytes_per_step=%" PRIu64 "\n",
+		name, bsp_pid(), bsp_nprocs(), (fn != NULL) ? arg : 0,
+		(t1 - t0)/niter/1000, (s1.msgs_sent - s0.msgs_sent)/niter,
+		(s1.bytes_sent - s0.bytes_sent)/niter);
+
+	return (0);
+}
+
+/**
+ * @brief Source and destination arrays.
+ */
+static uint32_t *src, *dst;
+
+/**
+ * @brief All-to-all put of h words.
+ */
+static int alltoall_put(long h)
+{
+	for (int p = 0; p < bsp_nprocs(); p++)
+	{
+		if (bsp_put(p, src, dst, bsp_pid()*h*sizeof(uint32_t), h*sizeof(uint32_t)) < 0)
+			return (-1);
+	}
+
+	return (0);
+}
+
+/**
+ * @brief All-to-all put of h words, one word at a time.
+ */
+static int alltoall_put_words(long h)
+{
+	for (int p = 0; p < bsp_nprocs(); p++)
+	{
+		for (long i = 0; i < h; i++)
+		{
+			if (bsp_put(p, &src[i], dst, (bsp_pid()*h + i)*sizeof(uint32_t), sizeof(uint32_t)) < 0)
+				return (-1);
+		}
+	}
+
+	return (0);
+}
+
+/**
+ * @brief All-to-all get of h words.
+ */
+static int alltoall_get(long h)
+{
+	for (int p = 0; p < bsp_nprocs(); p++)
+	{
+		if (bsp_get(p, src, 0, &dst[p*h], h*sizeof(uint32_t)) < 0)
+			return (-1);
+	}
+
+	return (0);
+}
+
+/**
+ * @brief BSP superstep overhead benchmark.
+ *
+ * @details Usage: bspbench [niterations] [h]
+ */
+int main(int argc, char **argv)
+{
+	int errors = 0;
+	long niter = bench_arg(argc, argv, 1, NITERATIONS);
+	long h = bench_arg(argc, argv, 2, HWORDS);
+
+	if ((niter < 1) || (h < 1))
+	{
+		fprintf(stderr, "usage: bspbench [niterations] [h]\n");
+		return (EXIT_FAILURE);
+	}
+
+	if (bsp_begin() < 0)
+	{
+		perror("bsp_begin");
+		return (EXIT_FAILURE);
+	}
+
+	src = malloc(h*sizeof(uint32_t));
+	dst = calloc(h*bsp_nprocs(), sizeof(uint32_t));
+	if ((src == NULL) || (dst == NULL))
+	{
+		perror("malloc");
+		return (EXIT_FAILURE);
+	}
+	for (long i = 0; i < h; i++)
+		src[i] = ((uint32_t) bsp_pid() << 16) | i;
+
+	bsp_push_reg(src, h*sizeof(uint32_t));
+	bsp_push_reg(dst, h*bsp_nprocs()*sizeof(uint32_t));
+	bsp_sync();
+
+	if ((measure("empty", niter, NULL, 0) < 0) ||
+		(measure("put", niter, alltoall_put, h) < 0) ||
+		(measure("put-words", niter, alltoall_put_words, h) < 0) ||
+		(measure("get", niter, alltoall_get, h) < 0))
+	{
+		perror("bsp_sync");
+		return (EXIT_FAILURE);
+	}
+
+	/* Every tile should now hold every other tile's source. */
+	for (int p = 0; p < bsp_nprocs(); p++)
+	{
+		for (long i = 0; i < h; i++)
+		{
+			if (dst[p*h + i] != (((uint32_t) p << 16) | i))
+				errors++;
+		}
+	}
+
+	bsp_pop_reg(dst);
+	bsp_pop_reg(src);
+	bsp_end();
+
+	free(dst);
+	free(src);
+
+	if (errors > 0)
+	{
+		fprintf(stderr, "bspbench: %d wrong words\n", errors);
+		return (EXIT_FAILURE);
+	}
+
+	return (EXIT_SUCCESS);
+}
@@ -0,0 +1,257 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <bench.h>
+#include <noc.h>
+
+/**
+ * @brief Default file size (in KB).
+ */
+#define FILE_KB 4096
+
+/**
+ * @brief Scratch file (in the working directory).
+ */
+#define FILENAME "catbench.dat"
+
+/**
+ * @brief Transfer summary, sent back by the receiver.
+ */
+struct summary
+{
+	uint64_t bytes; /**< Bytes received. */
+	uint32_t sum;   /**< Checksum.       */
+};
+
+/**
+ * @brief Copy buffer.
+ */
+static uint8_t buf[NOC_SENDFILE_CHUNK];
+
+/**
+ * @brief Exits on error.
+ */
+static void die(const char *msg)
+{
+	perror(msg);
+	exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Updates a checksum (Adler-style, without the modulo).
+ */
+static uint32_t checksum(uint32_t sum, const uint8_t *p, size_t n)
+{
+	uint32_t a = sum & 0xffff, b = sum >> 16;
+
+	for (size_t i = 0; i < n; i++)
+	{
+		a = (a + p[i]) & 0xffff;
+		b = (b + a) & 0xffff;
+	}
+
+	return ((b << 16) | a);
+}
+
+/**
+ * @brief Creates the scratch file.
+ */
+static uint32_t make_file(long kb)
+{
+	int fd;
+	uint32_t seed = 0x9e3779b9u, sum = 0;
+
+	if ((fd = open(FILENAME, O_WRONLY | O_CREAT | O_TRUNC, 0600)) < 0)
+		die(FILENAME);
+
+	for (long i = 0; i < kb; i++)
+	{
+		for (int j = 0; j < 1024; j += 4)
+		{
+			uint32_t r = bench_rand(&seed);
+			memcpy(&buf[j], &r, 4);
+		}
+		sum = checksum(sum, buf, 1024);
+		if (write(fd, buf, 1024) != 1024)
+			die("write");
+	}
+
+	close(fd);
+
+	return (sum);
+}
+
+/**
+ * @brief Sends the scratch file.
+ */
+static void send_stream(int dest, int zerocopy)
+{
+	int fd;
+	ssize_t n;
+
+	if ((fd = open(FILENAME, O_RDONLY)) < 0)
+		die(FILENAME);
+
+	if (zerocopy)
+	{
+		while ((n = noc_sendfile(dest, NOC_PORT_CAT, fd, SIZE_MAX)) != 0)
+		{
+			if (n < 0)
+				die("noc_sendfile");
+		}
+	}
+	else
+	{
+		while ((n = read(fd, buf, sizeof(buf))) != 0)
+		{
+			if (n < 0)
+				die("read");
+			if (noc_send(dest, NOC_PORT_CAT, buf, n) < 0)
+				die("noc_send");
+		}
+	}
+
+	if (noc_send(dest, NOC_PORT_CAT, NULL, 0) < 0)
+		die("noc_send");
+
+	close(fd);
+}
+
+/**
+ * @brief Receives a stream.
+ */
+static void recv_stream(int *src, struct summary *s)
+{
+	int port;
+	void *data;
+	ssize_t len;
+
+	s->bytes = 0;
+	s->sum = 0;
+
+	while (1)
+	{
+		if ((len = noc_recv_buf(src, &port, &data)) < 0)
+			die("noc_recv_buf");
+
+		if (port == NOC_PORT_CAT)
+		{
+			if (len == 0)
+			{
+				noc_buf_free(data);
+				return;
+			}
+			s->bytes += len;
+			s->sum = checksum(s->sum, data, len);
+		}
+
+		noc_buf_free(data);
+	}
+}
+
+/**
+ * @brief Receives a summary.
+ */
+static void recv_summary(struct summary *s)
+{
+	int port;
+
+	do
+	{
+		if (noc_recv(NULL, &port, s, sizeof(struct summary)) < 0)
+			die("noc_recv");
+	} while (port != NOC_PORT_ANY);
+}
+
+/**
+ * @brief File transfer benchmark.
+ *
+ * @details Usage: catbench [kb]
+ *
+ * Tile 0 writes a scratch file and sends it to tile 1, first with a
+ * read/send copy loop and then with noc_sendfile(), which is what
+ * noccat uses. Tile 1 checksums the stream and sends a summary back.
+ * With a single tile, the file goes through the loopback path.
+ */
+int main(int argc, char **argv)
+{
+	int peer, src;
+	long kb = bench_arg(argc, argv, 1, FILE_KB);
+	static const char *methods[] = { "copy", "sendfile" };
+
+	if (kb < 1)
+	{
+		fprintf(stderr, "usage: catbench [kb]\n");
+		return (EXIT_FAILURE);
+	}
+
+	if (noc_init() < 0)
+		die("noc_init");
+
+	peer = (noc_ntiles() > 1) ? 1 : 0;
+
+	/* Receiver. */
+	if ((noc_tile() == 1) && (peer == 1))
+	{
+		for (int m = 0; m < 2; m++)
+		{
+			struct summary s;
+
+			recv_stream(&src, &s);
+			if (noc_send(src, NOC_PORT_ANY, &s, sizeof(s)) < 0)
+				die("noc_send");
+		}
+	}
+
+	/* Sender. */
+	else if (noc_tile() == 0)
+	{
+		uint32_t sum = make_file(kb);
+
+		for (int m = 0; m < 2; m++)
+		{
+			uint64_t t0, t;
+			struct summary s;
+
+			t0 = bench_now();
+			send_stream(peer, m);
+			if (peer == 0)
+				recv_stream(&src, &s);
+			else
+				recv_summary(&s);
+			t = bench_now() - t0;
+
+			printf("cat method=%s kb=%ld time_us=%" PRIu64 " kb_per_sec=%" PRIu64 " ok=%d\n",
+				methods[m], kb, t/1000, (uint64_t)((kb*1000000000ULL)/(t + 1)),
+				(s.bytes == (uint64_t) kb*1024) && (s.sum == sum));
+		}
+
+		unlink(FILENAME);
+	}
+
+	noc_finalize();
+
+	return (EXIT_SUCCESS);
+}
@@ -0,0 +1,152 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <bench.h>
+#include <ckpt.h>
+#include <noc.h>
+
+/**
+ * @brief Default largest state size (in KB).
+ */
+#define MAX_KB 4096
+
+/**
+ * @brief Percentage of chunks dirtied between checkpoints.
+ */
+#define DIRTY 10
+
+/**
+ * @brief Fills a buffer with pseudo-random words.
+ */
+static void fill(uint32_t *p, size_t nwords, uint32_t seed)
+{
+	for (size_t i = 0; i < nwords; i++)
+		p[i] = bench_rand(&seed);
+}
+
+/**
+ * @brief Checkpoint/restore benchmark.
+ *
+ * @details Usage: ckptbench [max_kb] [dirty%]
+ *
+ * Tile 1 runs the checkpoint server. Tile 0 doubles its state from
+ * 64 KB up to max_kb and, for each size, takes a full checkpoint,
+ * dirties some chunks, takes an incremental one, wipes its state and
+ * restores it, checking that it comes back intact.
+ */
+int main(int argc, char **argv)
+{
+	long maxkb = bench_arg(argc, argv, 1, MAX_KB);
+	long dirty = bench_arg(argc, argv, 2, DIRTY);
+	int errors = 0;
+
+	if ((maxkb < 64) || (dirty < 0) || (dirty > 100))
+	{
+		fprintf(stderr, "usage: ckptbench [max_kb] [dirty%%]\n");
+		return (EXIT_FAILURE);
+	}
+
+	if (noc_init() < 0)
+	{
+		perror("noc_init");
+		return (EXIT_FAILURE);
+	}
+
+	if (noc_ntiles() < 2)
+	{
+		fprintf(stderr, "ckptbench: needs two tiles\n");
+		noc_finalize();
+		return (EXIT_FAILURE);
+	}
+
+	if (noc_tile() == 1)
+	{
+		if (ckpt_serve() < 0)
+		{
+			perror("ckpt_serve");
+			return (EXIT_FAILURE);
+		}
+	}
+	else if (noc_tile() == 0)
+	{
+		for (long kb = 64; kb <= maxkb; kb *= 2)
+		{
+			size_t size = kb*1024;
+			size_t nchunks = size/CKPT_CHUNK;
+			uint32_t *state, *copy;
+			struct ckpt_stats full, incr, rest;
+			uint32_t seed = kb;
+			int ok;
+
+			if (((state = malloc(size)) == NULL) || ((copy = malloc(size)) == NULL))
+			{
+				perror("malloc");
+				return (EXIT_FAILURE);
+			}
+
+			fill(state, size/sizeof(uint32_t), seed);
+			ckpt_reset();
+			if ((ckpt_register(state, size) < 0) || (ckpt_save(1, CKPT_FULL, &full) < 0))
+			{
+				perror("ckpt_save");
+				return (EXIT_FAILURE);
+			}
+
+			/* Dirty one word in some chunks. */
+			for (size_t c = 0; c < (nchunks*dirty)/100; c++)
+				state[((bench_rand(&seed) % nchunks)*CKPT_CHUNK)/sizeof(uint32_t)]++;
+			if (ckpt_save(1, CKPT_INCREMENTAL, &incr) < 0)
+			{
+				perror("ckpt_save");
+				return (EXIT_FAILURE);
+			}
+
+			memcpy(copy, state, size);
+			memset(state, 0, size);
+			if (ckpt_restore(1, &rest) < 0)
+			{
+				perror("ckpt_restore");
+				return (EXIT_FAILURE);
+			}
+
+			ok = (memcmp(copy, state, size) == 0);
+			errors += !ok;
+
+			printf("ckpt kb=%ld full_us=%" PRIu64 " full_kb_per_sec=%" PRIu64
+				" incr_us=%" PRIu64 " incr_chunks=%" PRIu64 " incr_skipped=%" PRIu64
+				" restore_us=%" PRIu64 " restore_kb_per_sec=%" PRIu64 " ok=%d\n",
+				kb, full.time/1000, (uint64_t)((kb*1000000000ULL)/(full.time + 1)),
+				incr.time/1000, incr.chunks, incr.chunks_skipped,
+				rest.time/1000, (uint64_t)((kb*1000000000ULL)/(rest.time + 1)), ok);
+
+			free(copy);
+			free(state);
+		}
+
+		ckpt_reset();
+		ckpt_stop(1);
+	}
+
+	noc_finalize();
+
+	return ((errors == 0) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
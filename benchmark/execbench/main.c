@@ -0,0 +1,180 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/auxv.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <bench.h>
+
+/**
+ * @brief Default number of executions.
+ */
+#define EXECS 200
+
+/**
+ * @brief Compares two samples.
+ */
+static int cmp(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *) a;
+	uint64_t y = *(const uint64_t *) b;
+
+	return ((x > y) - (x < y));
+}
+
+/**
+ * @brief Reports the time from exec to main to the parent.
+ *
+ * @details Runs first thing in main of the executed image, so what is
+ * measured is the kernel loading the image, the dynamic loader, if
+ * any, and the C runtime startup.
+ */
+static int child(uint64_t now, char **argv)
+{
+	uint64_t t0 = strtoull(argv[2], NULL, 0);
+	uint64_t elapsed = now - t0;
+	int fd = atoi(argv[3]);
+
+	if (write(fd, &elapsed, sizeof(elapsed)) != sizeof(elapsed))
+		return (EXIT_FAILURE);
+
+	return (EXIT_SUCCESS);
+}
+
+/**
+ * @brief Executes the benchmark once.
+ *
+ * @param self    Path of the benchmark.
+ * @param fd      Write end of the result pipe.
+ * @param rfd     Read end of the result pipe.
+ * @param to_main Time from exec to main (in ns).
+ * @param spawn   Time from fork to exit (in ns).
+ *
+ * @returns Zero on success, and -1 on failure.
+ */
+static int run(const char *self, int fd, int rfd, uint64_t *to_main, uint64_t *spawn)
+{
+	pid_t pid;
+	int status;
+	uint64_t t0;
+
+	t0 = bench_now();
+
+	if ((pid = fork()) < 0)
+		return (-1);
+
+	if (pid == 0)
+	{
+		char t[24], f[12];
+		char *argv[] = { (char *) self, "-c", t, f, NULL };
+
+		snprintf(f, sizeof(f), "%d", fd);
+		snprintf(t, sizeof(t), "%" PRIu64, bench_now());
+		execv(self, argv);
+		_exit(127);
+	}
+
+	while (waitpid(pid, &status, 0) < 0)
+	{
+		if (errno != EINTR)
+			return (-1);
+	}
+	*spawn = bench_now() - t0;
+
+	if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+		return (-1);
+
+	if (read(rfd, to_main, sizeof(*to_main)) != sizeof(*to_main))
+		return (-1);
+
+	return (0);
+}
+
+/**
+ * @brief Process startup benchmark.
+ *
+ * @details Usage: execbench [execs]
+ *
+ * Executes itself execs times and reports how long it takes from
+ * execve() to main in the new image, and from fork() to the exit of the
+ * child. Whether it is linked statically or against the dynamic loader
+ * is told by the auxiliary vector, so builds of either kind can be
+ * compared (make LINK=static or LINK=dynamic).
+ */
+int main(int argc, char **argv)
+{
+	uint64_t now = bench_now();
+	int fds[2];
+	long execs;
+	uint64_t sum = 0, spawn = 0;
+	uint64_t *samples;
+
+	if ((argc == 4) && (strcmp(argv[1], "-c") == 0))
+		return (child(now, argv));
+
+	execs = bench_arg(argc, argv, 1, EXECS);
+	if ((argc > 2) || (execs < 1) || (argv[0][0] != '/'))
+	{
+		fprintf(stderr, "usage: /path/to/execbench [execs]\n");
+		return (EXIT_FAILURE);
+	}
+
+	if ((samples = malloc(execs*sizeof(uint64_t))) == NULL)
+	{
+		perror("malloc");
+		return (EXIT_FAILURE);
+	}
+
+	if (pipe(fds) < 0)
+	{
+		perror("pipe");
+		return (EXIT_FAILURE);
+	}
+
+	for (long i = 0; i < execs; i++)
+	{
+		uint64_t t;
+
+		if (run(argv[0], fds[1], fds[0], &samples[i], &t) < 0)
+		{
+			fprintf(stderr, "execbench: %s: execution failed\n", argv[0]);
+			return (EXIT_FAILURE);
+		}
+		sum += samples[i];
+		spawn += t;
+	}
+
+	qsort(samples, execs, sizeof(uint64_t), cmp);
+
+	printf("exec link=%s execs=%ld exec_to_main_min_us=%" PRIu64 " exec_to_main_us=%" PRIu64
+		" exec_to_main_p99_us=%" PRIu64 " spawn_us=%" PRIu64 "\n",
+		(getauxval(AT_BASE) != 0) ? "dynamic" : "static", execs,
+		samples[0]/1000, sum/execs/1000, samples[(execs*99)/100]/1000, spawn/execs/1000);
+
+	free(samples);
+	close(fds[0]);
+	close(fds[1]);
+
+	return (EXIT_SUCCESS);
+}
@@ -0,0 +1,169 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <bench.h>
+#include <gemm.h>
+#include <noc.h>
+
+/**
+ * @brief Default side of the local blocks.
+ */
+#define NB 96
+
+/**
+ * @brief Element (i,j) of the global matrix A.
+ *
+ * @details Multiples of 1/4, so every product is exact in Q16.16 and
+ * results can be checked bit by bit.
+ */
+static q16_t elem_a(long i, long j)
+{
+	return ((q16_t)(((i*7 + j*3) % 9) - 4)*(Q16_ONE/4));
+}
+
+/**
+ * @brief Element (i,j) of the global matrix B.
+ */
+static q16_t elem_b(long i, long j)
+{
+	return ((q16_t)(((i*5 + j*11) % 9) - 4)*(Q16_ONE/4));
+}
+
+/**
+ * @brief Returns millions of operations per second.
+ *
+ * @details A multiply-accumulate counts as two operations.
+ */
+static uint64_t mops(uint64_t m, uint64_t n, uint64_t k, uint64_t ns)
+{
+	return ((2*m*n*k*1000)/(ns + 1));
+}
+
+/**
+ * @brief Fixed-point GEMM benchmark.
+ *
+ * @details Usage: gemmbench [nb]
+ *
+ * Compares the reference and cache-blocked kernels on one tile, then
+ * runs SUMMA on the largest square grid of tiles with nb x nb blocks per
+ * tile and reports MOPS per tile and scaling efficiency relative to
+ * the single-tile blocked kernel.
+ */
+int main(int argc, char **argv)
+{
+	int q, row, col;
+	uint64_t t0, t1, tnaive, tblocked, tsumma;
+	long nb = bench_arg(argc, argv, 1, NB);
+	q16_t *A, *B, *C, *C2;
+	struct summa_stats stats;
+	long errors = 0;
+
+	if (nb < 1)
+	{
+		fprintf(stderr, "usage: gemmbench [nb]\n");
+		return (EXIT_FAILURE);
+	}
+
+	if (noc_init() < 0)
+	{
+		perror("noc_init");
+		return (EXIT_FAILURE);
+	}
+
+	q = summa_grid();
+	row = noc_tile()/q;
+	col = noc_tile()%q;
+
+	A = malloc(nb*nb*sizeof(q16_t));
+	B = malloc(nb*nb*sizeof(q16_t));
+	C = calloc(nb*nb, sizeof(q16_t));
+	C2 = calloc(nb*nb, sizeof(q16_t));
+	if ((A == NULL) || (B == NULL) || (C == NULL) || (C2 == NULL))
+	{
+		perror("malloc");
+		return (EXIT_FAILURE);
+	}
+
+	for (long i = 0; i < nb; i++)
+	{
+		for (long j = 0; j < nb; j++)
+		{
+			A[i*nb + j] = elem_a(row*nb + i, col*nb + j);
+			B[i*nb + j] = elem_b(row*nb + i, col*nb + j);
+		}
+	}
+
+	/* Single tile. */
+	t0 = bench_now();
+	gemm_q16_naive(nb, nb, nb, A, nb, B, nb, C, nb);
+	t1 = bench_now();
+	tnaive = t1 - t0;
+	gemm_q16(nb, nb, nb, A, nb, B, nb, C2, nb);
+	tblocked = bench_now() - t1;
+	if (memcmp(C, C2, nb*nb*sizeof(q16_t)) != 0)
+		errors++;
+
+	/* Distributed. */
+	memset(C, 0, nb*nb*sizeof(q16_t));
+	t0 = bench_now();
+	if (summa_q16(nb, A, B, C, &stats) < 0)
+	{
+		perror("summa_q16");
+		return (EXIT_FAILURE);
+	}
+	tsumma = bench_now() - t0;
+
+	if (noc_tile() < q*q)
+	{
+		/* Spot-check against the definition. */
+		for (long s = 0; s < 16; s++)
+		{
+			long i = (s*37) % nb;
+			long j = (s*53) % nb;
+			int64_t acc = 0;
+
+			for (long p = 0; p < q*nb; p++)
+				acc += (int64_t) elem_a(row*nb + i, p)*elem_b(p, col*nb + j);
+
+			if (C[i*nb + j] != (q16_t)((acc + (1 << (Q16_SHIFT - 1))) >> Q16_SHIFT))
+				errors++;
+		}
+
+		printf("gemm tile=%d grid=%dx%d nb=%ld n=%ld naive_mops=%" PRIu64
+			" blocked_mops=%" PRIu64 " summa_us=%" PRIu64 " summa_mops_per_tile=%" PRIu64
+			" efficiency%%=%" PRIu64 " compute_us=%" PRIu64 " comm_us=%" PRIu64
+			" bytes=%" PRIu64 " errors=%ld\n",
+			noc_tile(), q, q, nb, q*nb,
+			mops(nb, nb, nb, tnaive), mops(nb, nb, nb, tblocked), tsumma/1000,
+			mops(nb, nb, q*nb, tsumma),
+			(tsumma > 0) ? (100*tblocked*q)/tsumma : 0,
+			stats.compute_time/1000, stats.comm_time/1000, stats.bytes_sent, errors);
+	}
+
+	free(C2);
+	free(C);
+	free(B);
+	free(A);
+	noc_finalize();
+
+	return ((errors == 0) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
@@ -0,0 +1,249 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <bench.h>
+#include <noc.h>
+
+/**
+ * @brief Default wake-up interval (in microseconds).
+ */
+#define INTERVAL 1000
+
+/**
+ * @brief Default number of wake-ups per phase.
+ */
+#define LOOPS 5000
+
+/**
+ * @brief Size of a load message (in bytes).
+ */
+#define LOAD_SIZE 4096
+
+/**
+ * @brief Benchmark state.
+ */
+static struct
+{
+	volatile int loading;      /**< Load sender running?         */
+	uint64_t sent;             /**< Load messages sent.          */
+	uint64_t received;         /**< Load messages received.      */
+	uint64_t *samples;         /**< Wake-up latencies (ns).      */
+} bench;
+
+/**
+ * @brief Compares two samples.
+ */
+static int cmp(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *) a;
+	uint64_t y = *(const uint64_t *) b;
+
+	return ((x > y) - (x < y));
+}
+
+/**
+ * @brief Sends load to the next tile until told to stop.
+ *
+ * @details An empty message ends the stream.
+ */
+static void *load_send(void *arg)
+{
+	static uint8_t buf[LOAD_SIZE];
+	int next = (noc_tile() + 1)%noc_ntiles();
+
+	((void) arg);
+
+	while (bench.loading)
+	{
+		if (noc_send(next, NOC_PORT_ANY, buf, sizeof(buf)) < 0)
+			break;
+		bench.sent++;
+	}
+	noc_send(next, NOC_PORT_ANY, buf, 0);
+
+	return (NULL);
+}
+
+/**
+ * @brief Drains the load sent by the previous tile.
+ */
+static void *load_recv(void *arg)
+{
+	int port;
+	ssize_t n;
+	static uint8_t buf[LOAD_SIZE];
+
+	((void) arg);
+
+	while ((n = noc_recv(NULL, &port, buf, sizeof(buf))) != 0)
+	{
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		bench.received++;
+	}
+
+	return (NULL);
+}
+
+/**
+ * @brief Measures wake-up latencies.
+ *
+ * @details Sleeps until absolute deadlines, interval apart, and takes
+ * how late each wake-up is, as cyclictest does.
+ */
+static void measure(long interval, long loops)
+{
+	struct timespec next;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+
+	for (long i = 0; i < loops; i++)
+	{
+		struct timespec now;
+
+		next.tv_nsec += interval*1000;
+		while (next.tv_nsec >= 1000000000)
+		{
+			next.tv_nsec -= 1000000000;
+			next.tv_sec++;
+		}
+
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR)
+			/* noop */;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+
+		bench.samples[i] = (now.tv_sec - next.tv_sec)*1000000000LL + (now.tv_nsec - next.tv_nsec);
+	}
+}
+
+/**
+ * @brief Prints the latencies of a phase.
+ */
+static void report(const char *load, long loops, int prio)
+{
+	uint64_t sum = 0;
+
+	for (long i = 0; i < loops; i++)
+		sum += bench.samples[i];
+	qsort(bench.samples, loops, sizeof(uint64_t), cmp);
+
+	printf("jitter tile=%d load=%s prio=%d mlock=%s min_us=%" PRIu64 " avg_us=%" PRIu64
+		" p99_us=%" PRIu64 " max_us=%" PRIu64 "\n",
+		noc_tile(), load, prio, (getenv("NOC_MLOCK") != NULL) ? getenv("NOC_MLOCK") : "0",
+		bench.samples[0]/1000, sum/loops/1000,
+		bench.samples[(loops*99)/100]/1000, bench.samples[loops - 1]/1000);
+	fflush(stdout);
+}
+
+/**
+ * @brief Wake-up latency (jitter) benchmark.
+ *
+ * @details Usage: jitterbench [interval] [loops] [prio]
+ *
+ * A thread wakes up every interval microseconds and records how late
+ * it is, first on an idle tile and then while the tile sends a stream
+ * of NoC messages to the next tile and drains the one of the previous
+ * tile. With prio, the measuring thread runs at that SCHED_FIFO
+ * priority. Start it from a service profile, or with NOC_MLOCK and
+ * NOC_PREFAULT set, to see what locking memory buys.
+ */
+int main(int argc, char **argv)
+{
+	int prio;
+	long interval, loops;
+	pthread_t sender, receiver;
+	pthread_attr_t attr;
+	struct sched_param other = { .sched_priority = 0 };
+
+	interval = bench_arg(argc, argv, 1, INTERVAL);
+	loops = bench_arg(argc, argv, 2, LOOPS);
+	prio = bench_arg(argc, argv, 3, 0);
+
+	if ((interval < 1) || (interval >= 1000000) || (loops < 1) || (prio < 0))
+	{
+		fprintf(stderr, "usage: jitterbench [interval] [loops] [prio]\n");
+		return (EXIT_FAILURE);
+	}
+
+	if (noc_init() < 0)
+	{
+		perror("noc_init");
+		return (EXIT_FAILURE);
+	}
+
+	if ((bench.samples = malloc(loops*sizeof(uint64_t))) == NULL)
+	{
+		perror("malloc");
+		return (EXIT_FAILURE);
+	}
+	memset(bench.samples, 0, loops*sizeof(uint64_t));
+
+	if (prio > 0)
+	{
+		struct sched_param param = { .sched_priority = prio };
+
+		if ((errno = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param)) != 0)
+		{
+			perror("pthread_setschedparam");
+			prio = 0;
+		}
+	}
+
+	measure(interval, loops);
+	report("idle", loops, prio);
+
+	/* The load runs at normal priority. */
+	pthread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+	pthread_attr_setschedparam(&attr, &other);
+
+	bench.loading = 1;
+	if (((errno = pthread_create(&receiver, &attr, load_recv, NULL)) != 0) ||
+		((errno = pthread_create(&sender, &attr, load_send, NULL)) != 0))
+	{
+		perror("pthread_create");
+		return (EXIT_FAILURE);
+	}
+
+	measure(interval, loops);
+	bench.loading = 0;
+	pthread_join(sender, NULL);
+	pthread_join(receiver, NULL);
+	report("noc", loops, prio);
+
+	printf("jitter tile=%d load_sent=%" PRIu64 " load_received=%" PRIu64 "\n",
+		noc_tile(), bench.sent, bench.received);
+
+	free(bench.samples);
+	noc_finalize();
+
+	return (EXIT_SUCCESS);
+}
@@ -0,0 +1,164 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <bench.h>
+#include <noc.h>
+
+/**
+ * @brief Default number of round trips per message size.
+ */
+#define NROUNDS 1000
+
+/**
+ * @brief Largest message size tested (in bytes).
+ */
+#define MAX_SIZE 4096
+
+/**
+ * @brief Message buffer.
+ */
+static uint8_t buf[MAX_SIZE];
+
+/**
+ * @brief Compares two samples.
+ */
+static int cmp(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *) a;
+	uint64_t y = *(const uint64_t *) b;
+
+	return ((x > y) - (x < y));
+}
+
+/**
+ * @brief Receives a message from the peer.
+ */
+static void recv_peer(void)
+{
+	int port;
+
+	do
+	{
+		if (noc_recv(NULL, &port, buf, sizeof(buf)) < 0)
+		{
+			perror("noc_recv");
+			exit(EXIT_FAILURE);
+		}
+	} while (port != NOC_PORT_ANY);
+}
+
+/**
+ * @brief Sends a message to the peer.
+ */
+static void send_peer(int peer, size_t size)
+{
+	if (noc_send(peer, NOC_PORT_ANY, buf, size) < 0)
+	{
+		perror("noc_send");
+		exit(EXIT_FAILURE);
+	}
+}
+
+/**
+ * @brief NoC latency benchmark.
+ *
+ * @details Usage: latbench [rounds]
+ *
+ * Tiles 0 and 1 play ping-pong with raw messages from 4 bytes up to
+ * MAX_SIZE. Tile 0 reports one-way latency (half the round trip) for
+ * the access mode in use; run once with NOC_MODE=poll and once without
+ * to compare the mapped adapter against the system call path.
+ */
+int main(int argc, char **argv)
+{
+	int peer;
+	long rounds = bench_arg(argc, argv, 1, NROUNDS);
+	uint64_t *samples;
+
+	if (rounds < 1)
+	{
+		fprintf(stderr, "usage: latbench [rounds]\n");
+		return (EXIT_FAILURE);
+	}
+
+	if (noc_init() < 0)
+	{
+		perror("noc_init");
+		return (EXIT_FAILURE);
+	}
+
+	/* Loopback on a single tile. */
+	peer = (noc_ntiles() > 1) ? 1 - noc_tile() : 0;
+	if (noc_tile() > 1)
+	{
+		noc_finalize();
+		return (EXIT_SUCCESS);
+	}
+
+	if ((samples = malloc(rounds*sizeof(uint64_t))) == NULL)
+	{
+		perror("malloc");
+		return (EXIT_FAILURE);
+	}
+
+	for (size_t size = 4; size <= MAX_SIZE; size *= 4)
+	{
+		uint64_t sum = 0;
+
+		for (long i = -1; i < rounds; i++)
+		{
+			uint64_t t0 = bench_now();
+
+			if (noc_tile() == 0)
+			{
+				send_peer(peer, size);
+				recv_peer();
+			}
+			else
+			{
+				recv_peer();
+				send_peer(peer, size);
+			}
+
+			/* First round warms up. */
+			if (i >= 0)
+			{
+				samples[i] = (bench_now() - t0)/2;
+				sum += samples[i];
+			}
+		}
+
+		if (noc_tile() != 0)
+			continue;
+
+		qsort(samples, rounds, sizeof(uint64_t), cmp);
+		printf("lat mode=%s size=%u rounds=%ld min_ns=%" PRIu64 " avg_ns=%" PRIu64
+			" p50_ns=%" PRIu64 " p99_ns=%" PRIu64 "\n",
+			(noc_mode() == NOC_MODE_POLL) ? "poll" : "syscall", (unsigned) size, rounds,
+			samples[0], sum/rounds, samples[rounds/2], samples[(rounds*99)/100]);
+	}
+
+	free(samples);
+	noc_finalize();
+
+	return (EXIT_SUCCESS);
+}
@@ -0,0 +1,201 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <bench.h>
+#include <noc.h>
+#include <pipeline.h>
+
+/**
+ * @brief Default number of records.
+ */
+#define NRECORDS 100000
+
+/**
+ * @brief Default record size (in bytes).
+ */
+#define RECORD_SIZE 64
+
+/**
+ * @brief Default work per record in the transform stage.
+ */
+#define WORK 16
+
+/**
+ * @brief Benchmark parameters.
+ */
+static long nrecords, recsize, work;
+
+/**
+ * @brief Records received by the sink.
+ */
+static uint64_t received;
+
+/**
+ * @brief Checksum computed by the sink.
+ */
+static uint32_t checksum;
+
+/**
+ * @brief Generates records.
+ */
+static int source(struct pl_context *ctx, const void *rec, size_t len, void *arg)
+{
+	static long n = 0;
+	static uint32_t seed = 0x6d2b79f5u;
+	uint32_t buf[PL_RECORD_MAX/sizeof(uint32_t)];
+
+	if (n == nrecords)
+		return (PL_DONE);
+
+	for (size_t i = 0; i < recsize/sizeof(uint32_t); i++)
+		buf[i] = bench_rand(&seed);
+	buf[0] = n++;
+
+	return ((pl_emit(ctx, buf, recsize) < 0) ? -1 : PL_MORE);
+}
+
+/**
+ * @brief Scrambles records (compute bound stage).
+ */
+static int transform(struct pl_context *ctx, const void *rec, size_t len, void *arg)
+{
+	uint32_t buf[PL_RECORD_MAX/sizeof(uint32_t)];
+	size_t nwords = len/sizeof(uint32_t);
+
+	memcpy(buf, rec, len);
+	for (long k = 0; k < work; k++)
+	{
+		for (size_t i = 1; i < nwords; i++)
+			buf[i] = (buf[i] ^ (buf[i - 1] >> 3))*2654435761u;
+	}
+
+	return (pl_emit(ctx, buf, len));
+}
+
+/**
+ * @brief Drops every fourth record.
+ */
+static int filter(struct pl_context *ctx, const void *rec, size_t len, void *arg)
+{
+	uint32_t id;
+
+	memcpy(&id, rec, sizeof(uint32_t));
+	if ((id & 3) == 3)
+		return (0);
+
+	return (pl_emit(ctx, rec, len));
+}
+
+/**
+ * @brief Consumes records.
+ */
+static int sink(struct pl_context *ctx, const void *rec, size_t len, void *arg)
+{
+	const uint32_t *w = rec;
+
+	received++;
+	for (size_t i = 0; i < len/sizeof(uint32_t); i++)
+		checksum += w[i];
+
+	return (0);
+}
+
+/**
+ * @brief Pipeline throughput benchmark.
+ *
+ * @details Usage: pipebench [nrecords] [record size] [work]
+ */
+int main(int argc, char **argv)
+{
+	int ntiles;
+	uint64_t t0, t1;
+	struct pl_stats stats[4];
+	struct pl_stage stages[4] = {
+		{ "source",    0, source,    NULL },
+		{ "transform", 0, transform, NULL },
+		{ "filter",    0, filter,    NULL },
+		{ "sink",      0, sink,      NULL },
+	};
+
+	nrecords = bench_arg(argc, argv, 1, NRECORDS);
+	recsize = bench_arg(argc, argv, 2, RECORD_SIZE);
+	work = bench_arg(argc, argv, 3, WORK);
+
+	if ((nrecords < 1) || (recsize < (long) sizeof(uint32_t)) ||
+		(recsize > PL_RECORD_MAX) || (work < 0))
+	{
+		fprintf(stderr, "usage: pipebench [nrecords] [record size] [work]\n");
+		return (EXIT_FAILURE);
+	}
+	recsize &= ~(sizeof(uint32_t) - 1);
+
+	if (noc_init() < 0)
+	{
+		perror("noc_init");
+		return (EXIT_FAILURE);
+	}
+
+	/* Spread stages over the available tiles, keeping them contiguous. */
+	ntiles = (noc_ntiles() < 4) ? noc_ntiles() : 4;
+	for (int i = 0; i < 4; i++)
+		stages[i].tile = i*ntiles/4;
+
+	t0 = bench_now();
+	if (pl_run(stages, 4, stats) < 0)
+	{
+		perror("pl_run");
+		return (EXIT_FAILURE);
+	}
+	t1 = bench_now();
+
+	/* Report from the sink, which has everyone's counters. */
+	if (noc_tile() == stages[3].tile)
+	{
+		int bottleneck = pl_bottleneck(stats, 4);
+
+		printf("pipeline ntiles=%d records=%ld size=%ld received=%" PRIu64
+			" checksum=%08" PRIx32 " time_us=%" PRIu64 " krec_per_s=%" PRIu64 "\n",
+			ntiles, nrecords, recsize, received, checksum, (t1 - t0)/1000,
+			(uint64_t) nrecords*1000000/((t1 - t0)/1000 + 1));
+
+		for (int i = 0; i < 4; i++)
+		{
+			printf("stage %-9s tile=%" PRIu32 " in=%" PRIu64 " out=%" PRIu64
+				" batches_in=%" PRIu64 " batches_out=%" PRIu64
+				" busy%%=%" PRIu64 " starve%%=%" PRIu64 " block%%=%" PRIu64
+				" occupancy_avg=%" PRIu64 " occupancy_max=%" PRIu32 "%s\n",
+				stages[i].name, stats[i].tile, stats[i].records_in, stats[i].records_out,
+				stats[i].batches_in, stats[i].batches_out,
+				stats[i].busy_time*100/(stats[i].elapsed + 1),
+				stats[i].starve_time*100/(stats[i].elapsed + 1),
+				stats[i].block_time*100/(stats[i].elapsed + 1),
+				(stats[i].occupancy_count > 0) ?
+					stats[i].occupancy_sum/stats[i].occupancy_count : 0,
+				stats[i].occupancy_max,
+				(i == bottleneck) ? " <- bottleneck" : "");
+		}
+	}
+
+	noc_finalize();
+
+	return (EXIT_SUCCESS);
+}
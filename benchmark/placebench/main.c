@@ -0,0 +1,167 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <bench.h>
+#include <noc.h>
+#include <place.h>
+
+/**
+ * @brief Default number of placements per policy.
+ */
+#define NPICKS 256
+
+/**
+ * @brief Spinning threads on a hot tile.
+ */
+#define HOT_THREADS 2
+
+/**
+ * @brief Tells whether a tile is hot.
+ */
+#define HOT(tile) (((tile) % 2) == 0)
+
+/**
+ * @brief Set when spinning threads should stop.
+ */
+static volatile int done = 0;
+
+/**
+ * @brief Spinning thread.
+ */
+static void *spin(void *arg)
+{
+	((void) arg);
+
+	while (!done)
+		/* noop */;
+
+	return (NULL);
+}
+
+/**
+ * @brief Task placement benchmark.
+ *
+ * @details Usage: placebench [npicks]
+ *
+ * Runs on every tile. Even tiles are made hot with a few spinning
+ * threads, odd tiles stay idle. Once the load reports have gone
+ * around, tile 0 places npicks tasks with each policy and reports the
+ * cost of a placement and the share of tasks that landed on hot
+ * tiles. The local policy stands for static placement.
+ */
+int main(int argc, char **argv)
+{
+	int tile, ntiles;
+	long npicks = bench_arg(argc, argv, 1, NPICKS);
+	pthread_t threads[HOT_THREADS];
+	static const char *names[] = { "p2c", "least", "local" };
+
+	if (npicks < 1)
+	{
+		fprintf(stderr, "usage: placebench [npicks]\n");
+		return (EXIT_FAILURE);
+	}
+
+	if (noc_init() < 0)
+	{
+		perror("noc_init");
+		return (EXIT_FAILURE);
+	}
+	tile = noc_tile();
+	ntiles = noc_ntiles();
+	noc_finalize();
+
+	if (HOT(tile))
+	{
+		for (int i = 0; i < HOT_THREADS; i++)
+			pthread_create(&threads[i], NULL, spin, NULL);
+	}
+
+	/* Let the load reports go around. */
+	usleep(3*PLACE_PERIOD_MS*1000);
+
+	if (tile == 0)
+	{
+		struct place_load loads[NOC_MAX_TILES];
+		int n;
+
+		if ((n = place_table(loads, NOC_MAX_TILES)) < 0)
+		{
+			perror("place_table");
+			done = 1;
+			return (EXIT_FAILURE);
+		}
+		for (int t = 0; t < n; t++)
+		{
+			printf("load tile=%d runnable=%u busy=%u age_ms=%u\n",
+				t, loads[t].runnable, loads[t].busy, loads[t].age);
+		}
+
+		for (int policy = PLACE_P2C; policy <= PLACE_LOCAL; policy++)
+		{
+			long hot = 0;
+			uint64_t t0, t;
+			long count[NOC_MAX_TILES] = { 0 };
+
+			t0 = bench_now();
+			for (long i = 0; i < npicks; i++)
+			{
+				int dest;
+
+				if ((dest = place_pick(policy)) < 0)
+				{
+					perror("place_pick");
+					done = 1;
+					return (EXIT_FAILURE);
+				}
+				count[dest]++;
+				hot += HOT(dest);
+			}
+			t = bench_now() - t0;
+
+			printf("place policy=%s picks=%ld pick_ns=%" PRIu64 " hot_pct=%ld",
+				names[policy], npicks, t/npicks, (hot*100)/npicks);
+			for (int i = 0; i < ntiles; i++)
+				printf(" t%d=%ld", i, count[i]);
+			printf("\n");
+
+			/* Let the charges expire. */
+			usleep(2*PLACE_PERIOD_MS*1000);
+		}
+	}
+
+	/* Stay loaded until tile 0 is done, give or take. */
+	else
+		usleep((2*(PLACE_LOCAL + 1) + 1)*PLACE_PERIOD_MS*1000);
+
+	place_close();
+
+	done = 1;
+	if (HOT(tile))
+	{
+		for (int i = 0; i < HOT_THREADS; i++)
+			pthread_join(threads[i], NULL);
+	}
+
+	return (EXIT_SUCCESS);
+}
@@ -0,0 +1,244 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <bench.h>
+#include <noc.h>
+
+/**
+ * @brief Default number of allocations per test.
+ */
+#define NALLOCS 100000
+
+/**
+ * @brief Buffers held at once in the batch test.
+ */
+#define BATCH 64
+
+/**
+ * @brief Maximum number of threads.
+ */
+#define MAX_THREADS 8
+
+/**
+ * @brief Allocator under test.
+ */
+struct allocator
+{
+	void *(*alloc)(size_t); /**< Allocate. */
+	void (*free)(void *);   /**< Release.  */
+};
+
+/**
+ * @brief Allocators under test.
+ */
+static const struct allocator allocators[] = {
+	{ malloc,        free         },
+	{ noc_buf_alloc, noc_buf_free },
+};
+
+/**
+ * @brief Test parameters, shared with the worker threads.
+ */
+static struct
+{
+	const struct allocator *a; /**< Allocator.            */
+	size_t size;               /**< Buffer size.          */
+	long n;                    /**< Allocations per thread. */
+} test;
+
+/**
+ * @brief Allocates and releases buffers, BATCH at a time.
+ *
+ * @details Touches the first and last cache lines of every buffer, as
+ * the receive path would.
+ */
+static void *worker(void *arg)
+{
+	void *bufs[BATCH];
+
+	((void) arg);
+
+	for (long i = 0; i < test.n; i += BATCH)
+	{
+		for (int j = 0; j < BATCH; j++)
+		{
+			if ((bufs[j] = test.a->alloc(test.size)) == NULL)
+			{
+				perror("alloc");
+				exit(EXIT_FAILURE);
+			}
+			((volatile uint8_t *) bufs[j])[0] = j;
+			((volatile uint8_t *) bufs[j])[test.size - 1] = j;
+		}
+
+		for (int j = BATCH - 1; j >= 0; j--)
+			test.a->free(bufs[j]);
+	}
+
+	return (NULL);
+}
+
+/**
+ * @brief Runs a test on some threads.
+ *
+ * @returns Allocations per second.
+ */
+static uint64_t run(int nthreads)
+{
+	uint64_t t0, t;
+	pthread_t tids[MAX_THREADS];
+
+	t0 = bench_now();
+
+	for (int i = 1; i < nthreads; i++)
+		pthread_create(&tids[i], NULL, worker, NULL);
+	worker(NULL);
+	for (int i = 1; i < nthreads; i++)
+		pthread_join(tids[i], NULL);
+
+	t = bench_now() - t0;
+
+	return ((uint64_t)((nthreads*test.n*1000000000ULL)/(t + 1)));
+}
+
+/**
+ * @brief Measures receive throughput, copying or not.
+ *
+ * @details Messages go through the loopback path, so only the local
+ * tile is involved.
+ *
+ * @returns Messages per second.
+ */
+static uint64_t recv_rate(size_t size, long n, int zerocopy)
+{
+	int src, port;
+	uint64_t t0, t;
+	void *data;
+	static uint8_t buf[NOC_MSG_MAX];
+
+	t0 = bench_now();
+
+	for (long i = 0; i < n; i++)
+	{
+		if (noc_send(noc_tile(), NOC_PORT_ANY, buf, size) < 0)
+		{
+			perror("noc_send");
+			exit(EXIT_FAILURE);
+		}
+
+		if (zerocopy)
+		{
+			if (noc_recv_buf(&src, &port, &data) < 0)
+			{
+				perror("noc_recv_buf");
+				exit(EXIT_FAILURE);
+			}
+			(void) ((volatile uint8_t *) data)[0];
+			noc_buf_free(data);
+		}
+		else if (noc_recv(&src, &port, buf, sizeof(buf)) < 0)
+		{
+			perror("noc_recv");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	t = bench_now() - t0;
+
+	return ((uint64_t)((n*1000000000ULL)/(t + 1)));
+}
+
+/**
+ * @brief NoC buffer pool benchmark.
+ *
+ * @details Usage: poolbench [allocations] [threads]
+ *
+ * Compares allocation rates of malloc and the NoC buffer pool over the
+ * size classes, with one and many threads, and the receive rate of
+ * noc_recv() against noc_recv_buf(). Only tile 0 runs.
+ */
+int main(int argc, char **argv)
+{
+	long n = bench_arg(argc, argv, 1, NALLOCS);
+	int nthreads = bench_arg(argc, argv, 2, 4);
+	static const size_t sizes[] = { 64, 256, 1024, 4096, 16384, NOC_MSG_MAX };
+	struct noc_pool_stats stats;
+
+	if ((n < BATCH) || (nthreads < 1) || (nthreads > MAX_THREADS))
+	{
+		fprintf(stderr, "usage: poolbench [allocations] [threads]\n");
+		return (EXIT_FAILURE);
+	}
+
+	if (noc_init() < 0)
+	{
+		perror("noc_init");
+		return (EXIT_FAILURE);
+	}
+
+	if (noc_tile() != 0)
+	{
+		noc_finalize();
+		return (EXIT_SUCCESS);
+	}
+
+	for (size_t i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++)
+	{
+		uint64_t rate[2][2];
+
+		test.size = sizes[i];
+		test.n = n;
+
+		/* Large buffers are slow with any allocator. */
+		if (test.size > 4096)
+			test.n = n/16 - (n/16) % BATCH + BATCH;
+
+		for (int a = 0; a < 2; a++)
+		{
+			test.a = &allocators[a];
+			rate[a][0] = run(1);
+			rate[a][1] = run(nthreads);
+		}
+
+		printf("pool size=%zu malloc_allocs_per_sec=%" PRIu64 " pool_allocs_per_sec=%" PRIu64
+			" malloc_allocs_per_sec_%dthr=%" PRIu64 " pool_allocs_per_sec_%dthr=%" PRIu64 "\n",
+			test.size, rate[0][0], rate[1][0], nthreads, rate[0][1], nthreads, rate[1][1]);
+	}
+
+	for (size_t i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++)
+	{
+		long m = (sizes[i] > 4096) ? n/64 + 1 : n/4;
+
+		printf("pool recv size=%zu copy_msgs_per_sec=%" PRIu64 " zerocopy_msgs_per_sec=%" PRIu64 "\n",
+			sizes[i], recv_rate(sizes[i], m, 0), recv_rate(sizes[i], m, 1));
+	}
+
+	noc_pool_get_stats(&stats);
+	printf("pool slabs=%" PRIu64 " bytes=%" PRIu64 " free=%" PRIu64
+		" refills=%" PRIu64 " flushes=%" PRIu64 "\n",
+		stats.slabs, stats.bytes, stats.free, stats.refills, stats.flushes);
+
+	noc_finalize();
+
+	return (EXIT_SUCCESS);
+}
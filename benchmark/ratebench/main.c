@@ -0,0 +1,321 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <bench.h>
+#include <noc.h>
+
+/**
+ * @brief Default limit shared by the bulk senders (in bytes per second).
+ */
+#define RATE 1000000
+
+/**
+ * @brief Default length of a phase (in milliseconds).
+ */
+#define DURATION 1000
+
+/**
+ * @brief Size of a bulk message (in bytes).
+ */
+#define BULK_SIZE 4096
+
+/**
+ * @brief Size of a large bulk message (in bytes), well over the default
+ * burst of a share, so that every message runs its bucket into debt.
+ */
+#define LARGE_SIZE NOC_SENDFILE_CHUNK
+
+/**
+ * @brief Size of a ping (in bytes).
+ */
+#define PING_SIZE 64
+
+/**
+ * @brief Round trip samples kept per phase.
+ */
+#define MAX_SAMPLES 65536
+
+/**
+ * @name Message types.
+ */
+/**@{*/
+#define MSG_GO   1 /**< Starts a phase.    */
+#define MSG_BULK 2 /**< Bulk data.         */
+#define MSG_PING 3 /**< Latency probe.     */
+#define MSG_DONE 4 /**< Ends a phase.      */
+/**@}*/
+
+/**
+ * @brief Message header.
+ */
+struct msg
+{
+	uint32_t type;   /**< Message type.                     */
+	uint32_t rate;   /**< Limit of a phase (MSG_GO).        */
+	uint32_t size;   /**< Bulk message size (MSG_GO).       */
+	uint32_t pings;  /**< Round trips (MSG_DONE).           */
+	uint32_t p50;    /**< Median round trip (ns, MSG_DONE). */
+	uint32_t p99;    /**< 99th percentile (ns, MSG_DONE).   */
+};
+
+/**
+ * @brief Message buffer.
+ */
+static uint8_t buf[LARGE_SIZE];
+
+/**
+ * @brief Round trip samples.
+ */
+static uint64_t samples[MAX_SAMPLES];
+
+/**
+ * @brief Number of bulk senders.
+ */
+static int nbulk;
+
+/**
+ * @brief Compares two samples.
+ */
+static int cmp(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *) a;
+	uint64_t y = *(const uint64_t *) b;
+
+	return ((x > y) - (x < y));
+}
+
+/**
+ * @brief Sends a message, or exits.
+ */
+static void send_msg(int dest, const struct msg *m, size_t size)
+{
+	memcpy(buf, m, sizeof(struct msg));
+	if (noc_send(dest, NOC_PORT_ANY, buf, size) < 0)
+	{
+		perror("noc_send");
+		exit(EXIT_FAILURE);
+	}
+}
+
+/**
+ * @brief Receives a message, or exits.
+ */
+static int recv_msg(struct msg *m)
+{
+	int src, port;
+
+	do
+	{
+		if (noc_recv(&src, &port, buf, sizeof(buf)) < 0)
+		{
+			perror("noc_recv");
+			exit(EXIT_FAILURE);
+		}
+	} while (port != NOC_PORT_ANY);
+
+	memcpy(m, buf, sizeof(struct msg));
+
+	return (src);
+}
+
+/**
+ * @brief Runs one phase on tile 0: sinks bulk data and echoes pings.
+ */
+static void sink(uint32_t rate, uint32_t size)
+{
+	int done = 0;
+	uint64_t t0, elapsed;
+	uint64_t bytes[NOC_MAX_TILES] = { 0 };
+	uint64_t total = 0, bulk = 0, sum = 0, sum2 = 0;
+	struct msg m, stats[NOC_MAX_TILES];
+
+	memset(&m, 0, sizeof(m));
+	m.type = MSG_GO;
+	m.rate = rate;
+	m.size = size;
+	t0 = bench_now();
+	for (int i = 1; i < noc_ntiles(); i++)
+		send_msg(i, &m, sizeof(m));
+
+	while (done < noc_ntiles() - 1)
+	{
+		int src = recv_msg(&m);
+
+		switch (m.type)
+		{
+			case MSG_BULK:
+				bytes[src] += size;
+				break;
+			case MSG_PING:
+				bytes[src] += PING_SIZE;
+				send_msg(src, &m, PING_SIZE);
+				break;
+			case MSG_DONE:
+				stats[src] = m;
+				done++;
+				break;
+		}
+	}
+	elapsed = bench_now() - t0;
+
+	for (int i = 1; i < noc_ntiles(); i++)
+	{
+		total += bytes[i];
+		if (i > nbulk)
+		{
+			printf("rate limit=%" PRIu32 " size=%" PRIu32 " tile=%d role=ping pings=%" PRIu32
+				" rtt_p50_us=%" PRIu32 " rtt_p99_us=%" PRIu32 "\n",
+				rate, size, i, stats[i].pings, stats[i].p50/1000, stats[i].p99/1000);
+			continue;
+		}
+
+		bulk += bytes[i];
+		sum += bytes[i]/1024;
+		sum2 += (bytes[i]/1024)*(bytes[i]/1024);
+		printf("rate limit=%" PRIu32 " size=%" PRIu32 " tile=%d role=bulk kbps=%" PRIu64,
+			rate, size, i, bytes[i]*8*1000000/elapsed);
+		if (rate > 0)
+			printf(" share_pct=%" PRIu64, bytes[i]*1000000000/elapsed*100/(rate/nbulk));
+		printf("\n");
+	}
+
+	/* Jain's index: 1 if the bulk senders got equal shares. */
+	printf("rate limit=%" PRIu32 " size=%" PRIu32 " util_kbps=%" PRIu64 " bulk_kbps=%" PRIu64
+		" fairness=%.3f\n", rate, size, total*8*1000000/elapsed, bulk*8*1000000/elapsed,
+		(sum2 > 0) ? (double) sum*sum/(nbulk*sum2) : 1.0);
+	fflush(stdout);
+}
+
+/**
+ * @brief Runs one phase on a bulk sender.
+ *
+ * @details The senders do not ask for equal shares: tile i offers
+ * i times as many messages as tile 1 per round, so without a limit
+ * the heaviest one gets most of the link.
+ */
+static void bulk(long duration)
+{
+	struct msg m;
+	uint32_t size;
+	uint64_t end;
+
+	recv_msg(&m);
+	noc_rate_set(0, m.rate/nbulk, 0);
+	size = m.size;
+
+	memset(&m, 0, sizeof(m));
+	m.type = MSG_BULK;
+	for (end = bench_now() + duration*1000000; bench_now() < end; /* noop */)
+	{
+		for (int i = 0; (i < noc_tile()) && (bench_now() < end); i++)
+			send_msg(0, &m, size);
+	}
+
+	m.type = MSG_DONE;
+	send_msg(0, &m, sizeof(m));
+}
+
+/**
+ * @brief Runs one phase on a latency prober.
+ */
+static void ping(long duration)
+{
+	struct msg m;
+	uint32_t n = 0;
+	uint64_t end;
+
+	recv_msg(&m);
+
+	memset(&m, 0, sizeof(m));
+	for (end = bench_now() + duration*1000000; bench_now() < end; /* noop */)
+	{
+		uint64_t t0 = bench_now();
+
+		m.type = MSG_PING;
+		send_msg(0, &m, PING_SIZE);
+		recv_msg(&m);
+
+		if (n < MAX_SAMPLES)
+			samples[n++] = bench_now() - t0;
+	}
+
+	qsort(samples, n, sizeof(uint64_t), cmp);
+	m.type = MSG_DONE;
+	m.pings = n;
+	m.p50 = (n > 0) ? samples[n/2] : 0;
+	m.p99 = (n > 0) ? samples[(n*99)/100] : 0;
+	send_msg(0, &m, sizeof(m));
+}
+
+/**
+ * @brief Rate limiting fairness benchmark.
+ *
+ * @details Usage: ratebench [rate] [duration]
+ *
+ * Tile 0 is the sink. The first half of the other tiles flood it with
+ * bulk messages, each offering a different load, and the rest measure
+ * round trips to it with small pings. The benchmark runs one phase
+ * without limits and one in which every bulk sender is limited to an
+ * equal share of rate bytes per second towards tile 0, and reports
+ * link utilization, the fairness of the bulk shares and the ping
+ * latency of each phase. A last limited phase sends messages larger
+ * than the burst, which must still get their share (share_pct).
+ */
+int main(int argc, char **argv)
+{
+	long rate = bench_arg(argc, argv, 1, RATE);
+	long duration = bench_arg(argc, argv, 2, DURATION);
+
+	if ((rate < 1) || (rate > UINT32_MAX) || (duration < 1))
+	{
+		fprintf(stderr, "usage: ratebench [rate] [duration]\n");
+		return (EXIT_FAILURE);
+	}
+
+	if (noc_init() < 0)
+	{
+		perror("noc_init");
+		return (EXIT_FAILURE);
+	}
+
+	if (noc_ntiles() < 3)
+	{
+		fprintf(stderr, "ratebench: needs at least 3 tiles\n");
+		noc_finalize();
+		return (EXIT_FAILURE);
+	}
+	nbulk = noc_ntiles()/2;
+
+	for (int phase = 0; phase < 3; phase++)
+	{
+		if (noc_tile() == 0)
+			sink((phase == 0) ? 0 : rate, (phase < 2) ? BULK_SIZE : LARGE_SIZE);
+		else if (noc_tile() <= nbulk)
+			bulk(duration);
+		else
+			ping(duration);
+	}
+
+	noc_finalize();
+
+	return (EXIT_SUCCESS);
+}
@@ -0,0 +1,116 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <bench.h>
+#include <dsort.h>
+#include <noc.h>
+
+/**
+ * @brief Default smallest number of keys per tile.
+ */
+#define MIN_KEYS 1024
+
+/**
+ * @brief Default largest number of keys per tile.
+ */
+#define MAX_KEYS 262144
+
+/**
+ * @brief Distributed sort benchmark.
+ *
+ * @details Usage: sortbench [min keys] [max keys]
+ *
+ * Sorts random keys, doubling the number of keys per tile from min to
+ * max. Each tile checks that its partition is sorted and prints a key
+ * sum, so that the sums of input and output can be compared across
+ * tiles.
+ */
+int main(int argc, char **argv)
+{
+	uint32_t seed;
+	long minkeys = bench_arg(argc, argv, 1, MIN_KEYS);
+	long maxkeys = bench_arg(argc, argv, 2, MAX_KEYS);
+	int failed = 0;
+
+	if ((minkeys < 1) || (maxkeys < minkeys))
+	{
+		fprintf(stderr, "usage: sortbench [min keys] [max keys]\n");
+		return (EXIT_FAILURE);
+	}
+
+	if (noc_init() < 0)
+	{
+		perror("noc_init");
+		return (EXIT_FAILURE);
+	}
+
+	seed = 0x85ebca6bu ^ (noc_tile() + 1);
+
+	for (long n = minkeys; n <= maxkeys; n *= 2)
+	{
+		uint32_t *keys, *out;
+		size_t nout;
+		uint64_t t0, t1;
+		uint64_t sumin = 0, sumout = 0;
+		size_t disorders = 0;
+		struct dsort_stats stats;
+
+		if ((keys = malloc(n*sizeof(uint32_t))) == NULL)
+		{
+			perror("malloc");
+			return (EXIT_FAILURE);
+		}
+		for (long i = 0; i < n; i++)
+			sumin += keys[i] = bench_rand(&seed);
+
+		t0 = bench_now();
+		if (dsort(keys, n, &out, &nout, &stats) < 0)
+		{
+			perror("dsort");
+			return (EXIT_FAILURE);
+		}
+		t1 = bench_now();
+
+		for (size_t i = 0; i < nout; i++)
+		{
+			sumout += out[i];
+			if ((i > 0) && (out[i - 1] > out[i]))
+				disorders++;
+		}
+		failed |= (disorders > 0);
+
+		printf("dsort tile=%d ntiles=%d keys=%ld partition=%zu time_us=%" PRIu64
+			" sort_us=%" PRIu64 " sample_us=%" PRIu64 " exchange_us=%" PRIu64
+			" merge_us=%" PRIu64 " msgs=%" PRIu64 " bytes=%" PRIu64
+			" sum_in=%" PRIu64 " sum_out=%" PRIu64 " disorders=%zu\n",
+			noc_tile(), noc_ntiles(), n, nout, (t1 - t0)/1000,
+			stats.sort_time/1000, stats.sample_time/1000, stats.exchange_time/1000,
+			stats.merge_time/1000, stats.msgs_sent, stats.bytes_sent,
+			sumin, sumout, disorders);
+
+		free(out);
+		free(keys);
+	}
+
+	noc_finalize();
+
+	return ((failed) ? EXIT_FAILURE : EXIT_SUCCESS);
+}
@@ -0,0 +1,141 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <bench.h>
+#include <mapreduce.h>
+#include <noc.h>
+
+/**
+ * @brief Default number of records per tile.
+ */
+#define NRECORDS 16384
+
+/**
+ * @brief Key length (in bytes).
+ */
+#define KEY_SIZE 10
+
+/**
+ * @brief Reduce-side results.
+ */
+struct result
+{
+	uint64_t nrecords;           /**< Records reduced.         */
+	uint64_t disorders;          /**< Out-of-order keys seen.  */
+	size_t lastlen;              /**< Length of the last key.  */
+	uint8_t last[KEY_SIZE];      /**< Last key seen.           */
+};
+
+/**
+ * @brief Emits one pair per record, tagged with its global index.
+ */
+static void ts_map(struct mr_context *ctx, const void *input, size_t len, void *arg)
+{
+	const uint8_t *keys = input;
+	mr_value_t base = (mr_value_t) noc_tile() << 32;
+
+	for (size_t i = 0; i < len/KEY_SIZE; i++)
+		mr_emit(ctx, &keys[i*KEY_SIZE], KEY_SIZE, base + i);
+}
+
+/**
+ * @brief Range partitioner, so that concatenating the outputs of all
+ * tiles in order yields a globally sorted sequence.
+ */
+static int ts_partition(const void *key, size_t klen, int ntiles)
+{
+	const uint8_t *k = key;
+	uint32_t prefix = (klen >= 2) ? ((uint32_t) k[0] << 8) | k[1] : 0;
+
+	return ((int)((prefix*(uint32_t) ntiles) >> 16));
+}
+
+/**
+ * @brief Checks that keys come in ascending order.
+ */
+static void ts_reduce(const void *key, size_t klen, const mr_value_t *vals, size_t n, void *arg)
+{
+	struct result *r = arg;
+
+	if ((r->lastlen > 0) && (memcmp(r->last, key, KEY_SIZE) > 0))
+		r->disorders++;
+
+	memcpy(r->last, key, KEY_SIZE);
+	r->lastlen = klen;
+	r->nrecords += n;
+}
+
+/**
+ * @brief Terasort-like benchmark.
+ *
+ * @details Usage: terasort [nrecords]
+ */
+int main(int argc, char **argv)
+{
+	uint8_t *keys;
+	uint32_t seed;
+	struct mr_stats stats;
+	struct result r;
+	struct mr_job job = { ts_map, NULL, ts_reduce, ts_partition, &r };
+	long nrecords = bench_arg(argc, argv, 1, NRECORDS);
+
+	if (nrecords < 1)
+	{
+		fprintf(stderr, "usage: terasort [nrecords]\n");
+		return (EXIT_FAILURE);
+	}
+
+	if (noc_init() < 0)
+	{
+		perror("noc_init");
+		return (EXIT_FAILURE);
+	}
+
+	if ((keys = malloc(nrecords*KEY_SIZE)) == NULL)
+	{
+		perror("malloc");
+		return (EXIT_FAILURE);
+	}
+
+	seed = 0x2545f491u ^ (noc_tile() + 1);
+	for (long i = 0; i < nrecords*KEY_SIZE; i++)
+		keys[i] = bench_rand(&seed);
+
+	memset(&r, 0, sizeof(struct result));
+	if (mr_run(&job, keys, nrecords*KEY_SIZE, &stats) < 0)
+	{
+		perror("mr_run");
+		return (EXIT_FAILURE);
+	}
+
+	printf("terasort tile=%d ntiles=%d records=%ld bytes=%" PRIu64
+		" map_us=%" PRIu64 " shuffle_us=%" PRIu64 " reduce_us=%" PRIu64
+		" sorted=%" PRIu64 " disorders=%" PRIu64 "\n",
+		noc_tile(), noc_ntiles(), nrecords, stats.bytes_sent,
+		stats.map_time/1000, stats.shuffle_time/1000, stats.reduce_time/1000,
+		r.nrecords, r.disorders);
+
+	free(keys);
+	noc_finalize();
+
+	return ((r.disorders == 0) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
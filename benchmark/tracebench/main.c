@@ -0,0 +1,181 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <bench.h>
+#include <noc.h>
+#include <trace.h>
+
+/**
+ * @brief Default number of requests per run.
+ */
+#define NREQS 1000
+
+/**
+ * @brief Requests dumped at the end.
+ */
+#define NDUMP 4
+
+/**
+ * @brief Request payload.
+ */
+struct request
+{
+	uint32_t id;   /**< Request number (~0 to stop). */
+	uint32_t hops; /**< Tiles visited so far.        */
+};
+
+/**
+ * @brief Exits on error.
+ */
+static void die(const char *msg)
+{
+	perror(msg);
+	exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Receives a request.
+ */
+static void recv_request(struct request *req)
+{
+	int port;
+
+	do
+	{
+		if (noc_recv(NULL, &port, req, sizeof(struct request)) < 0)
+			die("noc_recv");
+	} while (port != NOC_PORT_ANY);
+}
+
+/**
+ * @brief Forwards requests along the chain until told to stop.
+ */
+static void hop(int next, int traced)
+{
+	struct request req;
+
+	do
+	{
+		recv_request(&req);
+		traced = traced && (req.id != ~0u);
+
+		if (traced)
+			trace_join("hop");
+		req.hops++;
+		if (noc_send(next, NOC_PORT_ANY, &req, sizeof(req)) < 0)
+			die("noc_send");
+		if (traced)
+			trace_end();
+	} while (req.id != ~0u);
+}
+
+/**
+ * @brief Issues requests that go around the chain.
+ */
+static uint64_t client(long nreqs, int traced)
+{
+	uint64_t t0;
+	struct request req;
+
+	t0 = bench_now();
+	for (long i = 0; i <= nreqs; i++)
+	{
+		req.id = (i < nreqs) ? (uint32_t) i : ~0u;
+		req.hops = 0;
+
+		if ((traced) && (i < nreqs))
+			trace_begin("request");
+		if (noc_send(1, NOC_PORT_ANY, &req, sizeof(req)) < 0)
+			die("noc_send");
+		recv_request(&req);
+		if ((traced) && (i < nreqs))
+			trace_end();
+	}
+
+	return (bench_now() - t0);
+}
+
+/**
+ * @brief Tracing benchmark.
+ *
+ * @details Usage: tracebench [nreqs]
+ *
+ * Tiles form a ring: tile 0 sends each request to tile 1, which
+ * forwards it to tile 2 and so on, back to tile 0. The ring is run
+ * once without and once with tracing, tile 0 opening a span per
+ * request and the other tiles a span per hop, so the difference is the
+ * cost of tracing. A few more traced requests are then run and their
+ * spans dumped for trace-stitch.sh.
+ */
+int main(int argc, char **argv)
+{
+	int tile, ntiles;
+	long nreqs = bench_arg(argc, argv, 1, NREQS);
+
+	if (nreqs < 1)
+	{
+		fprintf(stderr, "usage: tracebench [nreqs]\n");
+		return (EXIT_FAILURE);
+	}
+
+	if (noc_init() < 0)
+		die("noc_init");
+	tile = noc_tile();
+	ntiles = noc_ntiles();
+
+	if (ntiles < 2)
+	{
+		fprintf(stderr, "tracebench: needs two tiles\n");
+		noc_finalize();
+		return (EXIT_FAILURE);
+	}
+
+	if (trace_sync(0) < 0)
+		die("trace_sync");
+
+	for (int traced = 0; traced < 2; traced++)
+	{
+		if (tile == 0)
+		{
+			uint64_t t = client(nreqs, traced);
+
+			printf("ring traced=%d tiles=%d reqs=%ld req_ns=%" PRIu64 "\n",
+				traced, ntiles, nreqs, t/nreqs);
+		}
+		else
+			hop((tile + 1) % ntiles, traced);
+	}
+
+	printf("clock tile=%d offset_ns=%" PRId64 "\n", tile, trace_offset());
+
+	/* Trace a few more requests, alone in the rings. */
+	trace_reset();
+	if (tile == 0)
+		client(NDUMP, 1);
+	else
+		hop((tile + 1) % ntiles, 1);
+
+	trace_dump(stdout);
+
+	noc_finalize();
+
+	return (EXIT_SUCCESS);
+}
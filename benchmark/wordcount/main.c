@@ -0,0 +1,178 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <bench.h>
+#include <mapreduce.h>
+#include <noc.h>
+
+/**
+ * @brief Default number of words per tile.
+ */
+#define NWORDS 65536
+
+/**
+ * @brief Default vocabulary size.
+ */
+#define VOCABULARY 2048
+
+/**
+ * @brief Reduce-side results.
+ */
+struct result
+{
+	uint64_t distinct; /**< Distinct words. */
+	uint64_t total;    /**< Total words.    */
+};
+
+/**
+ * @brief Generates a text with a skewed word distribution.
+ */
+static char *generate(long nwords, long vocabulary, size_t *len)
+{
+	char *text, *p;
+	uint32_t seed = 0x9e3779b9u ^ (noc_tile() + 1);
+
+	if ((p = text = malloc(nwords*12 + 1)) == NULL)
+		return (NULL);
+
+	for (long i = 0; i < nwords; i++)
+	{
+		/* Product of two uniforms favors low ranks. */
+		uint32_t a = bench_rand(&seed) % vocabulary;
+		uint32_t b = bench_rand(&seed) % vocabulary;
+
+		p += sprintf(p, "w%" PRIu32 " ", (uint32_t)((uint64_t) a*b/vocabulary));
+	}
+
+	*len = p - text;
+
+	return (text);
+}
+
+/**
+ * @brief Splits text into words.
+ */
+static void wc_map(struct mr_context *ctx, const void *input, size_t len, void *arg)
+{
+	const char *p = input;
+	const char *end = p + len;
+
+	while (p < end)
+	{
+		const char *w;
+
+		while ((p < end) && (*p == ' '))
+			p++;
+		for (w = p; (p < end) && (*p != ' '); p++)
+			/* noop */;
+
+		if (p > w)
+			mr_emit(ctx, w, ((p - w) < MR_KEY_MAX) ? p - w : MR_KEY_MAX, 1);
+	}
+}
+
+/**
+ * @brief Adds word counts.
+ */
+static mr_value_t wc_combine(mr_value_t a, mr_value_t b)
+{
+	return (a + b);
+}
+
+/**
+ * @brief Accounts the count of a word.
+ */
+static void wc_reduce(const void *key, size_t klen, const mr_value_t *vals, size_t n, void *arg)
+{
+	struct result *r = arg;
+
+	r->distinct++;
+	for (size_t i = 0; i < n; i++)
+		r->total += vals[i];
+}
+
+/**
+ * @brief Runs one word count job and prints its statistics.
+ */
+static int run(const char *name, mr_combine_fn combine, const char *text, size_t len)
+{
+	struct result r = { 0, 0 };
+	struct mr_stats stats;
+	struct mr_job job = { wc_map, combine, wc_reduce, NULL, &r };
+
+	if (mr_run(&job, text, len, &stats) < 0)
+		return (-1);
+
+	printf("wordcount %s tile=%d ntiles=%d emitted=%" PRIu64
+		" shuffled=%" PRIu64 " msgs=%" PRIu64 " bytes=%" PRIu64
+		" map_us=%" PRIu64 " shuffle_us=%" PRIu64 " reduce_us=%" PRIu64
+		" keys=%" PRIu64 " words=%" PRIu64 "\n",
+		name, noc_tile(), noc_ntiles(), stats.emitted, stats.shuffled,
+		stats.msgs_sent, stats.bytes_sent, stats.map_time/1000,
+		stats.shuffle_time/1000, stats.reduce_time/1000, r.distinct, r.total);
+
+	return (0);
+}
+
+/**
+ * @brief Word count benchmark.
+ *
+ * @details Usage: wordcount [nwords] [vocabulary]
+ */
+int main(int argc, char **argv)
+{
+	char *text;
+	size_t len;
+	long nwords = bench_arg(argc, argv, 1, NWORDS);
+	long vocabulary = bench_arg(argc, argv, 2, VOCABULARY);
+
+	if ((nwords < 1) || (vocabulary < 1))
+	{
+		fprintf(stderr, "usage: wordcount [nwords] [vocabulary]\n");
+		return (EXIT_FAILURE);
+	}
+
+	if (noc_init() < 0)
+	{
+		perror("noc_init");
+		return (EXIT_FAILURE);
+	}
+
+	if ((text = generate(nwords, vocabulary, &len)) == NULL)
+	{
+		perror("generate");
+		return (EXIT_FAILURE);
+	}
+
+	/* Compare shuffle traffic with and without combiner. */
+	if ((run("nocombine", NULL, text, len) < 0) ||
+		(run("combine", wc_combine, text, len) < 0))
+	{
+		perror("mr_run");
+		return (EXIT_FAILURE);
+	}
+
+	free(text);
+	noc_finalize();
+
+	return (EXIT_SUCCESS);
+}
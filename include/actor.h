@@ -0,0 +1,90 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACTOR_H_
+#define ACTOR_H_
+
+	#include <stddef.h>
+	#include <stdint.h>
+
+	/**
+	 * @brief Actor address.
+	 *
+	 * @details Bits 31:27 hold the tile that runs the actor, bits 26:22
+	 * the tile that spawned it, and bits 21:0 a sequence number, so any
+	 * tile can name a new actor without asking the target tile.
+	 */
+	typedef uint32_t actor_t;
+
+	/**
+	 * @brief Null actor address (sender of init messages).
+	 */
+	#define ACTOR_NONE 0xffffffffu
+
+	/**
+	 * @brief Tile of an actor.
+	 */
+	#define ACTOR_TILE(a) ((int)((a) >> 27))
+
+	/**
+	 * @brief Maximum number of behaviours.
+	 */
+	#define ACTOR_MAX_TYPES 32
+
+	/**
+	 * @brief Maximum message size (in bytes).
+	 */
+	#define ACTOR_MSG_MAX 4096
+
+	/**
+	 * @brief Opaque actor.
+	 */
+	struct actor;
+
+	/**
+	 * @brief Behaviour of an actor.
+	 *
+	 * @details Called once per message, to completion. The first message
+	 * of an actor comes from ACTOR_NONE and carries its spawn argument.
+	 */
+	typedef void (*actor_fn)(struct actor *, actor_t, const void *, size_t);
+
+	/**
+	 * @brief Actor runtime statistics (local tile).
+	 */
+	struct actor_stats
+	{
+		uint64_t delivered;   /**< Messages handled.                  */
+		uint64_t local_sent;  /**< Messages delivered without NoC.    */
+		uint64_t remote_sent; /**< Messages sent over the NoC.        */
+		uint64_t remote_recv; /**< Messages received over the NoC.    */
+		uint64_t dropped;     /**< Lost messages and failed spawns.   */
+	};
+
+	/* Forward definitions. */
+	extern int actor_init(void);
+	extern int actor_register(int, actor_fn, size_t);
+	extern actor_t actor_spawn(int, int, const void *, size_t);
+	extern int actor_send(actor_t, actor_t, const void *, size_t);
+	extern actor_t actor_self(const struct actor *);
+	extern void *actor_state(struct actor *);
+	extern void actor_exit(struct actor *);
+	extern int actor_run(void);
+	extern void actor_shutdown(int);
+	extern void actor_get_stats(struct actor_stats *);
+
+#endif /* ACTOR_H_ */
@@ -0,0 +1,61 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+	#include <stdint.h>
+	#include <stdlib.h>
+	#include <time.h>
+
+	/**
+	 * @brief Returns the current time in nanoseconds.
+	 */
+	static inline uint64_t bench_now(void)
+	{
+		struct timespec ts;
+
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+
+		return ((uint64_t) ts.tv_sec*1000000000ULL + ts.tv_nsec);
+	}
+
+	/**
+	 * @brief Returns a pseudo-random number (xorshift32).
+	 *
+	 * @param state Generator state (must not be zero).
+	 */
+	static inline uint32_t bench_rand(uint32_t *state)
+	{
+		uint32_t x = *state;
+
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+
+		return (*state = x);
+	}
+
+	/**
+	 * @brief Parses a numeric command line argument.
+	 */
+	static inline long bench_arg(int argc, char **argv, int i, long def)
+	{
+		return ((i < argc) ? strtol(argv[i], NULL, 0) : def);
+	}
+
+#endif /* BENCH_H_ */
@@ -0,0 +1,111 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BRIDGE_H_
+#define BRIDGE_H_
+
+	#include <sys/types.h>
+	#include <stddef.h>
+	#include <stdint.h>
+
+	#include <noc.h>
+
+	/**
+	 * @brief Serial line wired to the host socket.
+	 *
+	 * @details The second UART, which tools/run.sh connects to a host
+	 * UNIX socket when NOC_BRIDGE is set.
+	 */
+	#define BRIDGE_DEVICE "/dev/ttyS1"
+
+	/**
+	 * @name Device number of BRIDGE_DEVICE.
+	 */
+	/**@{*/
+	#define BRIDGE_MAJOR 4
+	#define BRIDGE_MINOR 65
+	/**@}*/
+
+	/**
+	 * @brief Marks the start of a batch.
+	 */
+	#define BRIDGE_MAGIC 0x4e6f4342
+
+	/**
+	 * @brief Size of a batch header (in bytes).
+	 *
+	 * @details Magic, length of the records, number of records and
+	 * sequence number, as big-endian 32-bit words.
+	 */
+	#define BRIDGE_HDR_SIZE 16
+
+	/**
+	 * @brief Size of a record header (in bytes).
+	 *
+	 * @details Tile (destination towards the guest, source towards the
+	 * host), a reserved byte, the 16-bit port and the 32-bit payload
+	 * length, big-endian. The payload follows, padded to a word.
+	 */
+	#define BRIDGE_REC_SIZE 8
+
+	/**
+	 * @brief Records are batched up to this many bytes.
+	 *
+	 * @details A larger record travels alone.
+	 */
+	#define BRIDGE_BATCH_MAX 8192
+
+	/**
+	 * @brief Largest batch (in bytes).
+	 */
+	#define BRIDGE_FRAME_MAX \
+		(BRIDGE_HDR_SIZE + BRIDGE_BATCH_MAX + BRIDGE_REC_SIZE + NOC_MSG_MAX + 3)
+
+	/**
+	 * @brief Batch being built.
+	 */
+	struct bridge_batch
+	{
+		size_t len;                     /**< Bytes used in buf.  */
+		uint32_t count;                 /**< Records in buf.     */
+		uint32_t seq;                   /**< Sequence number.    */
+		uint8_t buf[BRIDGE_FRAME_MAX];  /**< Batch.              */
+	};
+
+	/**
+	 * @brief Reader of a batched stream.
+	 */
+	struct bridge_reader
+	{
+		size_t head;                      /**< Start of unparsed data.   */
+		size_t tail;                      /**< End of data.              */
+		size_t rec;                       /**< Next record of the batch. */
+		size_t end;                       /**< End of the batch.         */
+		uint64_t batches;                 /**< Batches read.             */
+		uint64_t resyncs;                 /**< Bytes skipped to resync.  */
+		uint8_t buf[2*BRIDGE_FRAME_MAX];  /**< Stream data.              */
+	};
+
+	/* Forward definitions. */
+	extern void bridge_batch_init(struct bridge_batch *);
+	extern int bridge_batch_add(struct bridge_batch *, int, int, const void *, size_t);
+	extern int bridge_batch_flush(struct bridge_batch *, int);
+	extern void bridge_reader_init(struct bridge_reader *);
+	extern ssize_t bridge_read(struct bridge_reader *, int);
+	extern const void *bridge_next(struct bridge_reader *, int *, int *, size_t *);
+
+#endif /* BRIDGE_H_ */
@@ -0,0 +1,56 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BSP_H_
+#define BSP_H_
+
+	#include <stddef.h>
+	#include <stdint.h>
+
+	/**
+	 * @brief Maximum number of registered memory areas.
+	 */
+	#define BSP_MAX_REGS 64
+
+	/**
+	 * @brief Superstep statistics (local tile).
+	 */
+	struct bsp_stats
+	{
+		uint64_t supersteps; /**< Completed supersteps.          */
+		uint64_t msgs_sent;  /**< NoC messages sent.             */
+		uint64_t bytes_sent; /**< NoC bytes sent.                */
+		uint64_t sync_time;  /**< Time spent in bsp_sync() (ns). */
+	};
+
+	/* Forward definitions. */
+	extern int bsp_begin(void);
+	extern void bsp_end(void);
+	extern int bsp_pid(void);
+	extern int bsp_nprocs(void);
+	extern int bsp_sync(void);
+	extern int bsp_push_reg(const void *, size_t);
+	extern int bsp_pop_reg(const void *);
+	extern int bsp_put(int, const void *, const void *, size_t, size_t);
+	extern int bsp_get(int, const void *, size_t, void *, size_t);
+	extern int bsp_send(int, uint32_t, const void *, size_t);
+	extern void bsp_qsize(int *, size_t *);
+	extern int bsp_get_tag(int *, uint32_t *);
+	extern int bsp_move(void *, size_t);
+	extern void bsp_get_stats(struct bsp_stats *);
+
+#endif /* BSP_H_ */
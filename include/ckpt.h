@@ -0,0 +1,62 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CKPT_H_
+#define CKPT_H_
+
+	#include <stddef.h>
+	#include <stdint.h>
+
+	/**
+	 * @brief Maximum number of registered regions.
+	 */
+	#define CKPT_MAX_REGIONS 16
+
+	/**
+	 * @brief Granularity of incremental checkpoints (in bytes).
+	 */
+	#define CKPT_CHUNK 4096
+
+	/**
+	 * @name Checkpoint flags.
+	 */
+	/**@{*/
+	#define CKPT_INCREMENTAL 0 /**< Send only chunks changed since the last checkpoint. */
+	#define CKPT_FULL        1 /**< Send every chunk.                                  */
+	/**@}*/
+
+	/**
+	 * @brief Checkpoint statistics.
+	 */
+	struct ckpt_stats
+	{
+		uint64_t time;           /**< Elapsed time (ns).          */
+		uint64_t bytes;          /**< Payload bytes moved.        */
+		uint64_t chunks;         /**< Chunks moved.               */
+		uint64_t chunks_skipped; /**< Unchanged chunks not sent.  */
+		uint32_t epoch;          /**< Checkpoint epoch.           */
+	};
+
+	/* Forward definitions. */
+	extern int ckpt_register(void *, size_t);
+	extern void ckpt_reset(void);
+	extern int ckpt_save(int, int, struct ckpt_stats *);
+	extern int ckpt_restore(int, struct ckpt_stats *);
+	extern int ckpt_serve(void);
+	extern int ckpt_stop(int);
+
+#endif /* CKPT_H_ */
@@ -0,0 +1,47 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DSORT_H_
+#define DSORT_H_
+
+	#include <stddef.h>
+	#include <stdint.h>
+
+	/**
+	 * @brief Samples taken by each tile to pick splitters.
+	 */
+	#define DSORT_OVERSAMPLING 16
+
+	/**
+	 * @brief Distributed sort statistics (local tile).
+	 */
+	struct dsort_stats
+	{
+		uint64_t sort_time;     /**< Local sort time (ns).           */
+		uint64_t sample_time;   /**< Splitter selection time (ns).   */
+		uint64_t exchange_time; /**< Partition exchange time (ns).   */
+		uint64_t merge_time;    /**< Multiway merge time (ns).       */
+		uint64_t msgs_sent;     /**< NoC messages sent.              */
+		uint64_t bytes_sent;    /**< NoC bytes sent.                 */
+	};
+
+	/* Forward definitions. */
+	extern void dsort_local(uint32_t *, uint32_t *, size_t);
+	extern void dsort_merge(const uint32_t *const *, const size_t *, int, uint32_t *);
+	extern int dsort(const uint32_t *, size_t, uint32_t **, size_t *, struct dsort_stats *);
+
+#endif /* DSORT_H_ */
@@ -0,0 +1,71 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GEMM_H_
+#define GEMM_H_
+
+	#include <stdint.h>
+
+	/**
+	 * @brief Q16.16 fixed-point number.
+	 *
+	 * @details GCC's or1k backend does not implement the _Accum types
+	 * of stdfix.h (libgcc has no fixed-point routines for it), so plain
+	 * integers are used with the same layout as a signed accum.
+	 */
+	typedef int32_t q16_t;
+
+	/**
+	 * @brief Fractional bits of a q16_t.
+	 */
+	#define Q16_SHIFT 16
+
+	/**
+	 * @brief One in Q16.16.
+	 */
+	#define Q16_ONE (1 << Q16_SHIFT)
+
+	/**
+	 * @brief Converts an integer to Q16.16.
+	 */
+	#define q16_from_int(x) ((q16_t)((x) * Q16_ONE))
+
+	/**
+	 * @brief Multiplies two Q16.16 numbers (rounding to nearest).
+	 */
+	static inline q16_t q16_mul(q16_t a, q16_t b)
+	{
+		return ((q16_t)(((int64_t) a*b + (1 << (Q16_SHIFT - 1))) >> Q16_SHIFT));
+	}
+
+	/**
+	 * @brief SUMMA statistics (local tile).
+	 */
+	struct summa_stats
+	{
+		uint64_t compute_time; /**< Local GEMM time (ns).              */
+		uint64_t comm_time;    /**< Time waiting for panels (ns).      */
+		uint64_t bytes_sent;   /**< NoC bytes sent.                    */
+	};
+
+	/* Forward definitions. */
+	extern void gemm_q16(int, int, int, const q16_t *, int, const q16_t *, int, q16_t *, int);
+	extern void gemm_q16_naive(int, int, int, const q16_t *, int, const q16_t *, int, q16_t *, int);
+	extern int summa_grid(void);
+	extern int summa_q16(int, const q16_t *, const q16_t *, q16_t *, struct summa_stats *);
+
+#endif /* GEMM_H_ */
@@ -0,0 +1,104 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MAPREDUCE_H_
+#define MAPREDUCE_H_
+
+	#include <stddef.h>
+	#include <stdint.h>
+
+	/**
+	 * @brief Maximum key length (in bytes).
+	 */
+	#define MR_KEY_MAX 64
+
+	/**
+	 * @brief Value type.
+	 */
+	typedef int64_t mr_value_t;
+
+	/**
+	 * @brief Opaque map context.
+	 */
+	struct mr_context;
+
+	/**
+	 * @brief Map function.
+	 *
+	 * @details Called once with the local input split of the tile. It
+	 * emits intermediate pairs through mr_emit().
+	 */
+	typedef void (*mr_map_fn)(struct mr_context *, const void *, size_t, void *);
+
+	/**
+	 * @brief Combine function.
+	 *
+	 * @details Merges two values of the same key. It must be
+	 * associative and commutative.
+	 */
+	typedef mr_value_t (*mr_combine_fn)(mr_value_t, mr_value_t);
+
+	/**
+	 * @brief Reduce function.
+	 *
+	 * @details Called once per key, in ascending key order, with all
+	 * values the key was given. When a combine function is set, exactly
+	 * one (combined) value is passed.
+	 */
+	typedef void (*mr_reduce_fn)(const void *, size_t, const mr_value_t *, size_t, void *);
+
+	/**
+	 * @brief Partition function.
+	 *
+	 * @details Returns the tile that reduces a given key.
+	 */
+	typedef int (*mr_partition_fn)(const void *, size_t, int);
+
+	/**
+	 * @brief MapReduce job.
+	 */
+	struct mr_job
+	{
+		mr_map_fn map;             /**< Map function.                 */
+		mr_combine_fn combine;     /**< Combine function (optional).  */
+		mr_reduce_fn reduce;       /**< Reduce function.              */
+		mr_partition_fn partition; /**< Partitioner (optional).       */
+		void *arg;                 /**< User argument.                */
+	};
+
+	/**
+	 * @brief MapReduce job statistics (local tile).
+	 */
+	struct mr_stats
+	{
+		uint64_t map_time;     /**< Map and combine time (ns).       */
+		uint64_t shuffle_time; /**< Time waiting for the shuffle (ns). */
+		uint64_t reduce_time;  /**< Sort and reduce time (ns).       */
+		uint64_t emitted;      /**< Pairs emitted by map.            */
+		uint64_t shuffled;     /**< Pairs sent after combining.      */
+		uint64_t received;     /**< Pairs received.                  */
+		uint64_t keys;         /**< Distinct keys reduced.           */
+		uint64_t msgs_sent;    /**< Shuffle messages sent.           */
+		uint64_t bytes_sent;   /**< Shuffle bytes sent.              */
+	};
+
+	/* Forward definitions. */
+	extern void mr_emit(struct mr_context *, const void *, size_t, mr_value_t);
+	extern int mr_partition_hash(const void *, size_t, int);
+	extern int mr_run(const struct mr_job *, const void *, size_t, struct mr_stats *);
+
+#endif /* MAPREDUCE_H_ */
@@ -0,0 +1,110 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef METRICS_H_
+#define METRICS_H_
+
+	#include <stdint.h>
+
+	#include <noc.h>
+
+	/**
+	 * @brief Socket of the collector (abstract namespace).
+	 */
+	#define METRICS_SOCKET "\0noc-metrics"
+
+	/**
+	 * @brief Sampling period (in milliseconds).
+	 */
+	#define METRICS_PERIOD_MS 1000
+
+	/**
+	 * @brief Default collector tile (overridden by METRICS_TILE).
+	 */
+	#define METRICS_TILE 0
+
+	/**
+	 * @brief Traffic of a port over one period.
+	 */
+	struct metrics_port
+	{
+		uint16_t port;     /**< Port (NOC_STATS_PORTS - 1 for the rest). */
+		uint16_t reserved; /**< Padding.                                 */
+		uint32_t tx_msgs;  /**< Messages sent.                           */
+		uint32_t tx_bytes; /**< Bytes sent.                              */
+		uint32_t rx_msgs;  /**< Messages received.                       */
+		uint32_t rx_bytes; /**< Bytes received.                          */
+	};
+
+	/**
+	 * @brief Record that a tile pushes to the collector every period.
+	 *
+	 * @details Only ports that saw traffic in the period are listed,
+	 * so an idle tile sends a single packet.
+	 */
+	struct metrics_record
+	{
+		uint32_t seq;           /**< Sequence number.                 */
+		uint32_t interval;      /**< Time covered (ms).               */
+		uint32_t cpu_user;      /**< User time (ticks, cumulative).   */
+		uint32_t cpu_system;    /**< System time (ticks, cumulative). */
+		uint32_t cpu_idle;      /**< Idle time (ticks, cumulative).   */
+		uint32_t cpu_iowait;    /**< I/O wait (ticks, cumulative).    */
+		uint32_t mem_total;     /**< Total memory (KB).               */
+		uint32_t mem_free;      /**< Free memory (KB).                */
+		uint32_t mem_cached;    /**< Page cache (KB).                 */
+		uint16_t procs_running; /**< Run queue length.                */
+		uint16_t procs_blocked; /**< Tasks blocked on I/O.            */
+		uint16_t loop_depth;    /**< Queued loopback messages.        */
+		uint16_t partials;      /**< Messages being reassembled.      */
+		uint16_t nports;        /**< Entries in ports.                */
+		uint16_t reserved;      /**< Padding.                         */
+		struct metrics_port ports[NOC_STATS_PORTS]; /**< Active ports. */
+	};
+
+	/**
+	 * @brief Aggregated metrics of a tile, as served by the collector.
+	 */
+	struct metrics_tile
+	{
+		uint32_t records;        /**< Records received (0 if none). */
+		uint32_t lost;           /**< Records lost.                 */
+		uint32_t age;            /**< Age of the last record (ms).  */
+		uint16_t busy;           /**< CPU busy time (per mille).    */
+		uint16_t iowait;         /**< CPU I/O wait (per mille).     */
+		uint16_t procs_running;  /**< Run queue length.             */
+		uint16_t procs_blocked;  /**< Tasks blocked on I/O.         */
+		uint16_t loop_depth;     /**< Queued loopback messages.     */
+		uint16_t partials;       /**< Messages being reassembled.   */
+		uint32_t mem_total;      /**< Total memory (KB).            */
+		uint32_t mem_free;       /**< Free memory (KB).             */
+		uint32_t mem_cached;     /**< Page cache (KB).              */
+		uint32_t tx_rate;        /**< Bytes sent per second.        */
+		uint32_t rx_rate;        /**< Bytes received per second.    */
+		struct
+		{
+			uint64_t tx_msgs;  /**< Messages sent.     */
+			uint64_t tx_bytes; /**< Bytes sent.        */
+			uint64_t rx_msgs;  /**< Messages received. */
+			uint64_t rx_bytes; /**< Bytes received.    */
+		} ports[NOC_STATS_PORTS]; /**< Traffic since the collector started. */
+	};
+
+	/* Forward definitions. */
+	extern int metrics_fetch(struct metrics_tile *, int);
+
+#endif /* METRICS_H_ */
@@ -0,0 +1,232 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NOC_H_
+#define NOC_H_
+
+	#include <sys/types.h>
+	#include <stddef.h>
+	#include <stdint.h>
+
+	/**
+	 * @brief NoC major device number.
+	 */
+	#define NOC_MAJOR 253
+
+	/**
+	 * @brief NoC minor device number.
+	 */
+	#define NOC_MINOR 1
+
+	/**
+	 * @brief NoC device filename.
+	 */
+	#define NOC_DEVNAME "/noc"
+
+	/**
+	 * @brief Physical memory device (poll mode).
+	 */
+	#define NOC_MEMDEV "/dev/mem"
+
+	/**
+	 * @brief Traffic counters shared by the processes of a tile.
+	 */
+	#define NOC_STATS_FILE "/noc.stats"
+
+	/**
+	 * @brief Lock of the network adapter (poll mode).
+	 */
+	#define NOC_POLL_LOCK "/noc.lock"
+
+	/**
+	 * @name Access modes.
+	 */
+	/**@{*/
+	#define NOC_MODE_SYSCALL 0 /**< Through the /noc device driver.   */
+	#define NOC_MODE_POLL    1 /**< Mapped adapter, busy polling.     */
+	/**@}*/
+
+	/**
+	 * @brief Maximum number of tiles addressable in the NoC.
+	 */
+	#define NOC_MAX_TILES 32
+
+	/**
+	 * @brief Maximum packet size (in words), including headers.
+	 */
+	#define NOC_PACKET_WORDS 32
+
+	/**
+	 * @brief Maximum message size (in bytes).
+	 */
+	#define NOC_MSG_MAX 65535
+
+	/**
+	 * @brief Message size used by noc_sendfile() (in bytes).
+	 */
+	#define NOC_SENDFILE_CHUNK (NOC_MSG_MAX & ~3)
+
+	/**
+	 * @brief Data cache line size of the or1k tiles (in bytes).
+	 */
+	#define NOC_CACHE_LINE 32
+
+	/**
+	 * @name Packet header fields.
+	 *
+	 * @details The first word of every packet follows the OpTiMSoC
+	 * layout: destination tile in bits 31:27, packet class in bits
+	 * 26:24 and source tile in bits 23:19.
+	 */
+	/**@{*/
+	#define NOC_HDR(dest, class, src)             \
+		(((uint32_t)(dest) & 0x1f) << 27 |        \
+		 ((uint32_t)(class) & 0x07) << 24 |       \
+		 ((uint32_t)(src) & 0x1f) << 19)
+	#define NOC_HDR_DEST(h)  (((h) >> 27) & 0x1f)
+	#define NOC_HDR_CLASS(h) (((h) >> 24) & 0x07)
+	#define NOC_HDR_SRC(h)   (((h) >> 19) & 0x1f)
+	/**@}*/
+
+	/**
+	 * @brief Packet class used for message traffic.
+	 */
+	#define NOC_CLASS_MSG 0
+
+	/**
+	 * @name Well-known ports.
+	 *
+	 * @details Every message carries a 15-bit port number that
+	 * identifies the subsystem it is addressed to.
+	 */
+	/**@{*/
+	#define NOC_PORT_ANY       0 /**< Wildcard / raw traffic. */
+	#define NOC_PORT_MAPREDUCE 1 /**< MapReduce runtime.      */
+	#define NOC_PORT_BSP       2 /**< BSP library.            */
+	#define NOC_PORT_PIPELINE  3 /**< Pipeline channels.      */
+	#define NOC_PORT_SORT      4 /**< Distributed sort.       */
+	#define NOC_PORT_GEMM      5 /**< Distributed GEMM.       */
+	#define NOC_PORT_ACTOR     6 /**< Actor runtime.          */
+	#define NOC_PORT_CAT       7 /**< noccat streams.         */
+	#define NOC_PORT_CKPT      8 /**< Checkpoint service.     */
+	#define NOC_PORT_PLACE     9 /**< Placement service.      */
+	#define NOC_PORT_METRICS  10 /**< Metrics collection.     */
+	#define NOC_PORT_TRACE    11 /**< Trace clock sync.       */
+	#define NOC_PORT_BRIDGE   12 /**< Host bridge.            */
+	/**@}*/
+
+	/**
+	 * @brief Highest port number.
+	 */
+	#define NOC_PORT_MAX 0x7fff
+
+	/**
+	 * @brief Trace context carried by traced messages.
+	 */
+	struct noc_trace
+	{
+		uint32_t trace; /**< Trace ID (zero if untraced). */
+		uint32_t span;  /**< Span of the sender.          */
+	};
+
+	/**
+	 * @brief Buffer pool statistics.
+	 */
+	struct noc_pool_stats
+	{
+		uint64_t slabs;   /**< Slabs allocated.                */
+		uint64_t bytes;   /**< Bytes held in slabs.            */
+		uint64_t free;    /**< Buffers free in the pool.       */
+		uint64_t refills; /**< Thread cache refills.           */
+		uint64_t flushes; /**< Thread cache flushes.           */
+	};
+
+	/**
+	 * @brief Ports with their own traffic counters.
+	 *
+	 * @details Traffic to higher ports is counted in the last slot.
+	 */
+	#define NOC_STATS_PORTS 16
+
+	/**
+	 * @brief Traffic counters of a port.
+	 */
+	struct noc_port_stats
+	{
+		uint32_t tx_msgs;  /**< Messages sent.     */
+		uint32_t tx_bytes; /**< Bytes sent.        */
+		uint32_t rx_msgs;  /**< Messages received. */
+		uint32_t rx_bytes; /**< Bytes received.    */
+	};
+
+	/**
+	 * @brief Traffic statistics of a tile.
+	 *
+	 * @details Counters wrap around, so only differences between two
+	 * samples are meaningful. Gauges are exact.
+	 */
+	struct noc_stats
+	{
+		struct noc_port_stats ports[NOC_STATS_PORTS]; /**< Per-port counters.          */
+		uint32_t loop_depth;                          /**< Queued loopback messages.   */
+		uint32_t partials;                            /**< Messages being reassembled. */
+	};
+
+	/**
+	 * @brief Selects the rate limit on all traffic of the sender.
+	 */
+	#define NOC_RATE_ALL -1
+
+	/**
+	 * @brief Token bucket of a rate limit.
+	 *
+	 * @details Rates count bytes on the wire, packet headers included.
+	 * Loopback traffic is never limited.
+	 */
+	struct noc_rate
+	{
+		uint32_t rate;      /**< Bytes per second (zero if unlimited). */
+		uint32_t burst;     /**< Bucket size (in bytes).               */
+		uint32_t throttled; /**< Messages delayed.                     */
+		uint64_t waited;    /**< Time spent delayed (in ns).           */
+	};
+
+	/* Forward definitions. */
+	extern int noc_init(void);
+	extern int noc_init_mode(int);
+	extern int noc_mode(void);
+	extern void noc_finalize(void);
+	extern int noc_tile(void);
+	extern int noc_ntiles(void);
+	extern int noc_mesh_width(void);
+	extern ssize_t noc_send(int, int, const void *, size_t);
+	extern ssize_t noc_recv(int *, int *, void *, size_t);
+	extern int noc_poll(int);
+	extern ssize_t noc_recv_buf(int *, int *, void **);
+	extern ssize_t noc_sendfile(int, int, int, size_t);
+	extern void *noc_buf_alloc(size_t);
+	extern void noc_buf_ref(void *);
+	extern void noc_buf_free(void *);
+	extern size_t noc_buf_size(const void *);
+	extern void noc_pool_get_stats(struct noc_pool_stats *);
+	extern void noc_get_stats(struct noc_stats *);
+	extern void noc_trace_set(const struct noc_trace *);
+	extern void noc_trace_get(struct noc_trace *);
+	extern int noc_rate_set(int, uint32_t, uint32_t);
+	extern int noc_rate_get(int, struct noc_rate *);
+
+#endif /* NOC_H_ */
@@ -0,0 +1,96 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PIPELINE_H_
+#define PIPELINE_H_
+
+	#include <stddef.h>
+	#include <stdint.h>
+
+	/**
+	 * @brief Maximum number of stages in a pipeline.
+	 */
+	#define PL_MAX_STAGES 16
+
+	/**
+	 * @brief Maximum record size (in bytes).
+	 */
+	#define PL_RECORD_MAX 1024
+
+	/**
+	 * @name Source return values.
+	 */
+	/**@{*/
+	#define PL_DONE 0 /**< End of stream.           */
+	#define PL_MORE 1 /**< More records to produce. */
+	/**@}*/
+
+	/**
+	 * @brief Opaque stage context.
+	 */
+	struct pl_context;
+
+	/**
+	 * @brief Stage function.
+	 *
+	 * @details The first stage is a source: it is called with no record
+	 * until it returns PL_DONE. Other stages are called once per record.
+	 * Stages pass records on with pl_emit(). A negative return value
+	 * aborts the pipeline.
+	 */
+	typedef int (*pl_fn)(struct pl_context *, const void *, size_t, void *);
+
+	/**
+	 * @brief Pipeline stage.
+	 */
+	struct pl_stage
+	{
+		const char *name; /**< Stage name.                        */
+		int tile;         /**< Tile that runs the stage.          */
+		pl_fn fn;         /**< Stage function.                    */
+		void *arg;        /**< User argument.                     */
+	};
+
+	/**
+	 * @brief Stage statistics.
+	 *
+	 * @details Consecutive stages placed on the same tile are fused and
+	 * share one input channel, so time and occupancy counters describe
+	 * the whole group.
+	 */
+	struct pl_stats
+	{
+		uint64_t records_in;      /**< Records consumed.                  */
+		uint64_t records_out;     /**< Records emitted.                   */
+		uint64_t batches_in;      /**< Batches received.                  */
+		uint64_t batches_out;     /**< Batches sent.                      */
+		uint64_t elapsed;         /**< Wall time (ns).                    */
+		uint64_t busy_time;       /**< Time spent computing (ns).         */
+		uint64_t starve_time;     /**< Time waiting for input (ns).       */
+		uint64_t block_time;      /**< Time waiting for credits (ns).     */
+		uint64_t occupancy_sum;   /**< Sum of input queue samples.        */
+		uint64_t occupancy_count; /**< Number of input queue samples.     */
+		uint32_t occupancy_max;   /**< Largest input queue length.        */
+		uint32_t tile;            /**< Tile that ran the stage.           */
+	};
+
+	/* Forward definitions. */
+	extern int pl_emit(struct pl_context *, const void *, size_t);
+	extern int pl_run(const struct pl_stage *, int, struct pl_stats *);
+	extern int pl_bottleneck(const struct pl_stats *, int);
+
+#endif /* PIPELINE_H_ */
@@ -0,0 +1,95 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PLACE_H_
+#define PLACE_H_
+
+	#include <stdint.h>
+
+	#include <noc.h>
+
+	/**
+	 * @brief Socket of the placement service (abstract namespace).
+	 */
+	#define PLACE_SOCKET "\0noc-place"
+
+	/**
+	 * @brief Load report period (in milliseconds).
+	 */
+	#define PLACE_PERIOD_MS 100
+
+	/**
+	 * @brief Age after which a tile is deemed down (in milliseconds).
+	 */
+	#define PLACE_STALE_MS (4*PLACE_PERIOD_MS)
+
+	/**
+	 * @name Placement policies.
+	 */
+	/**@{*/
+	#define PLACE_P2C   0 /**< Power of two choices.  */
+	#define PLACE_LEAST 1 /**< Least loaded tile.     */
+	#define PLACE_LOCAL 2 /**< Local tile (baseline). */
+	/**@}*/
+
+	/**
+	 * @name Requests.
+	 */
+	/**@{*/
+	#define PLACE_OP_PICK  0 /**< Choose a tile.       */
+	#define PLACE_OP_TABLE 1 /**< Dump the load table. */
+	/**@}*/
+
+	/**
+	 * @brief Load of a tile.
+	 *
+	 * @details Also the payload of the load reports that tiles exchange
+	 * over the NoC, which is why it is kept this small.
+	 */
+	struct place_load
+	{
+		uint16_t runnable; /**< Runnable tasks.                        */
+		uint16_t busy;     /**< CPU busy time (per mille).             */
+		uint16_t pending;  /**< Tasks placed since the last report.    */
+		uint16_t age;      /**< Age of the report (ms, 0xffff if down). */
+	};
+
+	/**
+	 * @brief Request to the placement service.
+	 */
+	struct place_req
+	{
+		uint8_t op;     /**< Request.  */
+		uint8_t policy; /**< Policy.   */
+	};
+
+	/**
+	 * @brief Reply of the placement service.
+	 */
+	struct place_rep
+	{
+		int32_t tile;                           /**< Chosen tile (-1 on error). */
+		uint32_t ntiles;                        /**< Entries in the table.      */
+		struct place_load loads[NOC_MAX_TILES]; /**< Load table.                */
+	};
+
+	/* Forward definitions. */
+	extern int place_pick(int);
+	extern int place_table(struct place_load *, int);
+	extern void place_close(void);
+
+#endif /* PLACE_H_ */
@@ -0,0 +1,74 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+	#include <stdint.h>
+	#include <stdio.h>
+
+	/**
+	 * @brief Events kept in the ring of a process.
+	 */
+	#define TRACE_RING 4096
+
+	/**
+	 * @brief Maximum length of a span name, terminator included.
+	 */
+	#define TRACE_NAME_MAX 16
+
+	/**
+	 * @brief Maximum nesting of spans in a thread.
+	 */
+	#define TRACE_DEPTH 16
+
+	/**
+	 * @brief Round trips per tile in a clock synchronization.
+	 */
+	#define TRACE_SYNC_ROUNDS 16
+
+	/**
+	 * @name Event types.
+	 */
+	/**@{*/
+	#define TRACE_BEGIN 'B' /**< Span started. */
+	#define TRACE_END   'E' /**< Span ended.   */
+	/**@}*/
+
+	/**
+	 * @brief Trace event.
+	 */
+	struct trace_event
+	{
+		uint64_t time;              /**< Synchronized time (ns). */
+		uint32_t trace;             /**< Trace ID.               */
+		uint32_t span;              /**< Span ID.                */
+		uint32_t parent;            /**< Parent span (0 if none). */
+		char type;                  /**< Event type.             */
+		char name[TRACE_NAME_MAX];  /**< Span name.              */
+	};
+
+	/* Forward definitions. */
+	extern int trace_sync(int);
+	extern int64_t trace_offset(void);
+	extern uint32_t trace_begin(const char *);
+	extern uint32_t trace_join(const char *);
+	extern void trace_end(void);
+	extern void trace_reset(void);
+	extern int trace_dump(FILE *);
+
+#endif /* TRACE_H_ */
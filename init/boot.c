@@ -0,0 +1,348 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/klog.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <noc.h>
+
+#include "init.h"
+
+/**
+ * @brief Maximum number of boot markers.
+ */
+#define BOOT_MARKS 32
+
+/**
+ * @brief Maximum length of a marker name.
+ */
+#define BOOT_NAME_MAX 32
+
+/**
+ * @brief Slowest kernel initcalls reported, besides the NoC driver.
+ */
+#define BOOT_PROBES 4
+
+/**
+ * @brief How long the report waits for the first message (in ms).
+ */
+#define BOOT_WAIT_MS 5000
+
+/**
+ * @name Kernel log actions (see syslog(2)).
+ */
+/**@{*/
+#define BOOT_KLOG_READ_ALL 3
+#define BOOT_KLOG_SIZE     10
+/**@}*/
+
+/**
+ * @brief Boot marker.
+ */
+struct boot_mark
+{
+	char name[BOOT_NAME_MAX]; /**< Marker name.                      */
+	uint64_t time;            /**< Time since boot (us).             */
+	uint64_t dur;             /**< Duration of the phase (us, or 0). */
+};
+
+/**
+ * @brief Boot markers of the tile.
+ */
+static struct
+{
+	pthread_mutex_t lock;              /**< Protects the markers.  */
+	pthread_cond_t cond;               /**< Signals new markers.   */
+	int n;                             /**< Markers recorded.      */
+	struct boot_mark marks[BOOT_MARKS]; /**< Markers.              */
+} boot = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+/**
+ * @brief Returns the time since boot (in microseconds).
+ *
+ * @details CLOCK_BOOTTIME and the printk timestamps both start when
+ * the kernel sets up its clock, right after it starts.
+ */
+static uint64_t boot_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_BOOTTIME, &ts);
+
+	return ((uint64_t) ts.tv_sec*1000000 + ts.tv_nsec/1000);
+}
+
+/**
+ * @brief Adds a marker (lock held).
+ */
+static void boot_add(const char *name, size_t len, uint64_t time, uint64_t dur)
+{
+	struct boot_mark *m;
+
+	if (boot.n == BOOT_MARKS)
+		return;
+
+	m = &boot.marks[boot.n++];
+	if (len >= BOOT_NAME_MAX)
+		len = BOOT_NAME_MAX - 1;
+	memcpy(m->name, name, len);
+	m->name[len] = '\0';
+	m->time = time;
+	m->dur = dur;
+}
+
+/**
+ * @brief Looks a marker up (lock held).
+ */
+static struct boot_mark *boot_find(const char *name)
+{
+	for (int i = 0; i < boot.n; i++)
+	{
+		if (strcmp(boot.marks[i].name, name) == 0)
+			return (&boot.marks[i]);
+	}
+
+	return (NULL);
+}
+
+/**
+ * @brief Records a boot marker.
+ *
+ * @details Only the first marker of a given name is kept.
+ *
+ * @param name Marker name.
+ */
+void boot_mark(const char *name)
+{
+	uint64_t now = boot_now();
+
+	pthread_mutex_lock(&boot.lock);
+	if (boot_find(name) == NULL)
+	{
+		boot_add(name, strlen(name), now, 0);
+		pthread_cond_broadcast(&boot.cond);
+	}
+	pthread_mutex_unlock(&boot.lock);
+}
+
+/**
+ * @brief Parses the timestamp of a kernel log line.
+ *
+ * @returns The text after the timestamp, or NULL if there is none.
+ */
+static const char *boot_klog_time(const char *line, uint64_t *time)
+{
+	unsigned long sec, usec;
+	int n = 0;
+
+	/* Log level. */
+	if ((line[0] == '<') && ((line = strchr(line, '>')) != NULL))
+		line++;
+
+	if ((line == NULL) || (sscanf(line, " [ %lu.%lu]%n", &sec, &usec, &n) != 2) || (n == 0))
+		return (NULL);
+
+	*time = (uint64_t) sec*1000000 + usec;
+
+	return (line + n);
+}
+
+/**
+ * @brief Collects kernel markers from the kernel log.
+ *
+ * @details Needs printk timestamps (CONFIG_PRINTK_TIME or printk.time=1
+ * on the command line). Driver probes are only logged with
+ * initcall_debug; the NoC driver and the slowest BOOT_PROBES initcalls
+ * are kept.
+ *
+ * @returns The number of markers found, or -1 if the log cannot be
+ * read or is not timestamped.
+ */
+static int boot_klog(void)
+{
+	int size, n, found = 0;
+	char *buf, *line, *next;
+	struct boot_mark probes[BOOT_PROBES];
+	int nprobes = 0;
+
+	if ((size = klogctl(BOOT_KLOG_SIZE, NULL, 0)) <= 0)
+		return (-1);
+	if ((buf = malloc(size + 1)) == NULL)
+		return (-1);
+	if ((n = klogctl(BOOT_KLOG_READ_ALL, buf, size)) < 0)
+	{
+		free(buf);
+		return (-1);
+	}
+	buf[n] = '\0';
+
+	memset(probes, 0, sizeof(probes));
+
+	pthread_mutex_lock(&boot.lock);
+
+	for (line = buf; line != NULL; line = next)
+	{
+		uint64_t time;
+		unsigned long usecs;
+		const char *msg, *p, *q;
+
+		if ((next = strchr(line, '\n')) != NULL)
+			*next++ = '\0';
+
+		if ((msg = boot_klog_time(line, &time)) == NULL)
+			continue;
+		found++;
+
+		if (strstr(msg, "Linux version") != NULL)
+			boot_add("kernel_start", strlen("kernel_start"), time, 0);
+		else if ((strstr(msg, "unpack rootfs") != NULL) || (strstr(msg, "Unpacking initramfs") != NULL))
+			boot_add("initramfs_start", strlen("initramfs_start"), time, 0);
+		else if (strstr(msg, "Freeing unused kernel memory") != NULL)
+			boot_add("kernel_done", strlen("kernel_done"), time, 0);
+		else if (((p = strstr(msg, "initcall ")) != NULL) && ((q = strstr(p, " after ")) != NULL) &&
+			(sscanf(q, " after %lu usecs", &usecs) == 1))
+		{
+			int slot;
+			char name[BOOT_NAME_MAX];
+			size_t len;
+
+			p += strlen("initcall ");
+			len = strcspn(p, "+ ");
+			snprintf(name, sizeof(name), "probe:%.*s", (int) len, p);
+
+			/* The NoC driver and the initramfs are always reported. */
+			if ((strstr(name, "noc") != NULL) || (strcmp(name, "probe:populate_rootfs") == 0))
+			{
+				boot_add(name, strlen(name), time, usecs);
+				continue;
+			}
+
+			/* Otherwise, keep the slowest ones. */
+			slot = (nprobes < BOOT_PROBES) ? nprobes++ : -1;
+			for (int i = 0; (slot < 0) && (i < BOOT_PROBES); i++)
+			{
+				if ((probes[i].dur < usecs) &&
+					((slot < 0) || (probes[i].dur < probes[slot].dur)))
+					slot = i;
+			}
+			if (slot >= 0)
+			{
+				strcpy(probes[slot].name, name);
+				probes[slot].time = time;
+				probes[slot].dur = usecs;
+			}
+		}
+	}
+
+	for (int i = 0; i < nprobes; i++)
+		boot_add(probes[i].name, strlen(probes[i].name), probes[i].time, probes[i].dur);
+
+	pthread_mutex_unlock(&boot.lock);
+
+	free(buf);
+
+	return ((found > 0) ? found : -1);
+}
+
+/**
+ * @brief Compares markers by time.
+ */
+static int boot_cmp(const void *a, const void *b)
+{
+	const struct boot_mark *x = a;
+	const struct boot_mark *y = b;
+
+	return ((x->time > y->time) - (x->time < y->time));
+}
+
+/**
+ * @brief Prints the boot report.
+ */
+static void *boot_report_loop(void *arg)
+{
+	struct timespec deadline;
+	int kernel;
+
+	((void) arg);
+
+	/* Wait for the first message, but not forever. */
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += BOOT_WAIT_MS/1000;
+	deadline.tv_nsec += (BOOT_WAIT_MS%1000)*1000000;
+	if (deadline.tv_nsec >= 1000000000)
+	{
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000;
+	}
+
+	pthread_mutex_lock(&boot.lock);
+	while (boot_find("first_msg") == NULL)
+	{
+		if (pthread_cond_timedwait(&boot.cond, &boot.lock, &deadline) == ETIMEDOUT)
+			break;
+	}
+	pthread_mutex_unlock(&boot.lock);
+
+	kernel = boot_klog();
+
+	pthread_mutex_lock(&boot.lock);
+	qsort(boot.marks, boot.n, sizeof(struct boot_mark), boot_cmp);
+	for (int i = 0; i < boot.n; i++)
+	{
+		printf("boot tile=%d mark=%s t_us=%" PRIu64, noc_tile(),
+			boot.marks[i].name, boot.marks[i].time);
+		if (boot.marks[i].dur > 0)
+			printf(" dur_us=%" PRIu64, boot.marks[i].dur);
+		printf("\n");
+	}
+	printf("boot tile=%d marks=%d kernel=%s total_us=%" PRIu64 "\n", noc_tile(), boot.n,
+		(kernel < 0) ? "untimed" : "timed", (boot_find("ready") != NULL) ? boot_find("ready")->time : 0);
+	fflush(stdout);
+	pthread_mutex_unlock(&boot.lock);
+
+	return (NULL);
+}
+
+/**
+ * @brief Prints the boot report once boot is over.
+ *
+ * @details Boot is over when the first NoC message arrives, or after
+ * BOOT_WAIT_MS if none does. The report merges the markers recorded by
+ * init with those found in the kernel log, one "boot ..." line each,
+ * as read by tools/boot-compare.sh.
+ *
+ * @returns Zero upon success and -1 otherwise.
+ */
+int boot_report(void)
+{
+	pthread_t tid;
+
+	if ((errno = pthread_create(&tid, NULL, boot_report_loop, NULL)) != 0)
+		return (-1);
+	pthread_detach(tid);
+
+	return (0);
+}
@@ -0,0 +1,64 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INIT_H_
+#define INIT_H_
+
+	#include <stddef.h>
+
+	/**
+	 * @brief System statistics (/proc/stat).
+	 */
+	struct proc_stat
+	{
+		unsigned long long user;    /**< User time (ticks).       */
+		unsigned long long nice;    /**< Niced user time (ticks). */
+		unsigned long long system;  /**< System time (ticks).     */
+		unsigned long long idle;    /**< Idle time (ticks).       */
+		unsigned long long iowait;  /**< I/O wait (ticks).        */
+		unsigned long long irq;     /**< IRQ time (ticks).        */
+		unsigned long long softirq; /**< Soft IRQ time (ticks).   */
+		unsigned long long steal;   /**< Stolen time (ticks).     */
+		long running;               /**< Runnable tasks.          */
+		long blocked;               /**< Tasks blocked on I/O.    */
+	};
+
+	/**
+	 * @brief Memory statistics (/proc/meminfo, in KB).
+	 */
+	struct proc_meminfo
+	{
+		unsigned long total;  /**< Total memory. */
+		unsigned long free;   /**< Free memory.  */
+		unsigned long cached; /**< Page cache.   */
+	};
+
+	/* Forward definitions. */
+	extern int init_listen(const char *, size_t, int);
+	extern int proc_read_stat(struct proc_stat *);
+	extern int proc_read_meminfo(struct proc_meminfo *);
+	extern int place_serve(void);
+	extern void place_update(int, const void *, size_t);
+	extern int metrics_start(void);
+	extern void metrics_update(int, const void *, size_t);
+	extern void boot_mark(const char *);
+	extern int boot_report(void);
+	extern int service_init(void);
+	extern int service_noc(void);
+	extern int service_start(void);
+
+#endif /* INIT_H_ */
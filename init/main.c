@@ -15,32 +15,41 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/un.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
-/**
- * @brief NoC major device number.
- */
-#define NOC_MAJOR 253
+#include <noc.h>
 
-/**
- * @brief NoC minor device number.
- */
-#define NOC_MINOR 1
+#include "init.h"
 
 /**
  * Buffer size.
  */
 #define BUF_SIZE 16
 
+/**
+ * @name Physical memory device number.
+ */
+/**@{*/
+#define MEM_MAJOR 1
+#define MEM_MINOR 1
+/**@}*/
+
 /**
  * @brief NoC device filename.
  */
-const char *devname = "/noc";
+const char *devname = NOC_DEVNAME;
 
 /**
  * @brief Panics the utility.
@@ -66,29 +75,169 @@ static void init_noc(const char *pathname)
 		panic();
 }
 
-int main(int argc, char **argv)
+/**
+ * @brief Polling variant.
+ *
+ * @details Selected with NOC_MODE=poll on the kernel command line. The
+ * network adapter is mapped through the physical memory device and
+ * drained by busy polling, without the NoC driver.
+ */
+static void init_poll(void)
 {
-	int fd;   /* NoC device file descriptor. */
-	int ret;  /* Return value of syscalls    */
-	int buf[10]; /* Buffer for I/O operations.  */
-
-	init_noc(devname);
+	/* Create device file. */
+	if ((mkdir("/dev", S_IRWXU) != 0) && (errno != EEXIST))
+		panic();
+	if ((mknod(NOC_MEMDEV, S_IFCHR | S_IRUSR | S_IWUSR, makedev(MEM_MAJOR, MEM_MINOR)) != 0) &&
+		(errno != EEXIST))
+		panic();
+	boot_mark("noc_dev");
 
-	/* Open NoC device. */
-	fd = ret = open(devname, O_RDWR);
-	if (ret < 0)
+	if (noc_init_mode(NOC_MODE_POLL) < 0)
 		panic();
+}
+
+/**
+ * @brief Opens a listening socket in the abstract namespace.
+ *
+ * @param name    Socket name, leading null byte included.
+ * @param len     Length of @p name.
+ * @param backlog Pending connections.
+ *
+ * @returns A socket file descriptor upon success and -1 otherwise.
+ */
+int init_listen(const char *name, size_t len, int backlog)
+{
+	int fd;
+	struct sockaddr_un addr;
+
+	if (len > sizeof(addr.sun_path))
+	{
+		errno = ENAMETOOLONG;
+		return (-1);
+	}
+
+	if ((fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0)) < 0)
+		return (-1);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	memcpy(addr.sun_path, name, len);
+
+	if ((bind(fd, (struct sockaddr *) &addr, offsetof(struct sockaddr_un, sun_path) + len) < 0) ||
+		(listen(fd, backlog) < 0))
+	{
+		close(fd);
+		return (-1);
+	}
+
+	return (fd);
+}
+
+/**
+ * @brief Receives NoC messages addressed to init.
+ *
+ * @details Hands each message to the service that owns its port. Only
+ * runs on tiles where no service receives from the NoC (see
+ * service_noc()), so messages to any other port have no one to go to,
+ * and are dropped.
+ */
+static void *init_rx(void *arg)
+{
+	int src, port;
+	int first = 1;
+	ssize_t n;
+	static char buf[NOC_MSG_MAX];
+
+	((void) arg);
 
-	/* Read some data. */
 	while (1)
 	{
-		ret = read(fd, buf, sizeof(int));
-		if (ret < 0)
+		if ((n = noc_recv(&src, &port, buf, sizeof(buf))) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			panic();
+		}
+		if (first)
+		{
+			boot_mark("first_msg");
+			first = 0;
+		}
+
+		switch (port)
+		{
+			case NOC_PORT_PLACE:
+				place_update(src, buf, n);
+				break;
+
+			case NOC_PORT_METRICS:
+				metrics_update(src, buf, n);
+				break;
+
+			default:
+				break;
+		}
+	}
+
+	return (NULL);
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t rx;
+	sigset_t set;
+
+	boot_mark("init_start");
+
+	/* Children are reaped by the service supervisor only. */
+	sigemptyset(&set);
+	sigaddset(&set, SIGCHLD);
+	pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+	if ((getenv("NOC_MODE") != NULL) && (strcmp(getenv("NOC_MODE"), "poll") == 0))
+		init_poll();
+	else
+	{
+		init_noc(devname);
+		boot_mark("noc_dev");
+		if (noc_init_mode(NOC_MODE_SYSCALL) < 0)
 			panic();
 	}
+	boot_mark("noc_open");
+
+	if (service_init() < 0)
+		perror("services");
+
+	/*
+	 * The adapter is left to services that receive from the NoC. Load
+	 * reports and metrics records that reach the tile are then lost,
+	 * so it places locally and should not be METRICS_TILE. In poll
+	 * mode, the adapter has a single user: init does not even send.
+	 */
+	if (!service_noc())
+	{
+		if ((errno = pthread_create(&rx, NULL, init_rx, NULL)) != 0)
+			panic();
+	}
+	else if (noc_mode() == NOC_MODE_POLL)
+		noc_finalize();
+
+	/* Start services. */
+	if (metrics_start() < 0)
+		perror("metrics");
+	boot_mark("ready");
+	if (boot_report() < 0)
+		perror("boot");
+	if (service_start() < 0)
+		perror("services");
+	if (place_serve() < 0)
+		perror("place");
+
+	while (1)
+		pause();
 
 	/* Close NoC device. */
-	close(fd);
+	noc_finalize();
 
 	/* Stop here. */
 	return (EXIT_SUCCESS);
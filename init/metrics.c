@@ -0,0 +1,337 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <sys/socket.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <metrics.h>
+#include <noc.h>
+
+#include "init.h"
+
+/**
+ * @brief Size of a record without its port list.
+ */
+#define METRICS_HDR_SIZE offsetof(struct metrics_record, ports)
+
+/**
+ * @brief Metrics service.
+ */
+static struct
+{
+	pthread_mutex_t lock;                     /**< Guards the tables.        */
+	int tile;                                 /**< This tile.                */
+	int collector;                            /**< Collector tile.           */
+	int fd;                                   /**< Listening socket, or -1.  */
+	uint32_t seq;                             /**< Next record number.       */
+	uint64_t last;                            /**< Time of the last sample.  */
+	struct noc_stats prev;                    /**< Counters at the last sample. */
+	struct metrics_tile tiles[NOC_MAX_TILES]; /**< Aggregated metrics.       */
+	struct metrics_record recs[NOC_MAX_TILES]; /**< Last record of each tile. */
+	uint64_t stamp[NOC_MAX_TILES];            /**< Arrival of the last record. */
+} metrics = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.fd = -1,
+};
+
+/**
+ * @brief Returns the current time in milliseconds.
+ */
+static uint64_t metrics_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((uint64_t) ts.tv_sec*1000 + ts.tv_nsec/1000000);
+}
+
+/**
+ * @brief Clamps a gauge to 16 bits.
+ */
+static uint16_t metrics_u16(unsigned long val)
+{
+	return ((val > 0xffff) ? 0xffff : val);
+}
+
+/**
+ * @brief Samples this tile and pushes a record to the collector.
+ *
+ * @details Traffic is sent as the difference since the previous
+ * sample, which keeps the 32-bit wrapping counters of libnoc usable.
+ * IRQ and stolen time are charged to the system.
+ */
+static void metrics_sample(void)
+{
+	uint64_t now;
+	struct noc_stats cur;
+	struct proc_stat st;
+	struct proc_meminfo mi;
+	struct metrics_record rec;
+
+	memset(&rec, 0, sizeof(rec));
+
+	now = metrics_now();
+	rec.seq = metrics.seq++;
+	rec.interval = now - metrics.last;
+	metrics.last = now;
+
+	if (proc_read_stat(&st) == 0)
+	{
+		rec.cpu_user = st.user + st.nice;
+		rec.cpu_system = st.system + st.irq + st.softirq + st.steal;
+		rec.cpu_idle = st.idle;
+		rec.cpu_iowait = st.iowait;
+		rec.procs_running = metrics_u16(st.running);
+		rec.procs_blocked = metrics_u16(st.blocked);
+	}
+
+	if (proc_read_meminfo(&mi) == 0)
+	{
+		rec.mem_total = mi.total;
+		rec.mem_free = mi.free;
+		rec.mem_cached = mi.cached;
+	}
+
+	noc_get_stats(&cur);
+	rec.loop_depth = metrics_u16(cur.loop_depth);
+	rec.partials = metrics_u16(cur.partials);
+	for (int i = 0; i < NOC_STATS_PORTS; i++)
+	{
+		struct metrics_port *p = &rec.ports[rec.nports];
+
+		p->port = i;
+		p->tx_msgs = cur.ports[i].tx_msgs - metrics.prev.ports[i].tx_msgs;
+		p->tx_bytes = cur.ports[i].tx_bytes - metrics.prev.ports[i].tx_bytes;
+		p->rx_msgs = cur.ports[i].rx_msgs - metrics.prev.ports[i].rx_msgs;
+		p->rx_bytes = cur.ports[i].rx_bytes - metrics.prev.ports[i].rx_bytes;
+
+		if (p->tx_msgs | p->rx_msgs)
+			rec.nports++;
+	}
+	metrics.prev = cur;
+
+	/* Not through the loopback queue, which init may not read. */
+	if (metrics.collector == metrics.tile)
+		metrics_update(metrics.tile, &rec, METRICS_HDR_SIZE + rec.nports*sizeof(struct metrics_port));
+	else
+	{
+		noc_send(metrics.collector, NOC_PORT_METRICS, &rec,
+			METRICS_HDR_SIZE + rec.nports*sizeof(struct metrics_port));
+	}
+}
+
+/**
+ * @brief Folds a record into the metrics of a tile.
+ *
+ * @details Runs on the collector.
+ */
+void metrics_update(int src, const void *buf, size_t len)
+{
+	struct metrics_record rec;
+	struct metrics_record *prev;
+	struct metrics_tile *t;
+	uint64_t tx = 0, rx = 0;
+
+	if ((src >= NOC_MAX_TILES) || (len < METRICS_HDR_SIZE) || (len > sizeof(rec)))
+		return;
+	memcpy(&rec, buf, len);
+	if ((rec.nports > NOC_STATS_PORTS) ||
+		(len != METRICS_HDR_SIZE + rec.nports*sizeof(struct metrics_port)))
+		return;
+
+	pthread_mutex_lock(&metrics.lock);
+
+	t = &metrics.tiles[src];
+	prev = &metrics.recs[src];
+
+	/* CPU time since the previous record. */
+	if (t->records > 0)
+	{
+		uint32_t busy = (rec.cpu_user - prev->cpu_user) + (rec.cpu_system - prev->cpu_system);
+		uint32_t iowait = rec.cpu_iowait - prev->cpu_iowait;
+		uint32_t total = busy + iowait + (rec.cpu_idle - prev->cpu_idle);
+
+		if (total > 0)
+		{
+			t->busy = ((uint64_t) busy*1000)/total;
+			t->iowait = ((uint64_t) iowait*1000)/total;
+		}
+
+		/* Sequence numbers restart with init. */
+		if (rec.seq > prev->seq)
+			t->lost += rec.seq - prev->seq - 1;
+	}
+
+	t->records++;
+	t->procs_running = rec.procs_running;
+	t->procs_blocked = rec.procs_blocked;
+	t->loop_depth = rec.loop_depth;
+	t->partials = rec.partials;
+	t->mem_total = rec.mem_total;
+	t->mem_free = rec.mem_free;
+	t->mem_cached = rec.mem_cached;
+
+	for (int i = 0; i < rec.nports; i++)
+	{
+		const struct metrics_port *p = &rec.ports[i];
+
+		if (p->port >= NOC_STATS_PORTS)
+			continue;
+
+		t->ports[p->port].tx_msgs += p->tx_msgs;
+		t->ports[p->port].tx_bytes += p->tx_bytes;
+		t->ports[p->port].rx_msgs += p->rx_msgs;
+		t->ports[p->port].rx_bytes += p->rx_bytes;
+		tx += p->tx_bytes;
+		rx += p->rx_bytes;
+	}
+	if (rec.interval > 0)
+	{
+		t->tx_rate = (tx*1000)/rec.interval;
+		t->rx_rate = (rx*1000)/rec.interval;
+	}
+
+	*prev = rec;
+	metrics.stamp[src] = metrics_now();
+
+	pthread_mutex_unlock(&metrics.lock);
+}
+
+/**
+ * @brief Serves the aggregated metrics to a client.
+ *
+ * @details The whole table goes in a single message, one entry per
+ * tile.
+ */
+static void metrics_dump(int fd)
+{
+	int ntiles = noc_ntiles();
+	uint64_t now = metrics_now();
+	static struct metrics_tile tiles[NOC_MAX_TILES];
+
+	pthread_mutex_lock(&metrics.lock);
+	memcpy(tiles, metrics.tiles, ntiles*sizeof(struct metrics_tile));
+	for (int i = 0; i < ntiles; i++)
+	{
+		if (tiles[i].records > 0)
+			tiles[i].age = now - metrics.stamp[i];
+	}
+	pthread_mutex_unlock(&metrics.lock);
+
+	send(fd, tiles, ntiles*sizeof(struct metrics_tile), MSG_NOSIGNAL);
+}
+
+/**
+ * @brief Metrics thread.
+ */
+static void *metrics_loop(void *arg)
+{
+	uint64_t next = metrics_now() + METRICS_PERIOD_MS;
+	struct pollfd fds;
+
+	((void) arg);
+
+	while (1)
+	{
+		int timeout;
+		uint64_t now = metrics_now();
+
+		if (now >= next)
+		{
+			metrics_sample();
+			next += METRICS_PERIOD_MS;
+			if (next <= now)
+				next = now + METRICS_PERIOD_MS;
+		}
+		timeout = next - now;
+
+		fds.fd = metrics.fd;
+		fds.events = POLLIN;
+		if (poll(&fds, 1, timeout) <= 0)
+			continue;
+
+		/* Client: send the table and hang up. */
+		if (fds.revents & POLLIN)
+		{
+			int client;
+
+			if ((client = accept4(metrics.fd, NULL, NULL, SOCK_CLOEXEC)) >= 0)
+			{
+				metrics_dump(client);
+				close(client);
+			}
+		}
+	}
+
+	return (NULL);
+}
+
+/**
+ * @brief Starts the metrics service.
+ *
+ * @details Every tile samples its CPU time, run queue, memory and NoC
+ * traffic every METRICS_PERIOD_MS and pushes a record to the collector
+ * tile, METRICS_TILE unless set otherwise in the environment. The
+ * collector aggregates the records and serves them on METRICS_SOCKET.
+ *
+ * @returns Zero upon success and -1 otherwise.
+ */
+int metrics_start(void)
+{
+	char *end;
+	const char *str;
+	pthread_t tid;
+
+	metrics.tile = noc_tile();
+	metrics.collector = METRICS_TILE;
+	if ((str = getenv("METRICS_TILE")) != NULL)
+	{
+		long val = strtol(str, &end, 0);
+
+		if ((*str != '\0') && (*end == '\0') && (val >= 0) && (val < noc_ntiles()))
+			metrics.collector = val;
+	}
+
+	if (metrics.tile == metrics.collector)
+	{
+		if ((metrics.fd = init_listen(METRICS_SOCKET, sizeof(METRICS_SOCKET) - 1, 4)) < 0)
+			return (-1);
+	}
+
+	metrics.last = metrics_now();
+	noc_get_stats(&metrics.prev);
+
+	if ((errno = pthread_create(&tid, NULL, metrics_loop, NULL)) != 0)
+	{
+		if (metrics.fd >= 0)
+			close(metrics.fd);
+		metrics.fd = -1;
+		return (-1);
+	}
+	pthread_detach(tid);
+
+	return (0);
+}
@@ -0,0 +1,360 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <sys/socket.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <noc.h>
+#include <place.h>
+
+#include "init.h"
+
+/**
+ * @brief Maximum number of connected clients.
+ */
+#define PLACE_MAX_CLIENTS 16
+
+/**
+ * @brief Score of one queued task, against at most 1000 for CPU time.
+ */
+#define PLACE_TASK_WEIGHT 1000
+
+/**
+ * @brief Placement service.
+ */
+static struct
+{
+	pthread_mutex_t lock;                     /**< Guards the load table.      */
+	struct place_load loads[NOC_MAX_TILES];   /**< Load table.                 */
+	uint64_t stamp[NOC_MAX_TILES];            /**< Last report (ms), 0 if none. */
+	unsigned long long total;                 /**< Last CPU time sample.       */
+	unsigned long long idle;                  /**< Last idle time sample.      */
+	uint32_t seed;                            /**< Random number generator.    */
+	int tile;                                 /**< This tile.                  */
+	int ntiles;                               /**< Number of tiles.            */
+	int nclients;                             /**< Connected clients.          */
+	struct pollfd fds[1 + PLACE_MAX_CLIENTS]; /**< Listener and clients.       */
+} place = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/**
+ * @brief Returns the current time in milliseconds.
+ */
+static uint64_t place_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((uint64_t) ts.tv_sec*1000 + ts.tv_nsec/1000000);
+}
+
+/**
+ * @brief Draws a random number (xorshift).
+ */
+static uint32_t place_rand(void)
+{
+	place.seed ^= place.seed << 13;
+	place.seed ^= place.seed >> 17;
+	place.seed ^= place.seed << 5;
+
+	return (place.seed);
+}
+
+/**
+ * @brief Samples the load of this tile.
+ *
+ * @details The run queue length is procs_running, minus init itself,
+ * and the CPU load is the busy share of the time elapsed since the
+ * previous sample.
+ */
+static void place_sample(struct place_load *l)
+{
+	struct proc_stat st;
+	unsigned long long total, idle, dtotal, didle;
+
+	memset(l, 0, sizeof(struct place_load));
+
+	if (proc_read_stat(&st) < 0)
+		return;
+
+	total = st.user + st.nice + st.system + st.idle + st.iowait + st.irq + st.softirq + st.steal;
+	idle = st.idle + st.iowait;
+	dtotal = total - place.total;
+	didle = idle - place.idle;
+	if ((place.total != 0) && (dtotal != 0) && (didle <= dtotal))
+		l->busy = ((dtotal - didle)*1000)/dtotal;
+	place.total = total;
+	place.idle = idle;
+
+	if (st.running > 1)
+		l->runnable = (st.running - 1 > 0xffff) ? 0xffff : st.running - 1;
+}
+
+/**
+ * @brief Tells whether a tile has reported recently.
+ */
+static int place_alive(int tile, uint64_t now)
+{
+	if (tile == place.tile)
+		return (1);
+
+	return ((place.stamp[tile] != 0) && (now - place.stamp[tile] <= PLACE_STALE_MS));
+}
+
+/**
+ * @brief Returns the score of a tile (lower is better).
+ */
+static unsigned place_score(int tile)
+{
+	const struct place_load *l = &place.loads[tile];
+
+	return ((l->runnable + l->pending)*PLACE_TASK_WEIGHT + l->busy);
+}
+
+/**
+ * @brief Chooses a tile for a new task.
+ *
+ * @details The chosen tile is charged one pending task, which keeps a
+ * burst of requests arriving within one report period from piling up
+ * on the same tile. The charge is dropped when the tile reports again.
+ * Must be called with the lock held.
+ */
+static int place_choose(int policy)
+{
+	int n = 0;
+	int tile, a, b;
+	int live[NOC_MAX_TILES] = { 0 };
+	uint64_t now = place_now();
+
+	for (int t = 0; t < place.ntiles; t++)
+	{
+		if (place_alive(t, now))
+			live[n++] = t;
+	}
+
+	switch (policy)
+	{
+		/* Least loaded, ties broken from a random start. */
+		case PLACE_LEAST:
+			a = place_rand() % n;
+			tile = live[a];
+			for (int i = 1; i < n; i++)
+			{
+				int t = live[(a + i) % n];
+
+				if (place_score(t) < place_score(tile))
+					tile = t;
+			}
+			break;
+
+		/* Best of two random tiles. */
+		case PLACE_P2C:
+			if (n == 1)
+			{
+				tile = live[0];
+				break;
+			}
+			a = place_rand() % n;
+			b = place_rand() % (n - 1);
+			if (b >= a)
+				b++;
+			tile = (place_score(live[b]) < place_score(live[a])) ? live[b] : live[a];
+			break;
+
+		case PLACE_LOCAL:
+			tile = place.tile;
+			break;
+
+		default:
+			return (-1);
+	}
+
+	if (place.loads[tile].pending < 0xffff)
+		place.loads[tile].pending++;
+
+	return (tile);
+}
+
+/**
+ * @brief Samples this tile and reports it to every other tile.
+ */
+static void place_report(void)
+{
+	struct place_load l;
+
+	place_sample(&l);
+
+	pthread_mutex_lock(&place.lock);
+	place.loads[place.tile] = l;
+	place.stamp[place.tile] = place_now();
+	pthread_mutex_unlock(&place.lock);
+
+	for (int t = 0; t < place.ntiles; t++)
+	{
+		if (t != place.tile)
+			noc_send(t, NOC_PORT_PLACE, &l, sizeof(l));
+	}
+}
+
+/**
+ * @brief Takes in a load report from another tile.
+ */
+void place_update(int src, const void *buf, size_t len)
+{
+	struct place_load l;
+
+	if ((len != sizeof(l)) || (src >= NOC_MAX_TILES))
+		return;
+
+	memcpy(&l, buf, sizeof(l));
+	l.pending = 0;
+	l.age = 0;
+
+	pthread_mutex_lock(&place.lock);
+	place.loads[src] = l;
+	place.stamp[src] = place_now();
+	pthread_mutex_unlock(&place.lock);
+}
+
+/**
+ * @brief Serves a client request.
+ */
+static int place_handle(int fd)
+{
+	ssize_t n;
+	uint64_t now;
+	struct place_req req;
+	struct place_rep rep;
+
+	if ((n = recv(fd, &req, sizeof(req), 0)) <= 0)
+		return (-1);
+
+	memset(&rep, 0, sizeof(rep));
+	now = place_now();
+
+	pthread_mutex_lock(&place.lock);
+
+	rep.tile = -1;
+	if ((n == sizeof(req)) && (req.op == PLACE_OP_PICK))
+		rep.tile = place_choose(req.policy);
+
+	rep.ntiles = place.ntiles;
+	for (int t = 0; t < place.ntiles; t++)
+	{
+		rep.loads[t] = place.loads[t];
+		if (!place_alive(t, now))
+			rep.loads[t].age = 0xffff;
+		else
+			rep.loads[t].age = (now - place.stamp[t] < 0xffff) ? now - place.stamp[t] : 0xfffe;
+	}
+
+	pthread_mutex_unlock(&place.lock);
+
+	return ((send(fd, &rep, sizeof(rep), MSG_NOSIGNAL) < 0) ? -1 : 0);
+}
+
+/**
+ * @brief Runs the placement service.
+ *
+ * @details Every PLACE_PERIOD_MS, the load of this tile is sampled
+ * and sent to every other tile in a single-packet report, so each
+ * tile holds the whole load table and can answer its local clients
+ * without a round trip over the NoC. Tiles that stop reporting are
+ * left out of placement. Only returns on error.
+ */
+int place_serve(void)
+{
+	int fd;
+	uint64_t next;
+
+	place.tile = noc_tile();
+	place.ntiles = noc_ntiles();
+	place.seed = 0x9e3779b9u ^ (place.tile + 1)*0x85ebca6bu;
+
+	if ((fd = init_listen(PLACE_SOCKET, sizeof(PLACE_SOCKET) - 1, PLACE_MAX_CLIENTS)) < 0)
+		return (-1);
+
+	place.fds[0].fd = fd;
+	place.fds[0].events = POLLIN;
+
+	place_report();
+	next = place_now() + PLACE_PERIOD_MS;
+
+	while (1)
+	{
+		int timeout;
+		uint64_t now = place_now();
+
+		if (now >= next)
+		{
+			place_report();
+			next += PLACE_PERIOD_MS;
+			if (next <= now)
+				next = now + PLACE_PERIOD_MS;
+		}
+		timeout = next - now;
+
+		if (poll(place.fds, 1 + place.nclients, timeout) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return (-1);
+		}
+
+		/* Clients. */
+		for (int i = 1; i <= place.nclients; i++)
+		{
+			if (place.fds[i].revents == 0)
+				continue;
+
+			if ((place.fds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) ||
+				(place_handle(place.fds[i].fd) < 0))
+			{
+				close(place.fds[i].fd);
+				place.fds[i--] = place.fds[place.nclients--];
+			}
+		}
+
+		/* New client. */
+		if (place.fds[0].revents & POLLIN)
+		{
+			int client;
+
+			if ((client = accept4(fd, NULL, NULL, SOCK_CLOEXEC)) >= 0)
+			{
+				if (place.nclients == PLACE_MAX_CLIENTS)
+					close(client);
+				else
+				{
+					place.nclients++;
+					place.fds[place.nclients].fd = client;
+					place.fds[place.nclients].events = POLLIN;
+					place.fds[place.nclients].revents = 0;
+				}
+			}
+		}
+	}
+}
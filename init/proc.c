@@ -0,0 +1,106 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "init.h"
+
+/**
+ * @brief Size of the read buffer.
+ */
+#define PROC_BUF_SIZE 4096
+
+/**
+ * @brief Reads a file from /proc into a string.
+ */
+static int proc_read(const char *pathname, char *buf, size_t size)
+{
+	int fd;
+	ssize_t n;
+
+	if ((fd = open(pathname, O_RDONLY | O_CLOEXEC)) < 0)
+		return (-1);
+	n = read(fd, buf, size - 1);
+	close(fd);
+	if (n <= 0)
+		return (-1);
+	buf[n] = '\0';
+
+	return (0);
+}
+
+/**
+ * @brief Reads a field of a /proc file.
+ */
+static void proc_field(const char *buf, const char *fmt, const char *name, void *val)
+{
+	const char *p;
+
+	if ((p = strstr(buf, name)) != NULL)
+		sscanf(p, fmt, val);
+}
+
+/**
+ * @brief Reads the system statistics.
+ *
+ * @details Fields missing in older kernels read as zero.
+ *
+ * @returns Zero upon success and -1 otherwise.
+ */
+int proc_read_stat(struct proc_stat *st)
+{
+	char buf[PROC_BUF_SIZE];
+
+	memset(st, 0, sizeof(struct proc_stat));
+
+	if (proc_read("/proc/stat", buf, sizeof(buf)) < 0)
+		return (-1);
+
+	if (sscanf(buf, "cpu %llu %llu %llu %llu %llu %llu %llu %llu",
+		&st->user, &st->nice, &st->system, &st->idle,
+		&st->iowait, &st->irq, &st->softirq, &st->steal) < 4)
+		return (-1);
+
+	proc_field(buf, "procs_running %ld", "procs_running ", &st->running);
+	proc_field(buf, "procs_blocked %ld", "procs_blocked ", &st->blocked);
+
+	return (0);
+}
+
+/**
+ * @brief Reads the memory statistics.
+ *
+ * @returns Zero upon success and -1 otherwise.
+ */
+int proc_read_meminfo(struct proc_meminfo *mi)
+{
+	char buf[PROC_BUF_SIZE];
+
+	memset(mi, 0, sizeof(struct proc_meminfo));
+
+	if (proc_read("/proc/meminfo", buf, sizeof(buf)) < 0)
+		return (-1);
+
+	proc_field(buf, "MemTotal: %lu", "MemTotal:", &mi->total);
+	proc_field(buf, "MemFree: %lu", "MemFree:", &mi->free);
+	proc_field(buf, "\nCached: %lu", "\nCached:", &mi->cached);
+
+	return (0);
+}
@@ -0,0 +1,771 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <noc.h>
+
+#include "init.h"
+
+#ifdef PGO_GENERATE
+extern void __gcov_flush(void);
+#endif
+
+/**
+ * @brief Default service manifest.
+ */
+#define SERVICE_MANIFEST "/etc/init.conf"
+
+/**
+ * @brief Maximum number of services.
+ */
+#define SERVICE_MAX 32
+
+/**
+ * @brief Maximum number of arguments of a service.
+ */
+#define SERVICE_ARGS_MAX 16
+
+/**
+ * @brief Maximum number of dependencies of a service.
+ */
+#define SERVICE_DEPS_MAX 8
+
+/**
+ * @brief Maximum length of a manifest line.
+ */
+#define SERVICE_LINE_MAX 256
+
+/**
+ * @name Restart backoff (in ms).
+ *
+ * @details The delay doubles on every crash, and starts over once a
+ * service stays up for SERVICE_STABLE_MS.
+ */
+/**@{*/
+#define SERVICE_BACKOFF_MIN 100
+#define SERVICE_BACKOFF_MAX 10000
+#define SERVICE_STABLE_MS   10000
+/**@}*/
+
+/**
+ * @name Service types.
+ */
+/**@{*/
+#define SERVICE_SIMPLE  0 /**< Runs until the tile stops.      */
+#define SERVICE_ONESHOT 1 /**< Runs to completion, once.       */
+/**@}*/
+
+/**
+ * @name Restart policies.
+ */
+/**@{*/
+#define SERVICE_RESTART_NO      0 /**< Never.                   */
+#define SERVICE_RESTART_FAILURE 1 /**< When it fails.           */
+#define SERVICE_RESTART_ALWAYS  2 /**< Whenever it exits.       */
+/**@}*/
+
+/**
+ * @name Service states.
+ */
+/**@{*/
+#define SERVICE_WAITING 0 /**< Waiting for dependencies.     */
+#define SERVICE_RUNNING 1 /**< Running.                      */
+#define SERVICE_BACKOFF 2 /**< Waiting to be restarted.      */
+#define SERVICE_DONE    3 /**< Completed (oneshot) or ended. */
+#define SERVICE_FAILED  4 /**< Gave up on it.                */
+/**@}*/
+
+/**
+ * @brief Service.
+ */
+struct service
+{
+	char *name;                      /**< Name.                       */
+	char *argv[SERVICE_ARGS_MAX + 1]; /**< Command line.              */
+	int deps[SERVICE_DEPS_MAX];      /**< Dependencies.               */
+	int ndeps;                       /**< Number of dependencies.     */
+	int type;                        /**< Type.                       */
+	int restart;                     /**< Restart policy.             */
+	int state;                       /**< State.                      */
+	int started;                     /**< Started at least once?      */
+	pid_t pid;                       /**< Process ID (if running).    */
+	unsigned restarts;               /**< Times restarted.            */
+	unsigned backoff;                /**< Next restart delay (ms).    */
+	uint64_t since;                  /**< Start or exit time (ms).    */
+	int policy;                      /**< Scheduling policy, or -1.   */
+	int prio;                        /**< Real-time priority.         */
+	int ncpus;                       /**< CPUs in cpus (0: any).      */
+	cpu_set_t cpus;                  /**< CPU affinity.               */
+	int mlock;                       /**< Lock all memory?            */
+	int stack;                       /**< Stack to prefault (KB).     */
+	int noc;                         /**< Receives from the NoC?      */
+	char **envp;                     /**< Environment.                */
+};
+
+/**
+ * @brief Service supervisor.
+ */
+static struct
+{
+	int n;                            /**< Number of services.        */
+	int up;                           /**< All services started?      */
+	struct service svc[SERVICE_MAX];  /**< Services.                  */
+	char lines[SERVICE_MAX][SERVICE_LINE_MAX]; /**< Manifest lines.   */
+} services;
+
+/**
+ * @brief Returns the current time in milliseconds.
+ */
+static uint64_t service_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((uint64_t) ts.tv_sec*1000 + ts.tv_nsec/1000000);
+}
+
+/**
+ * @brief Looks a service up by name.
+ */
+static int service_find(const char *name)
+{
+	for (int i = 0; i < services.n; i++)
+	{
+		if (strcmp(services.svc[i].name, name) == 0)
+			return (i);
+	}
+
+	return (-1);
+}
+
+/**
+ * @brief Tells whether a manifest tile list selects this tile.
+ */
+static int service_tile(const char *list)
+{
+	char *end;
+
+	if (strcmp(list, "all") == 0)
+		return (1);
+
+	while (*list != '\0')
+	{
+		long lo = strtol(list, &end, 0), hi = lo;
+
+		if (end == list)
+			return (0);
+		if (*end == '-')
+			hi = strtol(end + 1, &end, 0);
+		if ((noc_tile() >= lo) && (noc_tile() <= hi))
+			return (1);
+		list = (*end == ',') ? end + 1 : end;
+		if ((*end != ',') && (*end != '\0'))
+			return (0);
+	}
+
+	return (0);
+}
+
+/**
+ * @brief Parses a scheduling profile ("fifo:prio", "rr:prio" or
+ * "other").
+ */
+static int service_sched(const char *str, struct service *svc)
+{
+	char *end;
+
+	if (strcmp(str, "other") == 0)
+	{
+		svc->policy = SCHED_OTHER;
+		svc->prio = 0;
+		return (0);
+	}
+
+	if (strncmp(str, "fifo:", 5) == 0)
+		svc->policy = SCHED_FIFO;
+	else if (strncmp(str, "rr:", 3) == 0)
+		svc->policy = SCHED_RR;
+	else
+		return (-1);
+
+	svc->prio = strtol(strchr(str, ':') + 1, &end, 0);
+	if ((*end != '\0') ||
+		(svc->prio < sched_get_priority_min(svc->policy)) ||
+		(svc->prio > sched_get_priority_max(svc->policy)))
+		return (-1);
+
+	return (0);
+}
+
+/**
+ * @brief Parses a CPU list ("n|n-m,...").
+ */
+static int service_cpus(const char *list, struct service *svc)
+{
+	char *end;
+
+	CPU_ZERO(&svc->cpus);
+
+	while (*list != '\0')
+	{
+		long lo = strtol(list, &end, 0), hi = lo;
+
+		if (end == list)
+			return (-1);
+		if (*end == '-')
+			hi = strtol(end + 1, &end, 0);
+		if ((lo < 0) || (hi < lo) || (hi >= CPU_SETSIZE) || ((*end != ',') && (*end != '\0')))
+			return (-1);
+		for (long cpu = lo; cpu <= hi; cpu++)
+			CPU_SET(cpu, &svc->cpus);
+		list = (*end == ',') ? end + 1 : end;
+	}
+
+	svc->ncpus = CPU_COUNT(&svc->cpus);
+
+	return ((svc->ncpus > 0) ? 0 : -1);
+}
+
+/**
+ * @brief Parses a manifest line.
+ *
+ * @details A line is a service name, options and a command line, all
+ * separated by blanks:
+ *
+ *   name [type=simple|oneshot] [after=dep,...] [restart=no|on-failure|always]
+ *        [tiles=all|n|n-m,...] command [args...]
+ *
+ * and, to keep a latency-critical service off the page fault and
+ * scheduling paths, any of the profile options:
+ *
+ *   sched=fifo:prio|rr:prio|other  cpus=n|n-m,...  mlock=yes|no  stack=kb
+ *
+ * A service that receives from the NoC itself is marked noc=yes, so
+ * that init leaves the adapter of the tile to it (see service_noc()).
+ * Dependencies must come earlier in the manifest. A simple service
+ * satisfies its dependents once started, and a oneshot service once
+ * completed successfully.
+ *
+ * @returns Zero upon success, one if the line is empty or for another
+ * tile, and -1 on syntax errors.
+ */
+static int service_parse(char *line, struct service *svc, char **after)
+{
+	int argc = 0;
+	char *tok, *save;
+
+	memset(svc, 0, sizeof(struct service));
+	svc->restart = -1;
+	svc->policy = -1;
+	*after = NULL;
+
+	line[strcspn(line, "#\n")] = '\0';
+	if ((svc->name = strtok_r(line, " \t", &save)) == NULL)
+		return (1);
+
+	while ((tok = strtok_r(NULL, " \t", &save)) != NULL)
+	{
+		if ((argc == 0) && (strncmp(tok, "type=", 5) == 0))
+		{
+			if (strcmp(tok + 5, "simple") == 0)
+				svc->type = SERVICE_SIMPLE;
+			else if (strcmp(tok + 5, "oneshot") == 0)
+				svc->type = SERVICE_ONESHOT;
+			else
+				return (-1);
+		}
+		else if ((argc == 0) && (strncmp(tok, "restart=", 8) == 0))
+		{
+			if (strcmp(tok + 8, "no") == 0)
+				svc->restart = SERVICE_RESTART_NO;
+			else if (strcmp(tok + 8, "on-failure") == 0)
+				svc->restart = SERVICE_RESTART_FAILURE;
+			else if (strcmp(tok + 8, "always") == 0)
+				svc->restart = SERVICE_RESTART_ALWAYS;
+			else
+				return (-1);
+		}
+		else if ((argc == 0) && (strncmp(tok, "after=", 6) == 0))
+			*after = tok + 6;
+		else if ((argc == 0) && (strncmp(tok, "tiles=", 6) == 0))
+		{
+			if (!service_tile(tok + 6))
+				return (1);
+		}
+		else if ((argc == 0) && (strncmp(tok, "sched=", 6) == 0))
+		{
+			if (service_sched(tok + 6, svc) < 0)
+				return (-1);
+		}
+		else if ((argc == 0) && (strncmp(tok, "cpus=", 5) == 0))
+		{
+			if (service_cpus(tok + 5, svc) < 0)
+				return (-1);
+		}
+		else if ((argc == 0) && (strncmp(tok, "mlock=", 6) == 0))
+		{
+			if ((strcmp(tok + 6, "yes") != 0) && (strcmp(tok + 6, "no") != 0))
+				return (-1);
+			svc->mlock = (strcmp(tok + 6, "yes") == 0);
+		}
+		else if ((argc == 0) && (strncmp(tok, "noc=", 4) == 0))
+		{
+			if ((strcmp(tok + 4, "yes") != 0) && (strcmp(tok + 4, "no") != 0))
+				return (-1);
+			svc->noc = (strcmp(tok + 4, "yes") == 0);
+		}
+		else if ((argc == 0) && (strncmp(tok, "stack=", 6) == 0))
+		{
+			char *end;
+
+			if (((svc->stack = strtol(tok + 6, &end, 0)) <= 0) || (*end != '\0'))
+				return (-1);
+		}
+		else if (argc < SERVICE_ARGS_MAX)
+			svc->argv[argc++] = tok;
+		else
+			return (-1);
+	}
+
+	if (argc == 0)
+		return (-1);
+
+	/* Simple services come back after a crash, by default. */
+	if (svc->restart < 0)
+		svc->restart = (svc->type == SERVICE_SIMPLE) ? SERVICE_RESTART_FAILURE : SERVICE_RESTART_NO;
+
+	return (0);
+}
+
+/**
+ * @brief Resolves the dependencies of a service.
+ */
+static int service_deps(struct service *svc, char *after)
+{
+	char *dep, *save;
+
+	if (after == NULL)
+		return (0);
+
+	for (dep = strtok_r(after, ",", &save); dep != NULL; dep = strtok_r(NULL, ",", &save))
+	{
+		int i = service_find(dep);
+
+		/* Services of other tiles are not dependencies here. */
+		if (i < 0)
+		{
+			fprintf(stderr, "init: %s: no service %s on this tile, ignored\n", svc->name, dep);
+			continue;
+		}
+		if (svc->ndeps == SERVICE_DEPS_MAX)
+			return (-1);
+		svc->deps[svc->ndeps++] = i;
+	}
+
+	return (0);
+}
+
+/**
+ * @brief Builds the environment of a service.
+ *
+ * @details Memory locks do not survive exec(), so the memory profile
+ * is passed down to libnoc, which applies it in noc_init(). Built
+ * ahead of time: the child of a threaded process must not allocate.
+ */
+static int service_env(struct service *svc)
+{
+	int n = 0;
+	char buf[32];
+
+	if (!svc->mlock && (svc->stack == 0))
+	{
+		svc->envp = environ;
+		return (0);
+	}
+
+	while (environ[n] != NULL)
+		n++;
+	if ((svc->envp = calloc(n + 3, sizeof(char *))) == NULL)
+		return (-1);
+	memcpy(svc->envp, environ, n*sizeof(char *));
+
+	if (svc->mlock)
+		svc->envp[n++] = "NOC_MLOCK=1";
+	if (svc->stack > 0)
+	{
+		snprintf(buf, sizeof(buf), "NOC_PREFAULT=%d", svc->stack);
+		if ((svc->envp[n++] = strdup(buf)) == NULL)
+			return (-1);
+	}
+
+	return (0);
+}
+
+/**
+ * @brief Reads the service manifest.
+ *
+ * @returns The number of services upon success and -1 otherwise.
+ */
+static int service_load(const char *pathname)
+{
+	FILE *fp;
+	int lineno = 0;
+
+	if ((fp = fopen(pathname, "re")) == NULL)
+		return ((errno == ENOENT) ? 0 : -1);
+
+	while ((services.n < SERVICE_MAX) &&
+		(fgets(services.lines[services.n], SERVICE_LINE_MAX, fp) != NULL))
+	{
+		int ret;
+		char *after;
+		struct service *svc = &services.svc[services.n];
+
+		lineno++;
+		if ((ret = service_parse(services.lines[services.n], svc, &after)) > 0)
+			continue;
+
+		if ((ret < 0) || (service_find(svc->name) >= 0) || (service_deps(svc, after) < 0) ||
+			(service_env(svc) < 0))
+		{
+			fprintf(stderr, "init: %s:%d: bad service, ignored\n", pathname, lineno);
+			continue;
+		}
+
+		services.n++;
+	}
+
+	fclose(fp);
+
+	return (services.n);
+}
+
+/**
+ * @brief Starts a service.
+ */
+static void service_spawn(struct service *svc, uint64_t now)
+{
+	pid_t pid;
+	sigset_t none;
+
+#ifdef PGO_GENERATE
+	/*
+	 * init never exits, so an instrumented build writes its profile out
+	 * whenever a service starts, for gcdadump to find it.
+	 */
+	__gcov_flush();
+#endif
+
+	if ((pid = fork()) < 0)
+	{
+		fprintf(stderr, "init: %s: %s\n", svc->name, strerror(errno));
+		if (svc->backoff == 0)
+			svc->backoff = SERVICE_BACKOFF_MIN;
+		svc->state = SERVICE_BACKOFF;
+		svc->since = now;
+		return;
+	}
+
+	/* Only async-signal-safe calls until exec: init is threaded. */
+	if (pid == 0)
+	{
+		sigemptyset(&none);
+		sigprocmask(SIG_SETMASK, &none, NULL);
+		setsid();
+
+		/*
+		 * A profile that cannot be applied is a failure. musl stubs
+		 * sched_setscheduler() out (ENOSYS), so the system call is
+		 * made directly.
+		 */
+		if (svc->policy >= 0)
+		{
+			struct sched_param param = { .sched_priority = svc->prio };
+
+			if (syscall(SYS_sched_setscheduler, 0, svc->policy, &param) < 0)
+				_exit(126);
+		}
+		if ((svc->ncpus > 0) && (sched_setaffinity(0, sizeof(cpu_set_t), &svc->cpus) < 0))
+			_exit(126);
+
+		execve(svc->argv[0], svc->argv, svc->envp);
+		_exit(127);
+	}
+
+	svc->pid = pid;
+	svc->state = SERVICE_RUNNING;
+	svc->since = now;
+	if (!svc->started)
+	{
+		char mark[32];
+
+		svc->started = 1;
+		snprintf(mark, sizeof(mark), "svc:%s", svc->name);
+		boot_mark(mark);
+	}
+}
+
+/**
+ * @brief Tells whether the dependencies of a service are satisfied.
+ *
+ * @returns One if they are, zero if not yet, and -1 if they never will.
+ */
+static int service_ready(const struct service *svc)
+{
+	int ready = 1;
+
+	for (int i = 0; i < svc->ndeps; i++)
+	{
+		const struct service *dep = &services.svc[svc->deps[i]];
+
+		if (dep->state == SERVICE_FAILED)
+			return (-1);
+		if ((dep->type == SERVICE_ONESHOT) ? (dep->state != SERVICE_DONE) : !dep->started)
+			ready = 0;
+	}
+
+	return (ready);
+}
+
+/**
+ * @brief Starts whatever can be started.
+ *
+ * @returns How long until a service is due for a restart (in ms), or -1
+ * if none is.
+ */
+static long service_step(void)
+{
+	int progress;
+	long wait = -1;
+	uint64_t now = service_now();
+
+	/* Starting a service may unblock others. */
+	do
+	{
+		progress = 0;
+
+		for (int i = 0; i < services.n; i++)
+		{
+			struct service *svc = &services.svc[i];
+
+			if (svc->state == SERVICE_WAITING)
+			{
+				int ready = service_ready(svc);
+
+				if (ready < 0)
+				{
+					fprintf(stderr, "init: %s: dependency failed\n", svc->name);
+					svc->state = SERVICE_FAILED;
+					progress = 1;
+				}
+				else if (ready > 0)
+				{
+					service_spawn(svc, now);
+					progress = 1;
+				}
+			}
+			else if (svc->state == SERVICE_BACKOFF)
+			{
+				if (now >= svc->since + svc->backoff)
+				{
+					svc->restarts++;
+					service_spawn(svc, now);
+				}
+				else if ((wait < 0) || ((long) (svc->since + svc->backoff - now) < wait))
+					wait = svc->since + svc->backoff - now;
+			}
+		}
+	} while (progress);
+
+	if (!services.up)
+	{
+		int up = 1;
+
+		for (int i = 0; i < services.n; i++)
+		{
+			if (services.svc[i].state == SERVICE_WAITING)
+				up = 0;
+		}
+		if (up)
+		{
+			services.up = 1;
+			boot_mark("services");
+		}
+	}
+
+	return (wait);
+}
+
+/**
+ * @brief Handles the exit of a child.
+ *
+ * @details Orphans reparented to init are reaped as well, and ignored.
+ */
+static void service_exit(pid_t pid, int status)
+{
+	int failed;
+	uint64_t now = service_now();
+	struct service *svc = NULL;
+
+	for (int i = 0; i < services.n; i++)
+	{
+		if ((services.svc[i].state == SERVICE_RUNNING) && (services.svc[i].pid == pid))
+			svc = &services.svc[i];
+	}
+	if (svc == NULL)
+		return;
+
+	failed = !WIFEXITED(status) || (WEXITSTATUS(status) != 0);
+	svc->pid = 0;
+
+	if ((svc->restart == SERVICE_RESTART_ALWAYS) ||
+		((svc->restart == SERVICE_RESTART_FAILURE) && failed))
+	{
+		/* Back off from crash loops. */
+		if (now - svc->since >= SERVICE_STABLE_MS)
+			svc->backoff = SERVICE_BACKOFF_MIN;
+		else
+			svc->backoff = (svc->backoff == 0) ? SERVICE_BACKOFF_MIN :
+				(svc->backoff*2 > SERVICE_BACKOFF_MAX) ? SERVICE_BACKOFF_MAX : svc->backoff*2;
+
+		fprintf(stderr, "init: %s: %s %d, restart in %u ms\n", svc->name,
+			WIFSIGNALED(status) ? "killed by signal" : "exited with",
+			WIFSIGNALED(status) ? WTERMSIG(status) : WEXITSTATUS(status), svc->backoff);
+		svc->state = SERVICE_BACKOFF;
+		svc->since = now;
+		return;
+	}
+
+	if (failed)
+	{
+		fprintf(stderr, "init: %s: %s %d, giving up\n", svc->name,
+			WIFSIGNALED(status) ? "killed by signal" : "exited with",
+			WIFSIGNALED(status) ? WTERMSIG(status) : WEXITSTATUS(status));
+	}
+	svc->state = failed ? SERVICE_FAILED : SERVICE_DONE;
+}
+
+/**
+ * @brief Supervises services.
+ */
+static void *service_loop(void *arg)
+{
+	int status;
+	long wait;
+	pid_t pid;
+	sigset_t set;
+	struct timespec ts;
+
+	((void) arg);
+
+	sigemptyset(&set);
+	sigaddset(&set, SIGCHLD);
+
+	while (1)
+	{
+		wait = service_step();
+
+		/* SIGCHLD is blocked, so none is missed in between. */
+		if (wait < 0)
+			sigwaitinfo(&set, NULL);
+		else
+		{
+			ts.tv_sec = wait/1000;
+			ts.tv_nsec = (wait%1000)*1000000;
+			sigtimedwait(&set, NULL, &ts);
+		}
+
+		while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+			service_exit(pid, status);
+	}
+
+	return (NULL);
+}
+
+/**
+ * @brief Reads the services of the tile.
+ *
+ * @details Reads the manifest (SERVICE_MANIFEST, or the INIT_MANIFEST
+ * environment variable). Nothing is started yet.
+ *
+ * @returns Zero upon success and -1 otherwise.
+ */
+int service_init(void)
+{
+	const char *manifest = getenv("INIT_MANIFEST");
+
+	if (service_load((manifest != NULL) ? manifest : SERVICE_MANIFEST) < 0)
+		return (-1);
+
+	return (0);
+}
+
+/**
+ * @brief Tells whether a service of the tile receives from the NoC.
+ *
+ * @details Every process that reads the adapter takes packets off the
+ * same queue, so a message addressed to a service could be taken by
+ * init, and packet trains read by two processes come apart. On tiles
+ * with such a service, init does not receive from the NoC at all.
+ */
+int service_noc(void)
+{
+	for (int i = 0; i < services.n; i++)
+	{
+		if (services.svc[i].noc)
+			return (1);
+	}
+
+	return (0);
+}
+
+/**
+ * @brief Starts the services of the tile.
+ *
+ * @details Starts a thread that runs the services read by
+ * service_init(), independent ones in parallel, each as soon as its
+ * dependencies are satisfied, reaps every child of init and restarts
+ * crashed services. SIGCHLD must be blocked in all threads of init
+ * before any is created.
+ *
+ * @returns Zero upon success and -1 otherwise.
+ */
+int service_start(void)
+{
+	pthread_t tid;
+
+	if ((errno = pthread_create(&tid, NULL, service_loop, NULL)) != 0)
+		return (-1);
+	pthread_detach(tid);
+
+	return (0);
+}
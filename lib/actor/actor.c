@@ -0,0 +1,560 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <actor.h>
+#include <noc.h>
+
+/**
+ * @name Message kinds.
+ */
+/**@{*/
+#define ACTOR_KIND_MSG      0 /**< Message to an actor.        */
+#define ACTOR_KIND_SPAWN    1 /**< Create an actor.            */
+#define ACTOR_KIND_SHUTDOWN 2 /**< Stop the scheduler.         */
+/**@}*/
+
+/**
+ * @brief Number of buckets in the actor table.
+ */
+#define ACTOR_BUCKETS 256
+
+/**
+ * @brief Local messages handled between two NoC polls.
+ *
+ * @details Bounds how long remote traffic waits behind local traffic
+ * without paying a poll() for every local message.
+ */
+#define ACTOR_POLL_EVERY 32
+
+/**
+ * @brief Message header.
+ */
+struct actor_msghdr
+{
+	uint32_t to;   /**< Target actor.       */
+	uint32_t from; /**< Sending actor.      */
+	uint16_t kind; /**< Message kind.       */
+	uint16_t type; /**< Behaviour (spawn).  */
+};
+
+/**
+ * @brief Message in a mailbox.
+ */
+struct amsg
+{
+	struct amsg *next; /**< Next message.   */
+	actor_t from;      /**< Sender.         */
+	size_t len;        /**< Message length. */
+	uint8_t data[];    /**< Message data.   */
+};
+
+/**
+ * @brief Actor.
+ */
+struct actor
+{
+	actor_t id;          /**< Address.                    */
+	actor_fn fn;         /**< Behaviour.                  */
+	int queued;          /**< In the run queue?           */
+	int dead;            /**< Exited?                     */
+	struct amsg *head;   /**< Mailbox head.               */
+	struct amsg *tail;   /**< Mailbox tail.               */
+	struct actor *hnext; /**< Next actor in bucket.       */
+	struct actor *rnext; /**< Next actor in run queue.    */
+	long long state[];   /**< Private state.              */
+};
+
+/**
+ * @brief Behaviour table entry.
+ */
+struct actor_type
+{
+	actor_fn fn;      /**< Behaviour.           */
+	size_t statesize; /**< Private state size.  */
+};
+
+/**
+ * @brief Actor runtime state.
+ */
+static struct
+{
+	int stop;                               /**< Stop the scheduler?  */
+	uint32_t seq;                           /**< Next sequence number. */
+	struct actor_type types[ACTOR_MAX_TYPES]; /**< Behaviours.        */
+	struct actor *table[ACTOR_BUCKETS];     /**< Local actors.        */
+	struct actor *runhead;                  /**< Run queue head.      */
+	struct actor *runtail;                  /**< Run queue tail.      */
+	struct actor_stats stats;               /**< Statistics.          */
+} actor;
+
+/**
+ * @brief Message buffer.
+ */
+static uint8_t msgbuf[sizeof(struct actor_msghdr) + ACTOR_MSG_MAX];
+
+/**
+ * @brief Hashes an actor address.
+ */
+static inline unsigned actor_hash(actor_t id)
+{
+	return ((id ^ (id >> 8) ^ (id >> 22)) % ACTOR_BUCKETS);
+}
+
+/**
+ * @brief Looks up a local actor.
+ */
+static struct actor *actor_lookup(actor_t id)
+{
+	struct actor *a;
+
+	for (a = actor.table[actor_hash(id)]; a != NULL; a = a->hnext)
+	{
+		if (a->id == id)
+			return (a);
+	}
+
+	return (NULL);
+}
+
+/**
+ * @brief Appends a message to the mailbox of an actor.
+ */
+static int actor_enqueue(struct actor *a, actor_t from, const void *msg, size_t len)
+{
+	struct amsg *m;
+
+	if ((m = noc_buf_alloc(sizeof(struct amsg) + len)) == NULL)
+		return (-1);
+	m->next = NULL;
+	m->from = from;
+	m->len = len;
+	if (len > 0)
+		memcpy(m->data, msg, len);
+
+	if (a->head == NULL)
+		a->head = m;
+	else
+		a->tail->next = m;
+	a->tail = m;
+
+	if (!a->queued)
+	{
+		a->queued = 1;
+		a->rnext = NULL;
+		if (actor.runhead == NULL)
+			actor.runhead = a;
+		else
+			actor.runtail->rnext = a;
+		actor.runtail = a;
+	}
+
+	return (0);
+}
+
+/**
+ * @brief Creates a local actor.
+ */
+static int actor_create(actor_t id, int type, const void *arg, size_t len)
+{
+	struct actor *a;
+	unsigned h;
+
+	if ((type < 0) || (type >= ACTOR_MAX_TYPES) || (actor.types[type].fn == NULL))
+	{
+		errno = EINVAL;
+		return (-1);
+	}
+
+	if ((a = calloc(1, sizeof(struct actor) + actor.types[type].statesize)) == NULL)
+		return (-1);
+	a->id = id;
+	a->fn = actor.types[type].fn;
+
+	h = actor_hash(id);
+	a->hnext = actor.table[h];
+	actor.table[h] = a;
+
+	return (actor_enqueue(a, ACTOR_NONE, arg, len));
+}
+
+/**
+ * @brief Destroys a local actor.
+ */
+static void actor_destroy(struct actor *a)
+{
+	struct actor **pa;
+	struct amsg *m;
+
+	for (pa = &actor.table[actor_hash(a->id)]; *pa != NULL; pa = &(*pa)->hnext)
+	{
+		if (*pa == a)
+		{
+			*pa = a->hnext;
+			break;
+		}
+	}
+
+	while ((m = a->head) != NULL)
+	{
+		a->head = m->next;
+		noc_buf_free(m);
+	}
+
+	free(a);
+}
+
+/**
+ * @brief Sends a runtime message to another tile.
+ */
+static int actor_xmit(int tile, actor_t to, actor_t from, int kind, int type, const void *msg, size_t len)
+{
+	struct actor_msghdr hdr = { to, from, kind, type };
+
+	memcpy(msgbuf, &hdr, sizeof(struct actor_msghdr));
+	if (len > 0)
+		memcpy(msgbuf + sizeof(struct actor_msghdr), msg, len);
+
+	if (noc_send(tile, NOC_PORT_ACTOR, msgbuf, sizeof(struct actor_msghdr) + len) < 0)
+		return (-1);
+
+	return (0);
+}
+
+/**
+ * @brief Receives and handles one message from the NoC.
+ */
+static int actor_recv(void)
+{
+	int port;
+	ssize_t len;
+	struct actor *a;
+	struct actor_msghdr hdr;
+
+	if ((len = noc_recv(NULL, &port, msgbuf, sizeof(msgbuf))) < 0)
+		return (-1);
+
+	if ((port != NOC_PORT_ACTOR) || (len < (ssize_t) sizeof(struct actor_msghdr)))
+		return (0);
+
+	/* Truncated. */
+	if (len > (ssize_t) sizeof(msgbuf))
+	{
+		actor.stats.dropped++;
+		return (0);
+	}
+
+	memcpy(&hdr, msgbuf, sizeof(struct actor_msghdr));
+	len -= sizeof(struct actor_msghdr);
+
+	switch (hdr.kind)
+	{
+		case ACTOR_KIND_MSG:
+			actor.stats.remote_recv++;
+			if ((a = actor_lookup(hdr.to)) == NULL)
+			{
+				actor.stats.dropped++;
+				return (0);
+			}
+			return (actor_enqueue(a, hdr.from, msgbuf + sizeof(struct actor_msghdr), len));
+
+		/* A failed remote spawn cannot be reported: the actor is missing. */
+		case ACTOR_KIND_SPAWN:
+			if (actor_create(hdr.to, hdr.type, msgbuf + sizeof(struct actor_msghdr), len) < 0)
+				actor.stats.dropped++;
+			return (0);
+
+		case ACTOR_KIND_SHUTDOWN:
+			actor.stop = 1;
+			return (0);
+	}
+
+	return (0);
+}
+
+/**
+ * @brief Initializes the actor runtime.
+ *
+ * @details Must be called after noc_init(), and before the behaviours
+ * are registered.
+ *
+ * @returns Zero upon success and -1 otherwise.
+ */
+int actor_init(void)
+{
+	if ((noc_tile() < 0) || (noc_tile() >= NOC_MAX_TILES))
+	{
+		errno = ENODEV;
+		return (-1);
+	}
+
+	memset(&actor, 0, sizeof(actor));
+
+	return (0);
+}
+
+/**
+ * @brief Registers a behaviour.
+ *
+ * @details Every tile must register the same behaviours under the same
+ * numbers, so that actors can be spawned remotely.
+ *
+ * @param type      Behaviour number.
+ * @param fn        Behaviour.
+ * @param statesize Size of the private state of each actor (in bytes).
+ *
+ * @returns Zero upon success and -1 otherwise.
+ */
+int actor_register(int type, actor_fn fn, size_t statesize)
+{
+	if ((type < 0) || (type >= ACTOR_MAX_TYPES) || (fn == NULL))
+	{
+		errno = EINVAL;
+		return (-1);
+	}
+
+	actor.types[type].fn = fn;
+	actor.types[type].statesize = statesize;
+
+	return (0);
+}
+
+/**
+ * @brief Spawns an actor.
+ *
+ * @details The address is chosen locally and returned at once; on
+ * another tile the actor comes to life when the spawn request arrives.
+ * Since the NoC keeps messages between two tiles in order, messages
+ * sent by this tile after the spawn always find the actor.
+ *
+ * @param tile Target tile.
+ * @param type Behaviour number.
+ * @param arg  Spawn argument (first message of the actor).
+ * @param len  Length of the spawn argument.
+ *
+ * @returns The address of the new actor upon success, and ACTOR_NONE
+ * otherwise.
+ */
+actor_t actor_spawn(int tile, int type, const void *arg, size_t len)
+{
+	actor_t id;
+
+	if ((tile < 0) || (tile >= noc_ntiles()) || (len > ACTOR_MSG_MAX))
+	{
+		errno = EINVAL;
+		return (ACTOR_NONE);
+	}
+
+	/* Skip the sequence number that would alias ACTOR_NONE. */
+	if ((actor.seq & 0x3fffff) == 0x3fffff)
+		actor.seq++;
+	id = (actor_t) tile << 27 | (actor_t) noc_tile() << 22 | (actor.seq++ & 0x3fffff);
+
+	if (tile == noc_tile())
+	{
+		if (actor_create(id, type, arg, len) < 0)
+			return (ACTOR_NONE);
+		return (id);
+	}
+
+	if ((type < 0) || (type >= ACTOR_MAX_TYPES) || (actor.types[type].fn == NULL))
+	{
+		errno = EINVAL;
+		return (ACTOR_NONE);
+	}
+
+	if (actor_xmit(tile, id, ACTOR_NONE, ACTOR_KIND_SPAWN, type, arg, len) < 0)
+		return (ACTOR_NONE);
+
+	return (id);
+}
+
+/**
+ * @brief Sends a message to an actor.
+ *
+ * @details Messages between actors of the same tile go straight to the
+ * mailbox of the target and never touch the NoC.
+ *
+ * @param from Sending actor.
+ * @param to   Target actor.
+ * @param msg  Message.
+ * @param len  Message length.
+ *
+ * @returns Zero upon success and -1 otherwise.
+ */
+int actor_send(actor_t from, actor_t to, const void *msg, size_t len)
+{
+	struct actor *a;
+
+	if ((to == ACTOR_NONE) || (ACTOR_TILE(to) >= noc_ntiles()) || (len > ACTOR_MSG_MAX))
+	{
+		errno = (len > ACTOR_MSG_MAX) ? EMSGSIZE : EINVAL;
+		return (-1);
+	}
+
+	if (ACTOR_TILE(to) != noc_tile())
+	{
+		if (actor_xmit(ACTOR_TILE(to), to, from, ACTOR_KIND_MSG, 0, msg, len) < 0)
+			return (-1);
+		actor.stats.remote_sent++;
+		return (0);
+	}
+
+	if ((a = actor_lookup(to)) == NULL)
+	{
+		actor.stats.dropped++;
+		errno = ESRCH;
+		return (-1);
+	}
+
+	actor.stats.local_sent++;
+
+	return (actor_enqueue(a, from, msg, len));
+}
+
+/**
+ * @brief Returns the address of an actor.
+ */
+actor_t actor_self(const struct actor *a)
+{
+	return (a->id);
+}
+
+/**
+ * @brief Returns the private state of an actor.
+ *
+ * @details The state is zeroed when the actor is spawned.
+ */
+void *actor_state(struct actor *a)
+{
+	return (a->state);
+}
+
+/**
+ * @brief Terminates an actor.
+ *
+ * @details Called from the behaviour of the actor itself. The actor is
+ * destroyed, along with any pending messages, once the current message
+ * has been handled.
+ */
+void actor_exit(struct actor *a)
+{
+	a->dead = 1;
+}
+
+/**
+ * @brief Runs the scheduler.
+ *
+ * @details Actors with pending messages are served round-robin, one
+ * message at a time, and every message runs to completion. The NoC is
+ * polled every ACTOR_POLL_EVERY local messages, and waited on when no
+ * actor is runnable. Returns after actor_shutdown().
+ *
+ * @returns Zero upon success and -1 otherwise.
+ */
+int actor_run(void)
+{
+	unsigned n = 0;
+
+	actor.stop = 0;
+
+	while (!actor.stop)
+	{
+		struct actor *a;
+		struct amsg *m;
+
+		/* Idle. */
+		if (actor.runhead == NULL)
+		{
+			if (actor_recv() < 0)
+				return (-1);
+			continue;
+		}
+
+		if ((++n % ACTOR_POLL_EVERY) == 0)
+		{
+			while (noc_poll(0) > 0)
+			{
+				if (actor_recv() < 0)
+					return (-1);
+			}
+		}
+
+		a = actor.runhead;
+		m = a->head;
+		a->head = m->next;
+
+		a->fn(a, m->from, m->data, m->len);
+		actor.stats.delivered++;
+		noc_buf_free(m);
+
+		/* The run queue may have grown while the actor ran. */
+		actor.runhead = a->rnext;
+		if (actor.runhead == NULL)
+			actor.runtail = NULL;
+		a->queued = 0;
+
+		if (a->dead)
+			actor_destroy(a);
+		else if (a->head != NULL)
+		{
+			a->queued = 1;
+			a->rnext = NULL;
+			if (actor.runhead == NULL)
+				actor.runhead = a;
+			else
+				actor.runtail->rnext = a;
+			actor.runtail = a;
+		}
+	}
+
+	return (0);
+}
+
+/**
+ * @brief Stops the scheduler.
+ *
+ * @details actor_run() returns once the current message has been
+ * handled. Actors and pending messages are kept, so the scheduler can
+ * be resumed.
+ *
+ * @param global Stop the schedulers of all other tiles as well?
+ */
+void actor_shutdown(int global)
+{
+	actor.stop = 1;
+
+	if (!global)
+		return;
+
+	for (int i = 0; i < noc_ntiles(); i++)
+	{
+		if (i != noc_tile())
+			actor_xmit(i, ACTOR_NONE, ACTOR_NONE, ACTOR_KIND_SHUTDOWN, 0, NULL, 0);
+	}
+}
+
+/**
+ * @brief Returns statistics of the local tile.
+ */
+void actor_get_stats(struct actor_stats *stats)
+{
+	*stats = actor.stats;
+}
@@ -0,0 +1,233 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <bridge.h>
+
+/*
+ * Framing only: this file is also built into the host tools, so it
+ * must not depend on the rest of libnoc.
+ */
+
+/**
+ * @brief Pads a payload length to a word.
+ */
+#define BRIDGE_PAD(len) (((len) + 3) & ~((size_t) 3))
+
+/**
+ * @brief Stores a big-endian 32-bit word.
+ */
+static void bridge_put32(uint8_t *p, uint32_t x)
+{
+	p[0] = x >> 24;
+	p[1] = x >> 16;
+	p[2] = x >> 8;
+	p[3] = x;
+}
+
+/**
+ * @brief Loads a big-endian 32-bit word.
+ */
+static uint32_t bridge_get32(const uint8_t *p)
+{
+	return (((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3]);
+}
+
+/**
+ * @brief Starts an empty batch.
+ */
+void bridge_batch_init(struct bridge_batch *b)
+{
+	b->len = BRIDGE_HDR_SIZE;
+	b->count = 0;
+}
+
+/**
+ * @brief Appends a record to a batch.
+ *
+ * @param b    Batch.
+ * @param tile Tile.
+ * @param port Port.
+ * @param data Payload.
+ * @param len  Payload length (at most NOC_MSG_MAX bytes).
+ *
+ * @returns Zero upon success, and -1 if the batch must be flushed
+ * first or the record is too large.
+ */
+int bridge_batch_add(struct bridge_batch *b, int tile, int port, const void *data, size_t len)
+{
+	size_t size = BRIDGE_REC_SIZE + BRIDGE_PAD(len);
+	uint8_t *p = &b->buf[b->len];
+
+	if ((len > NOC_MSG_MAX) ||
+		((b->count > 0) && (b->len - BRIDGE_HDR_SIZE + size > BRIDGE_BATCH_MAX)))
+		return (-1);
+
+	p[0] = tile;
+	p[1] = 0;
+	p[2] = port >> 8;
+	p[3] = port;
+	bridge_put32(&p[4], len);
+	memcpy(&p[BRIDGE_REC_SIZE], data, len);
+	memset(&p[BRIDGE_REC_SIZE + len], 0, BRIDGE_PAD(len) - len);
+
+	b->len += size;
+	b->count++;
+
+	return (0);
+}
+
+/**
+ * @brief Writes a batch out and empties it.
+ *
+ * @param b  Batch.
+ * @param fd Stream.
+ *
+ * @returns Zero upon success and -1 otherwise.
+ */
+int bridge_batch_flush(struct bridge_batch *b, int fd)
+{
+	size_t off = 0;
+
+	if (b->count == 0)
+		return (0);
+
+	bridge_put32(&b->buf[0], BRIDGE_MAGIC);
+	bridge_put32(&b->buf[4], b->len - BRIDGE_HDR_SIZE);
+	bridge_put32(&b->buf[8], b->count);
+	bridge_put32(&b->buf[12], b->seq++);
+
+	while (off < b->len)
+	{
+		ssize_t n;
+
+		if ((n = write(fd, &b->buf[off], b->len - off)) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return (-1);
+		}
+		off += n;
+	}
+
+	bridge_batch_init(b);
+
+	return (0);
+}
+
+/**
+ * @brief Starts reading a stream.
+ */
+void bridge_reader_init(struct bridge_reader *r)
+{
+	memset(r, 0, offsetof(struct bridge_reader, buf));
+}
+
+/**
+ * @brief Reads more of a stream.
+ *
+ * @returns The number of bytes read, zero at the end of the stream and
+ * -1 on error.
+ */
+ssize_t bridge_read(struct bridge_reader *r, int fd)
+{
+	ssize_t n;
+
+	/* Make room, once the current batch is consumed. */
+	if ((r->rec == r->end) && (r->head > 0))
+	{
+		memmove(r->buf, &r->buf[r->head], r->tail - r->head);
+		r->tail -= r->head;
+		r->rec = r->end = r->head = 0;
+	}
+
+	do
+		n = read(fd, &r->buf[r->tail], sizeof(r->buf) - r->tail);
+	while ((n < 0) && (errno == EINTR));
+
+	if (n > 0)
+		r->tail += n;
+
+	return (n);
+}
+
+/**
+ * @brief Returns the next record of a stream.
+ *
+ * @details Garbage between batches, such as a partial batch left by a
+ * restarted peer, is skipped up to the next magic word. A batch whose
+ * records do not add up is dropped.
+ *
+ * @param r    Reader.
+ * @param tile Store location for the tile.
+ * @param port Store location for the port.
+ * @param len  Store location for the payload length.
+ *
+ * @returns The payload, valid until the next call, or NULL if more of
+ * the stream must be read first.
+ */
+const void *bridge_next(struct bridge_reader *r, int *tile, int *port, size_t *len)
+{
+	while (1)
+	{
+		/* Next record of the current batch. */
+		if (r->rec < r->end)
+		{
+			const uint8_t *p = &r->buf[r->rec];
+			size_t n;
+
+			if ((r->end - r->rec < BRIDGE_REC_SIZE) ||
+				((n = bridge_get32(&p[4])) > NOC_MSG_MAX) ||
+				(r->end - r->rec - BRIDGE_REC_SIZE < BRIDGE_PAD(n)))
+			{
+				r->resyncs += r->end - r->rec;
+				r->rec = r->end;
+				continue;
+			}
+
+			*tile = p[0];
+			*port = (p[2] << 8) | p[3];
+			*len = n;
+			r->rec += BRIDGE_REC_SIZE + BRIDGE_PAD(n);
+
+			return (&p[BRIDGE_REC_SIZE]);
+		}
+
+		/* Next batch. */
+		if (r->tail - r->head < BRIDGE_HDR_SIZE)
+			return (NULL);
+
+		if ((bridge_get32(&r->buf[r->head]) != BRIDGE_MAGIC) ||
+			(bridge_get32(&r->buf[r->head + 4]) > BRIDGE_FRAME_MAX - BRIDGE_HDR_SIZE))
+		{
+			r->head++;
+			r->resyncs++;
+			continue;
+		}
+
+		if (r->tail - r->head < BRIDGE_HDR_SIZE + bridge_get32(&r->buf[r->head + 4]))
+			return (NULL);
+
+		r->rec = r->head + BRIDGE_HDR_SIZE;
+		r->end = r->rec + bridge_get32(&r->buf[r->head + 4]);
+		r->head = r->end;
+		r->batches++;
+	}
+}
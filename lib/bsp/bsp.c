@@ -0,0 +1,988 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <bsp.h>
+#include <noc.h>
+
+/**
+ * @name Message types.
+ */
+/**@{*/
+#define BSP_MSG_DATA  0 /**< Puts, get requests and sends. */
+#define BSP_MSG_UP    1 /**< Barrier arrival (counts).     */
+#define BSP_MSG_DOWN  2 /**< Barrier release (counts).     */
+#define BSP_MSG_REPLY 3 /**< Get replies.                  */
+/**@}*/
+
+/**
+ * @brief Last reply message of a superstep.
+ */
+#define BSP_FLAG_LAST 1
+
+/**
+ * @name Record operations.
+ */
+/**@{*/
+#define BSP_OP_PUT   0 /**< Write to a registered area.   */
+#define BSP_OP_GET   1 /**< Read from a registered area.  */
+#define BSP_OP_SEND  2 /**< BSMP message.                 */
+#define BSP_OP_REPLY 3 /**< Data read by a get.           */
+/**@}*/
+
+/**
+ * @brief Message header.
+ */
+struct bsp_msghdr
+{
+	uint8_t type;  /**< Message type.             */
+	uint8_t flags; /**< Message flags.            */
+	uint16_t step; /**< Superstep of the message. */
+};
+
+/**
+ * @brief Record header.
+ */
+struct bsp_rec
+{
+	uint8_t op;      /**< Operation.                     */
+	uint8_t unused;  /**< Padding.                       */
+	uint16_t slot;   /**< Registration slot.             */
+	uint32_t offset; /**< Offset in the registered area. */
+	uint32_t nbytes; /**< Payload size.                  */
+	uint32_t extra;  /**< Tag (sends) or get ID.         */
+};
+
+/**
+ * @brief Largest payload of a single record.
+ */
+#define BSP_CHUNK (NOC_MSG_MAX - sizeof(struct bsp_msghdr) - sizeof(struct bsp_rec))
+
+/**
+ * @brief Growable byte buffer.
+ */
+struct buffer
+{
+	uint8_t *data; /**< Contents. */
+	size_t len;    /**< Length.   */
+	size_t cap;    /**< Capacity. */
+};
+
+/**
+ * @brief Message kept for later.
+ */
+struct msg
+{
+	struct msg *next; /**< Next message.   */
+	int src;          /**< Source tile.    */
+	size_t len;       /**< Message length. */
+	uint8_t data[];   /**< Message data.   */
+};
+
+/**
+ * @brief BSMP message.
+ */
+struct qmsg
+{
+	struct qmsg *next; /**< Next message.   */
+	uint32_t tag;      /**< Message tag.    */
+	size_t len;        /**< Payload length. */
+	uint8_t data[];    /**< Payload.        */
+};
+
+/**
+ * @brief Pending get.
+ */
+struct getreq
+{
+	void *dst; /**< Local destination. */
+};
+
+/**
+ * @brief BSP library state.
+ */
+static struct
+{
+	int pid;                 /**< Local process (tile) ID.        */
+	int nprocs;              /**< Number of processes.            */
+	int parent;              /**< Barrier tree parent.            */
+	int children[2];         /**< Barrier tree children.          */
+	int nchildren;           /**< Number of children.             */
+	uint16_t step;           /**< Current superstep.              */
+
+	/**
+	 * @name Registered areas.
+	 */
+	/**@{*/
+	struct
+	{
+		const void *addr;    /**< Base address. */
+		size_t size;         /**< Size.         */
+	} regs[BSP_MAX_REGS];
+	int nregs;               /**< Number of registrations.        */
+	/**@}*/
+
+	struct buffer out[NOC_MAX_TILES];     /**< Outgoing records.    */
+	struct buffer replies[NOC_MAX_TILES]; /**< Outgoing replies.    */
+
+	struct getreq *gets;     /**< Pending gets.                   */
+	size_t ngets;            /**< Number of pending gets.         */
+	size_t capgets;          /**< Capacity of pending gets.       */
+	uint32_t getmask;        /**< Tiles we have asked data from.  */
+
+	struct msg *stash;       /**< Messages of the next superstep. */
+	struct msg *puts;        /**< Data messages to apply.         */
+	struct qmsg *queue;      /**< Readable BSMP queue.            */
+	struct qmsg *nextq;      /**< BSMP queue being filled.        */
+	struct qmsg **nexttail;  /**< Tail of the BSMP queue.         */
+
+	/**
+	 * @name Per-superstep synchronization state.
+	 */
+	/**@{*/
+	uint16_t sum[NOC_MAX_TILES]; /**< Messages per destination. */
+	int nup;                     /**< Children arrived.         */
+	int expected;                /**< Data messages expected.   */
+	int ndata;                   /**< Data messages received.   */
+	int nreplies;                /**< Reply trains received.    */
+	/**@}*/
+
+	struct bsp_stats stats;  /**< Statistics.                     */
+} bsp;
+
+/**
+ * @brief Receive buffer.
+ */
+static uint8_t rxbuf[NOC_MSG_MAX];
+
+/**
+ * @brief Transmit buffer.
+ */
+static uint8_t txbuf[NOC_MSG_MAX];
+
+/**
+ * @brief Returns the current time in nanoseconds.
+ */
+static uint64_t bsp_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((uint64_t) ts.tv_sec*1000000000ULL + ts.tv_nsec);
+}
+
+/*============================================================================*
+ * Buffers                                                                    *
+ *============================================================================*/
+
+/**
+ * @brief Reserves space at the end of a buffer.
+ */
+static uint8_t *buffer_append(struct buffer *b, size_t n)
+{
+	uint8_t *p;
+
+	if (b->len + n > b->cap)
+	{
+		size_t cap = (b->cap > 0) ? b->cap : 256;
+
+		while (cap < b->len + n)
+			cap *= 2;
+
+		if ((p = realloc(b->data, cap)) == NULL)
+			return (NULL);
+
+		b->data = p;
+		b->cap = cap;
+	}
+
+	p = b->data + b->len;
+	b->len += n;
+
+	return (p);
+}
+
+/**
+ * @brief Appends a record to a buffer.
+ */
+static int record_append(
+	struct buffer *b, int op, int slot, size_t offset,
+	size_t nbytes, uint32_t extra, const void *payload)
+{
+	uint8_t *p;
+	struct bsp_rec rec;
+	size_t plen = (payload != NULL) ? nbytes : 0;
+
+	if ((p = buffer_append(b, sizeof(struct bsp_rec) + plen)) == NULL)
+		return (-1);
+
+	rec.op = op;
+	rec.unused = 0;
+	rec.slot = slot;
+	rec.offset = offset;
+	rec.nbytes = nbytes;
+	rec.extra = extra;
+	memcpy(p, &rec, sizeof(struct bsp_rec));
+	memcpy(p + sizeof(struct bsp_rec), payload, plen);
+
+	return (0);
+}
+
+/**
+ * @brief Returns the wire size of a record.
+ */
+static size_t record_size(const struct bsp_rec *rec)
+{
+	return (sizeof(struct bsp_rec) + ((rec->op == BSP_OP_GET) ? 0 : rec->nbytes));
+}
+
+/**
+ * @brief Sends a message and accounts it.
+ */
+static int bsp_xmit(int dest, const void *buf, size_t len)
+{
+	if (noc_send(dest, NOC_PORT_BSP, buf, len) < 0)
+		return (-1);
+
+	bsp.stats.msgs_sent++;
+	bsp.stats.bytes_sent += len;
+
+	return (0);
+}
+
+/**
+ * @brief Packs the records of a buffer into as few messages as possible.
+ *
+ * @returns The number of messages sent upon success and -1 otherwise.
+ */
+static int buffer_flush(int dest, int type, struct buffer *b)
+{
+	int nmsgs = 0;
+	size_t off = 0;
+	struct bsp_msghdr hdr = { type, 0, bsp.step };
+
+	do
+	{
+		size_t len = sizeof(struct bsp_msghdr);
+
+		/* Fill message with whole records. */
+		while (off < b->len)
+		{
+			struct bsp_rec rec;
+			size_t n;
+
+			memcpy(&rec, b->data + off, sizeof(struct bsp_rec));
+			if (len + (n = record_size(&rec)) > NOC_MSG_MAX)
+				break;
+
+			memcpy(txbuf + len, b->data + off, n);
+			len += n;
+			off += n;
+		}
+
+		if (off >= b->len)
+			hdr.flags |= BSP_FLAG_LAST;
+		memcpy(txbuf, &hdr, sizeof(struct bsp_msghdr));
+
+		if (bsp_xmit(dest, txbuf, len) < 0)
+			return (-1);
+		nmsgs++;
+	} while (off < b->len);
+
+	b->len = 0;
+
+	return (nmsgs);
+}
+
+/*============================================================================*
+ * Registration                                                               *
+ *============================================================================*/
+
+/**
+ * @brief Finds the registration slot of an address.
+ */
+static int bsp_slot(const void *addr)
+{
+	/* Most recent registration wins. */
+	for (int i = bsp.nregs - 1; i >= 0; i--)
+	{
+		if (bsp.regs[i].addr == addr)
+			return (i);
+	}
+
+	return (-1);
+}
+
+/**
+ * @brief Registers a memory area for remote access.
+ *
+ * @details Registration is collective: all processes must register
+ * their areas in the same order, so that the n-th registration names
+ * the same logical area everywhere.
+ */
+int bsp_push_reg(const void *addr, size_t size)
+{
+	if (bsp.nregs == BSP_MAX_REGS)
+	{
+		errno = ENOSPC;
+		return (-1);
+	}
+
+	bsp.regs[bsp.nregs].addr = addr;
+	bsp.regs[bsp.nregs].size = size;
+	bsp.nregs++;
+
+	return (0);
+}
+
+/**
+ * @brief Unregisters the most recent registration of a memory area.
+ */
+int bsp_pop_reg(const void *addr)
+{
+	int slot;
+
+	if ((slot = bsp_slot(addr)) < 0)
+	{
+		errno = EINVAL;
+		return (-1);
+	}
+
+	bsp.regs[slot].addr = NULL;
+	bsp.regs[slot].size = 0;
+
+	/* Release trailing slots. */
+	while ((bsp.nregs > 0) && (bsp.regs[bsp.nregs - 1].addr == NULL))
+		bsp.nregs--;
+
+	return (0);
+}
+
+/*============================================================================*
+ * Communication                                                              *
+ *============================================================================*/
+
+/**
+ * @brief Buffers a write to a remote registered area.
+ *
+ * @details The source is copied immediately, and the write takes effect
+ * at the end of the current superstep.
+ */
+int bsp_put(int pid, const void *src, const void *dst, size_t offset, size_t nbytes)
+{
+	int slot;
+	const uint8_t *p = src;
+
+	if ((pid < 0) || (pid >= bsp.nprocs) || ((slot = bsp_slot(dst)) < 0) ||
+		(offset + nbytes > bsp.regs[slot].size))
+	{
+		errno = EINVAL;
+		return (-1);
+	}
+
+	while (nbytes > 0)
+	{
+		size_t n = (nbytes < BSP_CHUNK) ? nbytes : BSP_CHUNK;
+
+		if (record_append(&bsp.out[pid], BSP_OP_PUT, slot, offset, n, 0, p) < 0)
+			return (-1);
+
+		p += n;
+		offset += n;
+		nbytes -= n;
+	}
+
+	return (0);
+}
+
+/**
+ * @brief Buffers a read from a remote registered area.
+ *
+ * @details The remote area is read at the end of the current superstep,
+ * before any put of that superstep is applied.
+ */
+int bsp_get(int pid, const void *src, size_t offset, void *dst, size_t nbytes)
+{
+	int slot;
+	uint8_t *p = dst;
+
+	if ((pid < 0) || (pid >= bsp.nprocs) || ((slot = bsp_slot(src)) < 0) ||
+		(offset + nbytes > bsp.regs[slot].size))
+	{
+		errno = EINVAL;
+		return (-1);
+	}
+
+	while (nbytes > 0)
+	{
+		size_t n = (nbytes < BSP_CHUNK) ? nbytes : BSP_CHUNK;
+
+		if (bsp.ngets == bsp.capgets)
+		{
+			size_t cap = (bsp.capgets > 0) ? 2*bsp.capgets : 16;
+			struct getreq *gets;
+
+			if ((gets = realloc(bsp.gets, cap*sizeof(struct getreq))) == NULL)
+				return (-1);
+			bsp.gets = gets;
+			bsp.capgets = cap;
+		}
+
+		if (record_append(&bsp.out[pid], BSP_OP_GET, slot, offset, n, bsp.ngets, NULL) < 0)
+			return (-1);
+
+		bsp.gets[bsp.ngets++].dst = p;
+		bsp.getmask |= 1u << pid;
+
+		p += n;
+		offset += n;
+		nbytes -= n;
+	}
+
+	return (0);
+}
+
+/**
+ * @brief Buffers a BSMP message, readable by the target in the next
+ * superstep.
+ */
+int bsp_send(int pid, uint32_t tag, const void *payload, size_t nbytes)
+{
+	if ((pid < 0) || (pid >= bsp.nprocs))
+	{
+		errno = EINVAL;
+		return (-1);
+	}
+
+	if (nbytes > BSP_CHUNK)
+	{
+		errno = EMSGSIZE;
+		return (-1);
+	}
+
+	return (record_append(&bsp.out[pid], BSP_OP_SEND, 0, 0, nbytes, tag, payload));
+}
+
+/**
+ * @brief Returns the number of queued BSMP messages and their total size.
+ */
+void bsp_qsize(int *nmsgs, size_t *nbytes)
+{
+	int n = 0;
+	size_t size = 0;
+
+	for (struct qmsg *m = bsp.queue; m != NULL; m = m->next)
+	{
+		n++;
+		size += m->len;
+	}
+
+	if (nmsgs != NULL)
+		*nmsgs = n;
+	if (nbytes != NULL)
+		*nbytes = size;
+}
+
+/**
+ * @brief Peeks at the first queued BSMP message.
+ *
+ * @returns Zero and the payload size in @p status, or -1 in @p status if
+ * the queue is empty.
+ */
+int bsp_get_tag(int *status, uint32_t *tag)
+{
+	if (bsp.queue == NULL)
+	{
+		*status = -1;
+		return (0);
+	}
+
+	*status = (int) bsp.queue->len;
+	if (tag != NULL)
+		*tag = bsp.queue->tag;
+
+	return (0);
+}
+
+/**
+ * @brief Dequeues the first BSMP message.
+ */
+int bsp_move(void *buf, size_t size)
+{
+	struct qmsg *m;
+
+	if ((m = bsp.queue) == NULL)
+	{
+		errno = ENOMSG;
+		return (-1);
+	}
+
+	memcpy(buf, m->data, (m->len < size) ? m->len : size);
+	bsp.queue = m->next;
+	free(m);
+
+	return (0);
+}
+
+/*============================================================================*
+ * Synchronization                                                            *
+ *============================================================================*/
+
+/**
+ * @brief Sends barrier counts to a tile.
+ */
+static int bsp_counts(int dest, int type, const uint16_t *counts)
+{
+	struct bsp_msghdr hdr = { type, 0, bsp.step };
+
+	memcpy(txbuf, &hdr, sizeof(struct bsp_msghdr));
+	memcpy(txbuf + sizeof(struct bsp_msghdr), counts, bsp.nprocs*sizeof(uint16_t));
+
+	return (bsp_xmit(dest, txbuf, sizeof(struct bsp_msghdr) + bsp.nprocs*sizeof(uint16_t)));
+}
+
+/**
+ * @brief Releases the barrier subtree below the local tile.
+ */
+static int bsp_release(const uint16_t *counts)
+{
+	bsp.expected = counts[bsp.pid];
+
+	for (int i = 0; i < bsp.nchildren; i++)
+	{
+		if (bsp_counts(bsp.children[i], BSP_MSG_DOWN, counts) < 0)
+			return (-1);
+	}
+
+	return (0);
+}
+
+/**
+ * @brief Reports arrival of the local subtree to the barrier.
+ */
+static int bsp_arrive(void)
+{
+	if (bsp.parent < 0)
+		return (bsp_release(bsp.sum));
+
+	return (bsp_counts(bsp.parent, BSP_MSG_UP, bsp.sum));
+}
+
+/**
+ * @brief Keeps a copy of a message.
+ */
+static int bsp_keep(struct msg **list, int src, const void *data, size_t len)
+{
+	struct msg *m;
+
+	if ((m = malloc(sizeof(struct msg) + len)) == NULL)
+		return (-1);
+
+	m->src = src;
+	m->len = len;
+	memcpy(m->data, data, len);
+
+	/* Keep arrival order. */
+	while (*list != NULL)
+		list = &(*list)->next;
+	m->next = NULL;
+	*list = m;
+
+	return (0);
+}
+
+/**
+ * @brief Handles the records of a data message.
+ */
+static int bsp_data(int src, const uint8_t *data, size_t len)
+{
+	int hasputs = 0;
+	size_t off = sizeof(struct bsp_msghdr);
+
+	while (off + sizeof(struct bsp_rec) <= len)
+	{
+		struct bsp_rec rec;
+		const uint8_t *payload;
+
+		memcpy(&rec, data + off, sizeof(struct bsp_rec));
+		payload = data + off + sizeof(struct bsp_rec);
+
+		switch (rec.op)
+		{
+			/* Applied once all gets are served. */
+			case BSP_OP_PUT:
+				hasputs = 1;
+				break;
+
+			case BSP_OP_GET:
+				if ((rec.slot >= bsp.nregs) ||
+					(rec.offset + rec.nbytes > bsp.regs[rec.slot].size))
+				{
+					errno = EFAULT;
+					return (-1);
+				}
+				if (record_append(&bsp.replies[src], BSP_OP_REPLY, 0, 0, rec.nbytes,
+					rec.extra, (const uint8_t *) bsp.regs[rec.slot].addr + rec.offset) < 0)
+					return (-1);
+				break;
+
+			case BSP_OP_SEND:
+			{
+				struct qmsg *m;
+
+				if ((m = malloc(sizeof(struct qmsg) + rec.nbytes)) == NULL)
+					return (-1);
+				m->next = NULL;
+				m->tag = rec.extra;
+				m->len = rec.nbytes;
+				memcpy(m->data, payload, rec.nbytes);
+				*bsp.nexttail = m;
+				bsp.nexttail = &m->next;
+			} break;
+		}
+
+		off += record_size(&rec);
+	}
+
+	if (hasputs)
+		return (bsp_keep(&bsp.puts, src, data, len));
+
+	return (0);
+}
+
+/**
+ * @brief Applies the puts of a data message.
+ */
+static int bsp_apply(const uint8_t *data, size_t len)
+{
+	size_t off = sizeof(struct bsp_msghdr);
+
+	while (off + sizeof(struct bsp_rec) <= len)
+	{
+		struct bsp_rec rec;
+
+		memcpy(&rec, data + off, sizeof(struct bsp_rec));
+
+		if (rec.op == BSP_OP_PUT)
+		{
+			if ((rec.slot >= bsp.nregs) ||
+				(rec.offset + rec.nbytes > bsp.regs[rec.slot].size))
+			{
+				errno = EFAULT;
+				return (-1);
+			}
+			memcpy((uint8_t *) bsp.regs[rec.slot].addr + rec.offset,
+				data + off + sizeof(struct bsp_rec), rec.nbytes);
+		}
+
+		off += record_size(&rec);
+	}
+
+	return (0);
+}
+
+/**
+ * @brief Handles a get reply message.
+ */
+static void bsp_reply(const uint8_t *data, size_t len)
+{
+	size_t off = sizeof(struct bsp_msghdr);
+
+	while (off + sizeof(struct bsp_rec) <= len)
+	{
+		struct bsp_rec rec;
+
+		memcpy(&rec, data + off, sizeof(struct bsp_rec));
+		if (rec.extra < bsp.ngets)
+			memcpy(bsp.gets[rec.extra].dst, data + off + sizeof(struct bsp_rec), rec.nbytes);
+
+		off += record_size(&rec);
+	}
+}
+
+/**
+ * @brief Handles a message of the current superstep.
+ */
+static int bsp_dispatch(int src, const uint8_t *data, size_t len)
+{
+	struct bsp_msghdr hdr;
+	uint16_t counts[NOC_MAX_TILES];
+
+	if (len < sizeof(struct bsp_msghdr))
+		return (0);
+
+	memcpy(&hdr, data, sizeof(struct bsp_msghdr));
+
+	/* A peer has already moved on. */
+	if (hdr.step != bsp.step)
+		return (bsp_keep(&bsp.stash, src, data, len));
+
+	switch (hdr.type)
+	{
+		case BSP_MSG_DATA:
+			bsp.ndata++;
+			return (bsp_data(src, data, len));
+
+		case BSP_MSG_UP:
+			memcpy(counts, data + sizeof(struct bsp_msghdr), bsp.nprocs*sizeof(uint16_t));
+			for (int i = 0; i < bsp.nprocs; i++)
+				bsp.sum[i] += counts[i];
+			if (++bsp.nup == bsp.nchildren)
+				return (bsp_arrive());
+			break;
+
+		case BSP_MSG_DOWN:
+			memcpy(counts, data + sizeof(struct bsp_msghdr), bsp.nprocs*sizeof(uint16_t));
+			return (bsp_release(counts));
+
+		case BSP_MSG_REPLY:
+			bsp_reply(data, len);
+			if (hdr.flags & BSP_FLAG_LAST)
+				bsp.nreplies++;
+			break;
+	}
+
+	return (0);
+}
+
+/**
+ * @brief Receives and handles one message.
+ */
+static int bsp_receive(void)
+{
+	int src, port;
+	ssize_t len;
+
+	if ((len = noc_recv(&src, &port, rxbuf, sizeof(rxbuf))) < 0)
+		return (-1);
+
+	if (port != NOC_PORT_BSP)
+		return (0);
+
+	return (bsp_dispatch(src, rxbuf, len));
+}
+
+/**
+ * @brief Ends the current superstep.
+ *
+ * @details Buffered operations are combined into one message train per
+ * destination. Arrival is then reported up a spanning tree that follows
+ * mesh links (along rows towards column zero, then up column zero), so
+ * every barrier message travels a single hop. The tree also sums how
+ * many data messages each tile must wait for, which lets tiles skip
+ * destinations they have nothing to say to.
+ *
+ * @returns Zero upon success and -1 otherwise.
+ */
+int bsp_sync(void)
+{
+	struct msg *m, **pm;
+	uint64_t t0 = bsp_now();
+	int nrequested = 0;
+
+	memset(bsp.sum, 0, sizeof(bsp.sum));
+	bsp.nup = 0;
+	bsp.expected = -1;
+	bsp.ndata = 0;
+	bsp.nreplies = 0;
+
+	/* Send data. */
+	for (int i = 0; i < bsp.nprocs; i++)
+	{
+		int n;
+
+		if (bsp.out[i].len == 0)
+			continue;
+
+		if ((n = buffer_flush(i, BSP_MSG_DATA, &bsp.out[i])) < 0)
+			return (-1);
+		bsp.sum[i] += n;
+	}
+
+	/* Early messages of this superstep. */
+	pm = &bsp.stash;
+	while ((m = *pm) != NULL)
+	{
+		struct bsp_msghdr hdr;
+
+		memcpy(&hdr, m->data, sizeof(struct bsp_msghdr));
+		if (hdr.step != bsp.step)
+		{
+			pm = &m->next;
+			continue;
+		}
+
+		*pm = m->next;
+		if (bsp_dispatch(m->src, m->data, m->len) < 0)
+		{
+			free(m);
+			return (-1);
+		}
+		free(m);
+	}
+
+	if (bsp.nchildren == 0)
+	{
+		if (bsp_arrive() < 0)
+			return (-1);
+	}
+
+	/* Barrier and data exchange. */
+	while ((bsp.expected < 0) || (bsp.ndata < bsp.expected))
+	{
+		if (bsp_receive() < 0)
+			return (-1);
+	}
+
+	/* Serve gets before applying puts. */
+	for (int i = 0; i < bsp.nprocs; i++)
+	{
+		if (bsp.replies[i].len == 0)
+			continue;
+
+		if (buffer_flush(i, BSP_MSG_REPLY, &bsp.replies[i]) < 0)
+			return (-1);
+	}
+
+	while ((m = bsp.puts) != NULL)
+	{
+		bsp.puts = m->next;
+		if (bsp_apply(m->data, m->len) < 0)
+		{
+			free(m);
+			return (-1);
+		}
+		free(m);
+	}
+
+	/* Wait for replies to our gets. */
+	for (int i = 0; i < bsp.nprocs; i++)
+	{
+		if (bsp.getmask & (1u << i))
+			nrequested++;
+	}
+	while (bsp.nreplies < nrequested)
+	{
+		if (bsp_receive() < 0)
+			return (-1);
+	}
+
+	/* Messages sent in this superstep become readable. */
+	while (bsp.queue != NULL)
+		bsp_move(rxbuf, 0);
+	bsp.queue = bsp.nextq;
+	bsp.nextq = NULL;
+	bsp.nexttail = &bsp.nextq;
+
+	bsp.ngets = 0;
+	bsp.getmask = 0;
+	bsp.step++;
+
+	bsp.stats.supersteps++;
+	bsp.stats.sync_time += bsp_now() - t0;
+
+	return (0);
+}
+
+/*============================================================================*
+ * Setup                                                                      *
+ *============================================================================*/
+
+/**
+ * @brief Starts a BSP computation on all tiles.
+ */
+int bsp_begin(void)
+{
+	int width;
+
+	if (noc_init() < 0)
+		return (-1);
+
+	memset(&bsp, 0, sizeof(bsp));
+	bsp.pid = noc_tile();
+	bsp.nprocs = noc_ntiles();
+	bsp.nexttail = &bsp.nextq;
+
+	/* Barrier tree over mesh links. */
+	width = noc_mesh_width();
+	if (bsp.pid % width > 0)
+		bsp.parent = bsp.pid - 1;
+	else
+		bsp.parent = (bsp.pid >= width) ? bsp.pid - width : -1;
+	if ((bsp.pid % width + 1 < width) && (bsp.pid + 1 < bsp.nprocs))
+		bsp.children[bsp.nchildren++] = bsp.pid + 1;
+	if ((bsp.pid % width == 0) && (bsp.pid + width < bsp.nprocs))
+		bsp.children[bsp.nchildren++] = bsp.pid + width;
+
+	return (0);
+}
+
+/**
+ * @brief Ends a BSP computation.
+ */
+void bsp_end(void)
+{
+	struct msg *m;
+
+	bsp_sync();
+
+	for (int i = 0; i < NOC_MAX_TILES; i++)
+	{
+		free(bsp.out[i].data);
+		free(bsp.replies[i].data);
+	}
+	free(bsp.gets);
+
+	while ((m = bsp.stash) != NULL)
+	{
+		bsp.stash = m->next;
+		free(m);
+	}
+	while (bsp.queue != NULL)
+		bsp_move(rxbuf, 0);
+
+	memset(&bsp, 0, sizeof(bsp));
+}
+
+/**
+ * @brief Returns the local process ID.
+ */
+int bsp_pid(void)
+{
+	return (bsp.pid);
+}
+
+/**
+ * @brief Returns the number of processes.
+ */
+int bsp_nprocs(void)
+{
+	return (bsp.nprocs);
+}
+
+/**
+ * @brief Returns superstep statistics.
+ */
+void bsp_get_stats(struct bsp_stats *stats)
+{
+	*stats = bsp.stats;
+}
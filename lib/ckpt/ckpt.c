@@ -0,0 +1,705 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <ckpt.h>
+#include <noc.h>
+
+/**
+ * @name Message types.
+ */
+/**@{*/
+#define CKPT_BEGIN     0 /**< Snapshot layout, starts a transfer.   */
+#define CKPT_BEGIN_ACK 1 /**< Server accepted a checkpoint.         */
+#define CKPT_DATA      2 /**< Run of chunks.                        */
+#define CKPT_END       3 /**< Ends a transfer, carries the checksum. */
+#define CKPT_END_ACK   4 /**< Server committed a checkpoint.        */
+#define CKPT_RESTORE   5 /**< Restore request.                      */
+#define CKPT_STOP      6 /**< Stops the server.                     */
+/**@}*/
+
+/**
+ * @name Status codes.
+ */
+/**@{*/
+#define CKPT_OK       0 /**< Success.                               */
+#define CKPT_NEEDFULL 1 /**< No base for an incremental checkpoint. */
+#define CKPT_NOSNAP   2 /**< No snapshot to restore.                */
+#define CKPT_NOMEM    3 /**< Server out of memory.                  */
+#define CKPT_BADSUM   4 /**< Checksum mismatch.                     */
+/**@}*/
+
+/**
+ * @brief Chunks per data message.
+ */
+#define CKPT_RUN ((NOC_MSG_MAX - sizeof(struct ckpt_msghdr))/CKPT_CHUNK)
+
+/**
+ * @brief Message header.
+ */
+struct ckpt_msghdr
+{
+	uint8_t type;    /**< Message type.                                 */
+	uint8_t status;  /**< Status code (flags in CKPT_BEGIN).            */
+	uint16_t region; /**< Region (number of regions in CKPT_BEGIN).     */
+	uint32_t epoch;  /**< Checkpoint epoch.                             */
+	uint32_t arg;    /**< Offset, base epoch or checksum.               */
+};
+
+/**
+ * @brief Registered region.
+ */
+struct region
+{
+	uint8_t *addr;  /**< Start address.                */
+	size_t size;    /**< Size (in bytes).              */
+	uint32_t *sums; /**< Chunk hashes at last save.    */
+};
+
+/**
+ * @brief Snapshot kept by the server.
+ */
+struct snapshot
+{
+	uint32_t epoch;                   /**< Epoch (zero if none). */
+	uint32_t sum;                     /**< Image checksum.       */
+	int nregions;                     /**< Number of regions.    */
+	uint32_t size[CKPT_MAX_REGIONS];  /**< Region sizes.         */
+	uint8_t *data[CKPT_MAX_REGIONS];  /**< Region contents.      */
+};
+
+/**
+ * @brief Client state.
+ */
+static struct
+{
+	int nregions;                            /**< Registered regions.        */
+	struct region regions[CKPT_MAX_REGIONS]; /**< Regions.                   */
+	uint32_t epoch;                          /**< Last epoch used.           */
+	uint32_t base;                           /**< Epoch the hashes match.    */
+	int basepeer;                            /**< Tile holding that epoch.   */
+} ckpt;
+
+/**
+ * @brief Server state.
+ */
+static struct
+{
+	struct snapshot committed[NOC_MAX_TILES]; /**< Last good snapshots.  */
+	struct snapshot staging[NOC_MAX_TILES];   /**< Transfers under way.  */
+} server;
+
+/**
+ * @brief Message buffer.
+ */
+static uint8_t msgbuf[NOC_MSG_MAX];
+
+/**
+ * @brief Returns the current time in nanoseconds.
+ */
+static uint64_t ckpt_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((uint64_t) ts.tv_sec*1000000000ULL + ts.tv_nsec);
+}
+
+/**
+ * @brief Hashes a chunk.
+ *
+ * @details Word-wise FNV with a shift to carry high bits down, so a
+ * change anywhere in the chunk reaches every bit of the result.
+ */
+static uint32_t ckpt_hash(const uint8_t *p, size_t n)
+{
+	size_t i;
+	uint32_t h = 2166136261u;
+
+	for (i = 0; i + sizeof(uint32_t) <= n; i += sizeof(uint32_t))
+	{
+		uint32_t w;
+
+		memcpy(&w, p + i, sizeof(uint32_t));
+		h = (h ^ w)*16777619u;
+		h ^= h >> 15;
+	}
+
+	for (/* noop */; i < n; i++)
+		h = (h ^ p[i])*16777619u;
+
+	return (h);
+}
+
+/**
+ * @brief Folds a chunk hash into an image checksum.
+ */
+static inline uint32_t ckpt_fold(uint32_t sum, uint32_t h)
+{
+	return (((sum ^ h)*16777619u) ^ (sum >> 13));
+}
+
+/**
+ * @brief Returns the number of chunks in a region.
+ */
+static inline size_t ckpt_nchunks(size_t size)
+{
+	return ((size + CKPT_CHUNK - 1)/CKPT_CHUNK);
+}
+
+/**
+ * @brief Sends a message.
+ */
+static int ckpt_xmit(int dest, int type, int status, int region, uint32_t epoch, uint32_t arg,
+	const void *data, size_t len)
+{
+	struct ckpt_msghdr hdr = { type, status, region, epoch, arg };
+
+	memcpy(msgbuf, &hdr, sizeof(struct ckpt_msghdr));
+	if (len > 0)
+		memcpy(msgbuf + sizeof(struct ckpt_msghdr), data, len);
+
+	return ((noc_send(dest, NOC_PORT_CKPT, msgbuf, sizeof(struct ckpt_msghdr) + len) < 0) ? -1 : 0);
+}
+
+/**
+ * @brief Receives a checkpoint message into msgbuf.
+ *
+ * @returns The payload length upon success and -1 otherwise.
+ */
+static ssize_t ckpt_recv(int *src, struct ckpt_msghdr *hdr)
+{
+	int port;
+	ssize_t len;
+
+	do
+	{
+		if ((len = noc_recv(src, &port, msgbuf, sizeof(msgbuf))) < 0)
+			return (-1);
+	} while ((port != NOC_PORT_CKPT) || (len < (ssize_t) sizeof(struct ckpt_msghdr)));
+
+	memcpy(hdr, msgbuf, sizeof(struct ckpt_msghdr));
+
+	return (len - sizeof(struct ckpt_msghdr));
+}
+
+/**
+ * @brief Waits for a given message from a tile.
+ */
+static ssize_t ckpt_wait(int peer, int type, struct ckpt_msghdr *hdr)
+{
+	int src;
+	ssize_t len;
+
+	do
+	{
+		if ((len = ckpt_recv(&src, hdr)) < 0)
+			return (-1);
+	} while ((src != peer) || (hdr->type != type));
+
+	return (len);
+}
+
+/**
+ * @brief Registers a memory region for checkpointing.
+ *
+ * @details Regions are saved and restored in registration order, and
+ * restoring requires the same layout. Registering a region makes the
+ * next checkpoint a full one.
+ *
+ * @param addr Start address.
+ * @param size Size (in bytes).
+ *
+ * @returns The region number upon success and -1 otherwise.
+ */
+int ckpt_register(void *addr, size_t size)
+{
+	struct region *r;
+
+	if ((addr == NULL) || (size == 0) || (size > UINT32_MAX) ||
+		(ckpt.nregions == CKPT_MAX_REGIONS))
+	{
+		errno = EINVAL;
+		return (-1);
+	}
+
+	r = &ckpt.regions[ckpt.nregions];
+	if ((r->sums = calloc(ckpt_nchunks(size), sizeof(uint32_t))) == NULL)
+		return (-1);
+	r->addr = addr;
+	r->size = size;
+	ckpt.base = 0;
+
+	return (ckpt.nregions++);
+}
+
+/**
+ * @brief Forgets all registered regions.
+ */
+void ckpt_reset(void)
+{
+	for (int i = 0; i < ckpt.nregions; i++)
+	{
+		free(ckpt.regions[i].sums);
+		ckpt.regions[i].sums = NULL;
+	}
+
+	ckpt.nregions = 0;
+	ckpt.base = 0;
+}
+
+/**
+ * @brief Sends the runs of marked chunks of a region.
+ */
+static int ckpt_send_runs(int peer, int i, const uint8_t *dirty, struct ckpt_stats *stats)
+{
+	struct region *r = &ckpt.regions[i];
+	size_t n = ckpt_nchunks(r->size);
+
+	for (size_t c = 0; c < n; /* noop */)
+	{
+		size_t first, off, len;
+
+		if (!dirty[c])
+		{
+			c++;
+			continue;
+		}
+
+		for (first = c; (c < n) && dirty[c] && (c - first < CKPT_RUN); c++)
+			/* noop */;
+
+		off = first*CKPT_CHUNK;
+		len = ((c*CKPT_CHUNK < r->size) ? c*CKPT_CHUNK : r->size) - off;
+
+		if (ckpt_xmit(peer, CKPT_DATA, 0, i, ckpt.epoch, off, r->addr + off, len) < 0)
+			return (-1);
+
+		stats->bytes += len;
+		stats->chunks += c - first;
+	}
+
+	return (0);
+}
+
+/**
+ * @brief Checkpoints the registered regions to a peer tile.
+ *
+ * @details The caller must keep the regions unchanged while this runs.
+ * An incremental checkpoint hashes every chunk and sends only those
+ * whose hash changed since the last checkpoint acknowledged by the same
+ * peer; the server patches a copy of its previous snapshot. The new
+ * snapshot replaces the old one only if its checksum matches.
+ *
+ * @param peer  Tile that runs ckpt_serve().
+ * @param flags CKPT_FULL or CKPT_INCREMENTAL.
+ * @param stats Store location for statistics (optional).
+ *
+ * @returns Zero upon success and -1 otherwise.
+ */
+int ckpt_save(int peer, int flags, struct ckpt_stats *stats)
+{
+	int full;
+	uint32_t sum = 0;
+	uint32_t sizes[CKPT_MAX_REGIONS];
+	uint64_t t0 = ckpt_now();
+	struct ckpt_msghdr hdr;
+	struct ckpt_stats dummy;
+
+	stats = (stats != NULL) ? stats : &dummy;
+	memset(stats, 0, sizeof(struct ckpt_stats));
+
+	if ((ckpt.nregions == 0) || (peer < 0) || (peer >= noc_ntiles()))
+	{
+		errno = EINVAL;
+		return (-1);
+	}
+
+	full = (flags == CKPT_FULL) || (ckpt.base == 0) || (ckpt.basepeer != peer);
+	stats->epoch = ++ckpt.epoch;
+
+	for (int i = 0; i < ckpt.nregions; i++)
+		sizes[i] = ckpt.regions[i].size;
+
+	if (ckpt_xmit(peer, CKPT_BEGIN, full ? CKPT_FULL : CKPT_INCREMENTAL, ckpt.nregions,
+			ckpt.epoch, ckpt.base, sizes, ckpt.nregions*sizeof(uint32_t)) < 0)
+		goto error;
+
+	if (ckpt_wait(peer, CKPT_BEGIN_ACK, &hdr) < 0)
+		goto error;
+	if (hdr.status == CKPT_NEEDFULL)
+		full = 1;
+	else if (hdr.status != CKPT_OK)
+	{
+		errno = (hdr.status == CKPT_NOMEM) ? ENOMEM : EIO;
+		goto error;
+	}
+
+	/* From here on the hashes no longer describe the server copy. */
+	ckpt.base = 0;
+
+	for (int i = 0; i < ckpt.nregions; i++)
+	{
+		struct region *r = &ckpt.regions[i];
+		size_t n = ckpt_nchunks(r->size);
+		uint8_t *dirty;
+
+		if ((dirty = malloc(n)) == NULL)
+			goto error;
+
+		for (size_t c = 0; c < n; c++)
+		{
+			size_t len = (r->size - c*CKPT_CHUNK < CKPT_CHUNK) ? r->size - c*CKPT_CHUNK : CKPT_CHUNK;
+			uint32_t h = ckpt_hash(r->addr + c*CKPT_CHUNK, len);
+
+			dirty[c] = full || (h != r->sums[c]);
+			stats->chunks_skipped += !dirty[c];
+			r->sums[c] = h;
+			sum = ckpt_fold(sum, h);
+		}
+
+		if (ckpt_send_runs(peer, i, dirty, stats) < 0)
+		{
+			free(dirty);
+			goto error;
+		}
+
+		free(dirty);
+	}
+
+	if (ckpt_xmit(peer, CKPT_END, 0, 0, ckpt.epoch, sum, NULL, 0) < 0)
+		goto error;
+
+	if (ckpt_wait(peer, CKPT_END_ACK, &hdr) < 0)
+		goto error;
+	if (hdr.status != CKPT_OK)
+	{
+		errno = EIO;
+		goto error;
+	}
+
+	ckpt.base = ckpt.epoch;
+	ckpt.basepeer = peer;
+	stats->time = ckpt_now() - t0;
+
+	return (0);
+
+error:
+	ckpt.base = 0;
+	stats->time = ckpt_now() - t0;
+	return (-1);
+}
+
+/**
+ * @brief Restores the registered regions from a peer tile.
+ *
+ * @details Fetches the last snapshot committed by this tile on the
+ * peer. The registered layout must match the saved one. Later
+ * incremental checkpoints build on the restored snapshot.
+ *
+ * @param peer  Tile that runs ckpt_serve().
+ * @param stats Store location for statistics (optional).
+ *
+ * @returns Zero upon success and -1 otherwise.
+ */
+int ckpt_restore(int peer, struct ckpt_stats *stats)
+{
+	int match;
+	ssize_t len;
+	uint32_t sum = 0;
+	uint64_t t0 = ckpt_now();
+	struct ckpt_msghdr hdr;
+	struct ckpt_stats dummy;
+
+	stats = (stats != NULL) ? stats : &dummy;
+	memset(stats, 0, sizeof(struct ckpt_stats));
+
+	if ((peer < 0) || (peer >= noc_ntiles()))
+	{
+		errno = EINVAL;
+		return (-1);
+	}
+
+	ckpt.base = 0;
+
+	if (ckpt_xmit(peer, CKPT_RESTORE, 0, 0, 0, 0, NULL, 0) < 0)
+		return (-1);
+
+	if ((len = ckpt_wait(peer, CKPT_BEGIN, &hdr)) < 0)
+		return (-1);
+	if (hdr.status == CKPT_NOSNAP)
+	{
+		errno = ENOENT;
+		return (-1);
+	}
+
+	/* Check layout. */
+	match = (hdr.region == ckpt.nregions) && (len == (ssize_t)(hdr.region*sizeof(uint32_t)));
+	for (int i = 0; match && (i < ckpt.nregions); i++)
+	{
+		uint32_t size;
+
+		memcpy(&size, msgbuf + sizeof(struct ckpt_msghdr) + i*sizeof(uint32_t), sizeof(uint32_t));
+		match = (size == ckpt.regions[i].size);
+	}
+	stats->epoch = hdr.epoch;
+
+	/* The server streams the snapshot regardless. */
+	while (1)
+	{
+		int src;
+
+		if ((len = ckpt_recv(&src, &hdr)) < 0)
+			return (-1);
+
+		if (src != peer)
+			continue;
+
+		if (hdr.type == CKPT_END)
+			break;
+
+		if ((hdr.type != CKPT_DATA) || !match || (hdr.region >= ckpt.nregions) ||
+			(hdr.arg > ckpt.regions[hdr.region].size) ||
+			((size_t) len > ckpt.regions[hdr.region].size - hdr.arg))
+			continue;
+
+		memcpy(ckpt.regions[hdr.region].addr + hdr.arg, msgbuf + sizeof(struct ckpt_msghdr), len);
+		stats->bytes += len;
+		stats->chunks += ckpt_nchunks(len);
+	}
+
+	if (!match)
+	{
+		errno = EINVAL;
+		return (-1);
+	}
+
+	/* Rebuild the hashes and check the image. */
+	for (int i = 0; i < ckpt.nregions; i++)
+	{
+		struct region *r = &ckpt.regions[i];
+
+		for (size_t c = 0; c < ckpt_nchunks(r->size); c++)
+		{
+			size_t n = (r->size - c*CKPT_CHUNK < CKPT_CHUNK) ? r->size - c*CKPT_CHUNK : CKPT_CHUNK;
+
+			r->sums[c] = ckpt_hash(r->addr + c*CKPT_CHUNK, n);
+			sum = ckpt_fold(sum, r->sums[c]);
+		}
+	}
+
+	stats->time = ckpt_now() - t0;
+
+	if (sum != hdr.arg)
+	{
+		errno = EIO;
+		return (-1);
+	}
+
+	ckpt.base = hdr.epoch;
+	ckpt.basepeer = peer;
+	if (ckpt.epoch < hdr.epoch)
+		ckpt.epoch = hdr.epoch;
+
+	return (0);
+}
+
+/**
+ * @brief Frees a snapshot.
+ */
+static void ckpt_free(struct snapshot *s)
+{
+	for (int i = 0; i < s->nregions; i++)
+		free(s->data[i]);
+
+	memset(s, 0, sizeof(struct snapshot));
+}
+
+/**
+ * @brief Computes the checksum of a snapshot.
+ */
+static uint32_t ckpt_image_sum(const struct snapshot *s)
+{
+	uint32_t sum = 0;
+
+	for (int i = 0; i < s->nregions; i++)
+	{
+		for (size_t c = 0; c < ckpt_nchunks(s->size[i]); c++)
+		{
+			size_t n = (s->size[i] - c*CKPT_CHUNK < CKPT_CHUNK) ? s->size[i] - c*CKPT_CHUNK : CKPT_CHUNK;
+
+			sum = ckpt_fold(sum, ckpt_hash(s->data[i] + c*CKPT_CHUNK, n));
+		}
+	}
+
+	return (sum);
+}
+
+/**
+ * @brief Starts receiving a checkpoint.
+ */
+static int ckpt_serve_begin(int src, const struct ckpt_msghdr *hdr, size_t len)
+{
+	int status = CKPT_OK;
+	struct snapshot *s = &server.staging[src];
+	struct snapshot *base = &server.committed[src];
+
+	ckpt_free(s);
+
+	if ((hdr->region == 0) || (hdr->region > CKPT_MAX_REGIONS) || (len != hdr->region*sizeof(uint32_t)))
+		return (ckpt_xmit(src, CKPT_BEGIN_ACK, CKPT_NOMEM, 0, hdr->epoch, 0, NULL, 0));
+
+	s->epoch = hdr->epoch;
+	s->nregions = hdr->region;
+	memcpy(s->size, msgbuf + sizeof(struct ckpt_msghdr), len);
+
+	/* Incremental checkpoints patch the previous snapshot. */
+	if ((hdr->status != CKPT_FULL) &&
+		((base->epoch == 0) || (base->epoch != hdr->arg) || (base->nregions != s->nregions) ||
+		 (memcmp(base->size, s->size, len) != 0)))
+		status = CKPT_NEEDFULL;
+
+	for (int i = 0; i < s->nregions; i++)
+	{
+		if ((s->data[i] = malloc(s->size[i])) == NULL)
+		{
+			ckpt_free(s);
+			return (ckpt_xmit(src, CKPT_BEGIN_ACK, CKPT_NOMEM, 0, hdr->epoch, 0, NULL, 0));
+		}
+
+		if ((hdr->status != CKPT_FULL) && (status == CKPT_OK))
+			memcpy(s->data[i], base->data[i], s->size[i]);
+	}
+
+	return (ckpt_xmit(src, CKPT_BEGIN_ACK, status, 0, hdr->epoch, 0, NULL, 0));
+}
+
+/**
+ * @brief Commits a checkpoint.
+ */
+static int ckpt_serve_end(int src, const struct ckpt_msghdr *hdr)
+{
+	struct snapshot *s = &server.staging[src];
+
+	if ((s->epoch == 0) || (s->epoch != hdr->epoch) || (ckpt_image_sum(s) != hdr->arg))
+	{
+		ckpt_free(s);
+		return (ckpt_xmit(src, CKPT_END_ACK, CKPT_BADSUM, 0, hdr->epoch, 0, NULL, 0));
+	}
+
+	ckpt_free(&server.committed[src]);
+	server.committed[src] = *s;
+	server.committed[src].sum = hdr->arg;
+	memset(s, 0, sizeof(struct snapshot));
+
+	return (ckpt_xmit(src, CKPT_END_ACK, CKPT_OK, 0, hdr->epoch, 0, NULL, 0));
+}
+
+/**
+ * @brief Sends a snapshot back to its owner.
+ */
+static int ckpt_serve_restore(int src)
+{
+	struct snapshot *s = &server.committed[src];
+
+	if (s->epoch == 0)
+		return (ckpt_xmit(src, CKPT_BEGIN, CKPT_NOSNAP, 0, 0, 0, NULL, 0));
+
+	if (ckpt_xmit(src, CKPT_BEGIN, CKPT_OK, s->nregions, s->epoch, 0,
+			s->size, s->nregions*sizeof(uint32_t)) < 0)
+		return (-1);
+
+	for (int i = 0; i < s->nregions; i++)
+	{
+		for (size_t off = 0; off < s->size[i]; off += CKPT_RUN*CKPT_CHUNK)
+		{
+			size_t n = (s->size[i] - off < CKPT_RUN*CKPT_CHUNK) ? s->size[i] - off : CKPT_RUN*CKPT_CHUNK;
+
+			if (ckpt_xmit(src, CKPT_DATA, 0, i, s->epoch, off, s->data[i] + off, n) < 0)
+				return (-1);
+		}
+	}
+
+	return (ckpt_xmit(src, CKPT_END, CKPT_OK, 0, s->epoch, s->sum, NULL, 0));
+}
+
+/**
+ * @brief Serves checkpoints of other tiles.
+ *
+ * @details Keeps the last committed snapshot of every client in memory,
+ * plus the one being received. Returns when a client calls
+ * ckpt_stop().
+ *
+ * @returns Zero upon success and -1 otherwise.
+ */
+int ckpt_serve(void)
+{
+	int src;
+	ssize_t len;
+	struct ckpt_msghdr hdr;
+
+	while ((len = ckpt_recv(&src, &hdr)) >= 0)
+	{
+		int ret = 0;
+		struct snapshot *s = &server.staging[src];
+
+		switch (hdr.type)
+		{
+			case CKPT_BEGIN:
+				ret = ckpt_serve_begin(src, &hdr, len);
+				break;
+
+			case CKPT_DATA:
+				if ((s->epoch == hdr.epoch) && (hdr.region < s->nregions) &&
+					(hdr.arg <= s->size[hdr.region]) && ((size_t) len <= s->size[hdr.region] - hdr.arg))
+					memcpy(s->data[hdr.region] + hdr.arg, msgbuf + sizeof(struct ckpt_msghdr), len);
+				break;
+
+			case CKPT_END:
+				ret = ckpt_serve_end(src, &hdr);
+				break;
+
+			case CKPT_RESTORE:
+				ret = ckpt_serve_restore(src);
+				break;
+
+			case CKPT_STOP:
+				return (0);
+		}
+
+		if (ret < 0)
+			return (-1);
+	}
+
+	return (-1);
+}
+
+/**
+ * @brief Stops the checkpoint server of a tile.
+ *
+ * @details Snapshots stay in memory, and a later ckpt_serve() in the
+ * same process serves them again.
+ */
+int ckpt_stop(int peer)
+{
+	return (ckpt_xmit(peer, CKPT_STOP, 0, 0, 0, 0, NULL, 0));
+}
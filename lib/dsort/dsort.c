@@ -0,0 +1,451 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <dsort.h>
+#include <noc.h>
+
+/**
+ * @name Message types.
+ */
+/**@{*/
+#define DSORT_MSG_SAMPLES 0 /**< Regular samples of a tile.  */
+#define DSORT_MSG_RUN     1 /**< Chunk of a partition.       */
+/**@}*/
+
+/**
+ * @brief Message header.
+ */
+struct dsort_msghdr
+{
+	uint8_t type;   /**< Message type.                    */
+	uint8_t round;  /**< Sort invocation.                 */
+	uint16_t unused;/**< Padding.                         */
+	uint32_t total; /**< Total keys in the run or sample. */
+};
+
+/**
+ * @brief Keys per message.
+ */
+#define DSORT_CHUNK ((NOC_MSG_MAX - sizeof(struct dsort_msghdr))/sizeof(uint32_t))
+
+/**
+ * @brief Message kept for a later round.
+ */
+struct msg
+{
+	struct msg *next; /**< Next message.   */
+	int src;          /**< Source tile.    */
+	size_t len;       /**< Message length. */
+	uint8_t data[];   /**< Message data.   */
+};
+
+/**
+ * @brief Keys received from one tile.
+ */
+struct incoming
+{
+	uint32_t *keys;  /**< Keys.                 */
+	size_t total;    /**< Expected keys.        */
+	size_t received; /**< Received keys.        */
+	int started;     /**< First chunk arrived?  */
+};
+
+/**
+ * @brief Distributed sort state.
+ */
+static struct
+{
+	uint8_t round;                          /**< Current round.     */
+	int nprocs;                             /**< Number of tiles.   */
+	struct incoming samples[NOC_MAX_TILES]; /**< Samples.           */
+	struct incoming runs[NOC_MAX_TILES];    /**< Partitions.        */
+	int nsamples;                           /**< Sample sets done.  */
+	int nruns;                              /**< Partitions done.   */
+	struct msg *stash;                      /**< Next round.        */
+	struct dsort_stats *stats;              /**< Statistics.        */
+} ds;
+
+/**
+ * @brief Message buffer.
+ */
+static uint8_t msgbuf[NOC_MSG_MAX];
+
+/**
+ * @brief Returns the current time in nanoseconds.
+ */
+static uint64_t dsort_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((uint64_t) ts.tv_sec*1000000000ULL + ts.tv_nsec);
+}
+
+/**
+ * @brief Sorts keys locally (LSD radix sort, 8 bits per pass).
+ *
+ * @param keys Keys to sort.
+ * @param tmp  Scratch buffer as large as @p keys.
+ * @param n    Number of keys.
+ */
+void dsort_local(uint32_t *keys, uint32_t *tmp, size_t n)
+{
+	size_t count[256];
+
+	for (int shift = 0; shift < 32; shift += 8)
+	{
+		size_t sum = 0;
+
+		memset(count, 0, sizeof(count));
+		for (size_t i = 0; i < n; i++)
+			count[(keys[i] >> shift) & 0xff]++;
+
+		for (int d = 0; d < 256; d++)
+		{
+			size_t c = count[d];
+			count[d] = sum;
+			sum += c;
+		}
+
+		for (size_t i = 0; i < n; i++)
+			tmp[count[(keys[i] >> shift) & 0xff]++] = keys[i];
+
+		/* Ping-pong buffers; four passes land back in keys. */
+		uint32_t *swap = keys;
+		keys = tmp;
+		tmp = swap;
+	}
+}
+
+/**
+ * @brief Sends keys to a tile, split into messages.
+ */
+static int dsort_xmit(int dest, int type, const uint32_t *keys, size_t n)
+{
+	size_t off = 0;
+	struct dsort_msghdr hdr = { type, ds.round, 0, n };
+
+	memcpy(msgbuf, &hdr, sizeof(struct dsort_msghdr));
+
+	do
+	{
+		size_t len = (n - off < DSORT_CHUNK) ? n - off : DSORT_CHUNK;
+		size_t nbytes = sizeof(struct dsort_msghdr) + len*sizeof(uint32_t);
+
+		memcpy(msgbuf + sizeof(struct dsort_msghdr), keys + off, len*sizeof(uint32_t));
+		if (noc_send(dest, NOC_PORT_SORT, msgbuf, nbytes) < 0)
+			return (-1);
+
+		ds.stats->msgs_sent++;
+		ds.stats->bytes_sent += nbytes;
+		off += len;
+	} while (off < n);
+
+	return (0);
+}
+
+/**
+ * @brief Handles a message of the current round.
+ */
+static int dsort_dispatch(int src, const uint8_t *data, size_t len)
+{
+	size_t n;
+	struct msg *m;
+	struct incoming *in;
+	struct dsort_msghdr hdr;
+
+	if (len < sizeof(struct dsort_msghdr))
+		return (0);
+
+	memcpy(&hdr, data, sizeof(struct dsort_msghdr));
+
+	/* A peer has moved on to the next sort. */
+	if (hdr.round != ds.round)
+	{
+		struct msg **tail = &ds.stash;
+
+		if ((m = malloc(sizeof(struct msg) + len)) == NULL)
+			return (-1);
+		m->next = NULL;
+		m->src = src;
+		m->len = len;
+		memcpy(m->data, data, len);
+
+		/* Chunks must be replayed in arrival order. */
+		while (*tail != NULL)
+			tail = &(*tail)->next;
+		*tail = m;
+
+		return (0);
+	}
+
+	in = (hdr.type == DSORT_MSG_SAMPLES) ? &ds.samples[src] : &ds.runs[src];
+
+	if (!in->started)
+	{
+		in->started = 1;
+		in->total = hdr.total;
+		in->received = 0;
+		if ((in->keys = malloc((hdr.total + 1)*sizeof(uint32_t))) == NULL)
+			return (-1);
+	}
+
+	n = (len - sizeof(struct dsort_msghdr))/sizeof(uint32_t);
+	if (n > in->total - in->received)
+		n = in->total - in->received;
+	memcpy(in->keys + in->received, data + sizeof(struct dsort_msghdr), n*sizeof(uint32_t));
+	in->received += n;
+
+	if (in->received == in->total)
+	{
+		if (hdr.type == DSORT_MSG_SAMPLES)
+			ds.nsamples++;
+		else
+			ds.nruns++;
+	}
+
+	return (0);
+}
+
+/**
+ * @brief Receives and handles one message.
+ *
+ * @param block Wait for a message?
+ */
+static int dsort_receive(int block)
+{
+	int src, port;
+	ssize_t len;
+
+	if ((!block) && (noc_poll(0) <= 0))
+		return (0);
+
+	if ((len = noc_recv(&src, &port, msgbuf, sizeof(msgbuf))) < 0)
+		return (-1);
+
+	if (port != NOC_PORT_SORT)
+		return (0);
+
+	return (dsort_dispatch(src, msgbuf, len));
+}
+
+/**
+ * @brief Compares two keys.
+ */
+static int dsort_cmp(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *) a;
+	uint32_t y = *(const uint32_t *) b;
+
+	return ((x > y) - (x < y));
+}
+
+/**
+ * @brief Returns the number of keys not greater than a splitter.
+ */
+static size_t upper_bound(const uint32_t *keys, size_t n, uint32_t splitter)
+{
+	size_t lo = 0, hi = n;
+
+	while (lo < hi)
+	{
+		size_t mid = lo + (hi - lo)/2;
+
+		if (keys[mid] <= splitter)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return (lo);
+}
+
+/**
+ * @brief Releases the buffers of a round.
+ */
+static void dsort_cleanup(void)
+{
+	for (int i = 0; i < NOC_MAX_TILES; i++)
+	{
+		free(ds.samples[i].keys);
+		free(ds.runs[i].keys);
+	}
+	memset(ds.samples, 0, sizeof(ds.samples));
+	memset(ds.runs, 0, sizeof(ds.runs));
+}
+
+/**
+ * @brief Sorts keys across all tiles (sample sort).
+ *
+ * @details All tiles call this function collectively. Each tile sorts
+ * its keys, and all tiles exchange regular samples so they can pick the
+ * same splitters without a separate broadcast. Tile i then receives the
+ * keys between splitters i-1 and i from every tile, as sorted runs, and
+ * merges them with a loser tree. Concatenating the outputs of tiles
+ * 0, 1, ... yields the global order.
+ *
+ * @param keys  Local keys.
+ * @param n     Number of local keys.
+ * @param out   Store location for the local partition (malloc'ed).
+ * @param nout  Store location for the size of the partition.
+ * @param stats Store location for statistics (optional).
+ *
+ * @returns Zero upon success and -1 otherwise.
+ */
+int dsort(const uint32_t *keys, size_t n, uint32_t **out, size_t *nout, struct dsort_stats *stats)
+{
+	int p;
+	int pid;
+	uint64_t t0, t1;
+	size_t nsamples;
+	struct msg *m, *stash;
+	struct dsort_stats dummy;
+	uint32_t *local = NULL, *tmp = NULL, *all = NULL;
+	uint32_t splitters[NOC_MAX_TILES];
+	uint32_t samples[DSORT_OVERSAMPLING];
+	size_t bounds[NOC_MAX_TILES + 1];
+	const uint32_t *runs[NOC_MAX_TILES];
+	size_t lens[NOC_MAX_TILES];
+	size_t total;
+
+	ds.stats = (stats != NULL) ? stats : &dummy;
+	memset(ds.stats, 0, sizeof(struct dsort_stats));
+	ds.nprocs = p = noc_ntiles();
+	ds.nsamples = 0;
+	ds.nruns = 0;
+	pid = noc_tile();
+
+	/* Messages that arrived early for this round. */
+	stash = ds.stash;
+	ds.stash = NULL;
+	while ((m = stash) != NULL)
+	{
+		int ret;
+
+		stash = m->next;
+		ret = dsort_dispatch(m->src, m->data, m->len);
+		free(m);
+		if (ret < 0)
+			goto error;
+	}
+
+	/* Local sort. */
+	t0 = dsort_now();
+	local = malloc((n + 1)*sizeof(uint32_t));
+	tmp = malloc((n + 1)*sizeof(uint32_t));
+	if ((local == NULL) || (tmp == NULL))
+		goto error;
+	memcpy(local, keys, n*sizeof(uint32_t));
+	dsort_local(local, tmp, n);
+	free(tmp);
+	tmp = NULL;
+	t1 = dsort_now();
+	ds.stats->sort_time = t1 - t0;
+
+	/* Regular samples (bucket midpoints) to everyone. */
+	nsamples = (n > 0) ? DSORT_OVERSAMPLING : 0;
+	for (size_t i = 0; i < nsamples; i++)
+		samples[i] = local[((2*i + 1)*n)/(2*nsamples)];
+	for (int i = 0; i < p; i++)
+	{
+		if (dsort_xmit((pid + i) % p, DSORT_MSG_SAMPLES, samples, nsamples) < 0)
+			goto error;
+	}
+	while (ds.nsamples < p)
+	{
+		if (dsort_receive(1) < 0)
+			goto error;
+	}
+
+	/* Same splitters everywhere. */
+	total = 0;
+	for (int i = 0; i < p; i++)
+		total += ds.samples[i].total;
+	if ((all = malloc((total + 1)*sizeof(uint32_t))) == NULL)
+		goto error;
+	total = 0;
+	for (int i = 0; i < p; i++)
+	{
+		memcpy(all + total, ds.samples[i].keys, ds.samples[i].total*sizeof(uint32_t));
+		total += ds.samples[i].total;
+	}
+	qsort(all, total, sizeof(uint32_t), dsort_cmp);
+	for (int i = 1; i < p; i++)
+		splitters[i - 1] = (total > 0) ? all[i*total/p] : 0;
+	free(all);
+	all = NULL;
+
+	bounds[0] = 0;
+	for (int i = 1; i < p; i++)
+		bounds[i] = upper_bound(local, n, splitters[i - 1]);
+	bounds[p] = n;
+	t0 = dsort_now();
+	ds.stats->sample_time = t0 - t1;
+
+	/* Exchange partitions, staggered to spread the load. */
+	for (int i = 0; i < p; i++)
+	{
+		int dest = (pid + i) % p;
+
+		if (dsort_xmit(dest, DSORT_MSG_RUN, local + bounds[dest], bounds[dest + 1] - bounds[dest]) < 0)
+			goto error;
+		if (dsort_receive(0) < 0)
+			goto error;
+	}
+	while (ds.nruns < p)
+	{
+		if (dsort_receive(1) < 0)
+			goto error;
+	}
+	free(local);
+	local = NULL;
+	t1 = dsort_now();
+	ds.stats->exchange_time = t1 - t0;
+
+	/* Multiway merge. */
+	total = 0;
+	for (int i = 0; i < p; i++)
+	{
+		runs[i] = ds.runs[i].keys;
+		lens[i] = ds.runs[i].total;
+		total += lens[i];
+	}
+	if ((*out = malloc((total + 1)*sizeof(uint32_t))) == NULL)
+		goto error;
+	dsort_merge(runs, lens, p, *out);
+	*nout = total;
+	ds.stats->merge_time = dsort_now() - t1;
+
+	dsort_cleanup();
+	ds.round++;
+
+	return (0);
+
+error:
+	free(all);
+	free(tmp);
+	free(local);
+	dsort_cleanup();
+	ds.round++;
+	return (-1);
+}
@@ -0,0 +1,137 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <dsort.h>
+
+/**
+ * @brief Maximum number of runs merged at once.
+ */
+#define LT_MAX_RUNS 64
+
+/**
+ * @brief Loser tree.
+ */
+struct losertree
+{
+	const uint32_t *const *runs; /**< Runs.                       */
+	const size_t *lens;          /**< Run lengths.                */
+	size_t pos[LT_MAX_RUNS];     /**< Read position in each run.  */
+	int loser[LT_MAX_RUNS];      /**< Loser of each inner node.   */
+	int k;                       /**< Number of runs.             */
+	int size;                    /**< Leaves (power of two).      */
+};
+
+/**
+ * @brief Asserts if run a currently beats run b.
+ *
+ * @details Exhausted (or padding, -1) runs lose against everything, and
+ * ties go to the lower run, so the merge is stable.
+ */
+static inline int lt_beats(const struct losertree *t, int a, int b)
+{
+	if ((a < 0) || (t->pos[a] == t->lens[a]))
+		return (0);
+	if ((b < 0) || (t->pos[b] == t->lens[b]))
+		return (1);
+
+	uint32_t x = t->runs[a][t->pos[a]];
+	uint32_t y = t->runs[b][t->pos[b]];
+
+	return ((x < y) || ((x == y) && (a < b)));
+}
+
+/**
+ * @brief Merges sorted runs.
+ *
+ * @details Uses a tournament tree of losers: after the winner is
+ * output, only the path from its leaf to the root is replayed, so each
+ * element costs log2(k) comparisons.
+ *
+ * @param runs Sorted runs.
+ * @param lens Run lengths.
+ * @param k    Number of runs (at most 64).
+ * @param out  Output buffer, large enough for all elements.
+ */
+void dsort_merge(const uint32_t *const *runs, const size_t *lens, int k, uint32_t *out)
+{
+	int winner;
+	size_t total = 0;
+	struct losertree t;
+	int win[2*LT_MAX_RUNS];
+
+	if ((k < 1) || (k > LT_MAX_RUNS))
+		return;
+
+	t.runs = runs;
+	t.lens = lens;
+	t.k = k;
+	for (t.size = 1; t.size < k; t.size *= 2)
+		/* noop */;
+
+	for (int i = 0; i < k; i++)
+	{
+		t.pos[i] = 0;
+		total += lens[i];
+	}
+
+	/* Build tree bottom-up. */
+	for (int i = 0; i < t.size; i++)
+		win[t.size + i] = (i < k) ? i : -1;
+	for (int n = t.size - 1; n >= 1; n--)
+	{
+		int l = win[2*n];
+		int r = win[2*n + 1];
+
+		if (lt_beats(&t, l, r))
+		{
+			win[n] = l;
+			t.loser[n] = r;
+		}
+		else
+		{
+			win[n] = r;
+			t.loser[n] = l;
+		}
+	}
+	winner = win[1];
+
+	/* Single run. */
+	if (t.size == 1)
+	{
+		memcpy(out, runs[0], lens[0]*sizeof(uint32_t));
+		return;
+	}
+
+	for (size_t i = 0; i < total; i++)
+	{
+		*out++ = runs[winner][t.pos[winner]++];
+
+		/* Replay matches on the path to the root. */
+		for (int n = (t.size + winner)/2; n >= 1; n /= 2)
+		{
+			if (lt_beats(&t, t.loser[n], winner))
+			{
+				int tmp = t.loser[n];
+				t.loser[n] = winner;
+				winner = tmp;
+			}
+		}
+	}
+}
@@ -0,0 +1,197 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gemm.h>
+
+/**
+ * @name Cache blocking factors.
+ *
+ * @details Sized so that a packed block of A (MB x KB), a packed block
+ * of B (KB x NB) and the C tile fit together in an 8 KB data cache.
+ */
+/**@{*/
+#define GEMM_MB 16
+#define GEMM_NB 16
+#define GEMM_KB 48
+/**@}*/
+
+/**
+ * @brief Packed block of A (row-major).
+ */
+static q16_t apack[GEMM_MB*GEMM_KB];
+
+/**
+ * @brief Packed block of B (column-major).
+ */
+static q16_t bpack[GEMM_NB*GEMM_KB];
+
+/**
+ * @brief Rounds a Q32.32 accumulator to Q16.16.
+ */
+static inline q16_t q16_round(int64_t acc)
+{
+	return ((q16_t)((acc + (1 << (Q16_SHIFT - 1))) >> Q16_SHIFT));
+}
+
+/**
+ * @brief Reference GEMM: C += A*B.
+ *
+ * @param m   Rows of A and C.
+ * @param n   Columns of B and C.
+ * @param k   Columns of A and rows of B.
+ * @param A   Matrix A (row-major).
+ * @param lda Leading dimension of A.
+ * @param B   Matrix B (row-major).
+ * @param ldb Leading dimension of B.
+ * @param C   Matrix C (row-major).
+ * @param ldc Leading dimension of C.
+ */
+void gemm_q16_naive(
+	int m, int n, int k,
+	const q16_t *A, int lda,
+	const q16_t *B, int ldb,
+	q16_t *C, int ldc)
+{
+	for (int i = 0; i < m; i++)
+	{
+		for (int j = 0; j < n; j++)
+		{
+			int64_t acc = 0;
+
+			for (int p = 0; p < k; p++)
+				acc += (int64_t) A[i*lda + p]*B[p*ldb + j];
+
+			C[i*ldc + j] += q16_round(acc);
+		}
+	}
+}
+
+/**
+ * @brief Multiplies packed blocks.
+ *
+ * @details Works on 2x2 tiles of C so that every element loaded from the
+ * packed blocks is used twice, with exact 64-bit accumulation and a
+ * single rounding per block.
+ */
+static void gemm_kernel(int mb, int nb, int kb, q16_t *C, int ldc)
+{
+	int i, j;
+
+	for (i = 0; i + 1 < mb; i += 2)
+	{
+		const q16_t *a0 = &apack[i*kb];
+		const q16_t *a1 = a0 + kb;
+
+		for (j = 0; j + 1 < nb; j += 2)
+		{
+			const q16_t *b0 = &bpack[j*kb];
+			const q16_t *b1 = b0 + kb;
+			int64_t c00 = 0, c01 = 0, c10 = 0, c11 = 0;
+
+			for (int p = 0; p < kb; p++)
+			{
+				c00 += (int64_t) a0[p]*b0[p];
+				c01 += (int64_t) a0[p]*b1[p];
+				c10 += (int64_t) a1[p]*b0[p];
+				c11 += (int64_t) a1[p]*b1[p];
+			}
+
+			C[i*ldc + j] += q16_round(c00);
+			C[i*ldc + j + 1] += q16_round(c01);
+			C[(i + 1)*ldc + j] += q16_round(c10);
+			C[(i + 1)*ldc + j + 1] += q16_round(c11);
+		}
+
+		/* Odd column. */
+		if (j < nb)
+		{
+			const q16_t *b0 = &bpack[j*kb];
+			int64_t c00 = 0, c10 = 0;
+
+			for (int p = 0; p < kb; p++)
+			{
+				c00 += (int64_t) a0[p]*b0[p];
+				c10 += (int64_t) a1[p]*b0[p];
+			}
+
+			C[i*ldc + j] += q16_round(c00);
+			C[(i + 1)*ldc + j] += q16_round(c10);
+		}
+	}
+
+	/* Odd row. */
+	if (i < mb)
+	{
+		const q16_t *a0 = &apack[i*kb];
+
+		for (j = 0; j < nb; j++)
+		{
+			const q16_t *b0 = &bpack[j*kb];
+			int64_t c00 = 0;
+
+			for (int p = 0; p < kb; p++)
+				c00 += (int64_t) a0[p]*b0[p];
+
+			C[i*ldc + j] += q16_round(c00);
+		}
+	}
+}
+
+/**
+ * @brief Cache-blocked GEMM: C += A*B.
+ *
+ * @details Same interface as gemm_q16_naive(). Blocks of A and B are
+ * copied into contiguous buffers so that the inner loops run at unit
+ * stride. Not reentrant.
+ */
+void gemm_q16(
+	int m, int n, int k,
+	const q16_t *A, int lda,
+	const q16_t *B, int ldb,
+	q16_t *C, int ldc)
+{
+	for (int jj = 0; jj < n; jj += GEMM_NB)
+	{
+		int nb = (n - jj < GEMM_NB) ? n - jj : GEMM_NB;
+
+		for (int kk = 0; kk < k; kk += GEMM_KB)
+		{
+			int kb = (k - kk < GEMM_KB) ? k - kk : GEMM_KB;
+
+			/* Pack B block column by column. */
+			for (int j = 0; j < nb; j++)
+			{
+				for (int p = 0; p < kb; p++)
+					bpack[j*kb + p] = B[(kk + p)*ldb + jj + j];
+			}
+
+			for (int ii = 0; ii < m; ii += GEMM_MB)
+			{
+				int mb = (m - ii < GEMM_MB) ? m - ii : GEMM_MB;
+
+				/* Pack A block row by row. */
+				for (int i = 0; i < mb; i++)
+				{
+					for (int p = 0; p < kb; p++)
+						apack[i*kb + p] = A[(ii + i)*lda + kk + p];
+				}
+
+				gemm_kernel(mb, nb, kb, &C[ii*ldc + jj], ldc);
+			}
+		}
+	}
+}
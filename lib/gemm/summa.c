@@ -0,0 +1,315 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <gemm.h>
+#include <noc.h>
+
+/**
+ * @name Panel types.
+ */
+/**@{*/
+#define SUMMA_PANEL_A 0 /**< Block of A, broadcast along a row.    */
+#define SUMMA_PANEL_B 1 /**< Block of B, broadcast down a column.  */
+/**@}*/
+
+/**
+ * @brief Message header.
+ */
+struct summa_msghdr
+{
+	uint8_t type;    /**< Panel type.                */
+	uint8_t step;    /**< SUMMA step.                */
+	uint16_t epoch;  /**< Call, modulo 2^16.         */
+	uint32_t offset; /**< Offset in the block (bytes). */
+};
+
+/**
+ * @brief Payload per message (in bytes).
+ */
+#define SUMMA_CHUNK ((NOC_MSG_MAX - sizeof(struct summa_msghdr)) & ~3u)
+
+/**
+ * @brief Message kept for a later step or call.
+ */
+struct msg
+{
+	struct msg *next; /**< Next message.   */
+	size_t len;       /**< Message length. */
+	uint8_t data[];   /**< Message data.   */
+};
+
+/**
+ * @brief SUMMA state.
+ */
+static struct
+{
+	uint16_t epoch;      /**< Current call.                 */
+	int step;            /**< Current step.                 */
+	size_t size;         /**< Block size (bytes).           */
+	q16_t *panel[2];     /**< Received A and B blocks.      */
+	size_t got[2];       /**< Bytes received of each block. */
+	struct msg *stash;   /**< Messages of later steps and calls. */
+	struct summa_stats *stats; /**< Statistics.             */
+} summa;
+
+/**
+ * @brief Message buffer.
+ */
+static uint8_t msgbuf[NOC_MSG_MAX];
+
+/**
+ * @brief Returns the current time in nanoseconds.
+ */
+static uint64_t summa_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((uint64_t) ts.tv_sec*1000000000ULL + ts.tv_nsec);
+}
+
+/**
+ * @brief Returns the side of the process grid.
+ *
+ * @details The grid is the largest square that fits in the SoC. Tile t
+ * sits at row t / q and column t % q; tiles beyond q*q do not take
+ * part.
+ */
+int summa_grid(void)
+{
+	int q;
+
+	for (q = 1; (q + 1)*(q + 1) <= noc_ntiles(); q++)
+		/* noop */;
+
+	return (q);
+}
+
+/**
+ * @brief Sends a block to a tile.
+ */
+static int summa_xmit(int dest, int type, const q16_t *block)
+{
+	size_t off = 0;
+	struct summa_msghdr hdr = { type, summa.step, summa.epoch, 0 };
+
+	do
+	{
+		size_t n = (summa.size - off < SUMMA_CHUNK) ? summa.size - off : SUMMA_CHUNK;
+
+		hdr.offset = off;
+		memcpy(msgbuf, &hdr, sizeof(struct summa_msghdr));
+		memcpy(msgbuf + sizeof(struct summa_msghdr), (const uint8_t *) block + off, n);
+
+		if (noc_send(dest, NOC_PORT_GEMM, msgbuf, sizeof(struct summa_msghdr) + n) < 0)
+			return (-1);
+
+		summa.stats->bytes_sent += sizeof(struct summa_msghdr) + n;
+		off += n;
+	} while (off < summa.size);
+
+	return (0);
+}
+
+/**
+ * @brief Tells whether a panel message belongs to the current step.
+ */
+static int summa_current(const struct summa_msghdr *hdr)
+{
+	return ((hdr->epoch == summa.epoch) && (hdr->step == (uint8_t) summa.step));
+}
+
+/**
+ * @brief Handles a panel message.
+ */
+static int summa_dispatch(const uint8_t *data, size_t len)
+{
+	size_t n;
+	struct summa_msghdr hdr;
+
+	if (len < sizeof(struct summa_msghdr))
+		return (0);
+
+	memcpy(&hdr, data, sizeof(struct summa_msghdr));
+
+	/*
+	 * Early panel of a later step, or of the next call, which a tile
+	 * that is done with this one may already have started.
+	 */
+	if (!summa_current(&hdr))
+	{
+		struct msg *m, **tail = &summa.stash;
+
+		if ((m = malloc(sizeof(struct msg) + len)) == NULL)
+			return (-1);
+		m->next = NULL;
+		m->len = len;
+		memcpy(m->data, data, len);
+		while (*tail != NULL)
+			tail = &(*tail)->next;
+		*tail = m;
+
+		return (0);
+	}
+
+	if ((hdr.type > SUMMA_PANEL_B) || (hdr.offset >= summa.size))
+		return (0);
+
+	n = len - sizeof(struct summa_msghdr);
+	if (n > summa.size - hdr.offset)
+		n = summa.size - hdr.offset;
+	memcpy((uint8_t *) summa.panel[hdr.type] + hdr.offset, data + sizeof(struct summa_msghdr), n);
+	summa.got[hdr.type] += n;
+
+	return (0);
+}
+
+/**
+ * @brief Waits until the panels of the current step are complete.
+ */
+static int summa_wait(int needa, int needb)
+{
+	int port;
+	ssize_t len;
+	struct msg *m, **pm;
+	struct summa_msghdr hdr;
+
+	/* Panels that came in early. */
+	pm = &summa.stash;
+	while ((m = *pm) != NULL)
+	{
+		memcpy(&hdr, m->data, sizeof(struct summa_msghdr));
+		if (!summa_current(&hdr))
+		{
+			pm = &m->next;
+			continue;
+		}
+
+		*pm = m->next;
+		summa_dispatch(m->data, m->len);
+		free(m);
+	}
+
+	while ((needa && (summa.got[SUMMA_PANEL_A] < summa.size)) ||
+		   (needb && (summa.got[SUMMA_PANEL_B] < summa.size)))
+	{
+		if ((len = noc_recv(NULL, &port, msgbuf, sizeof(msgbuf))) < 0)
+			return (-1);
+
+		if (port != NOC_PORT_GEMM)
+			continue;
+
+		if (summa_dispatch(msgbuf, len) < 0)
+			return (-1);
+	}
+
+	return (0);
+}
+
+/**
+ * @brief Distributed GEMM (SUMMA): C += A*B.
+ *
+ * @details All tiles call this function collectively. On a q x q grid,
+ * tile (i,j) holds blocks A(i,j), B(i,j) and C(i,j), all nb x nb and
+ * row-major. At step k, tile (i,k) sends A(i,k) along row i, tile (k,j)
+ * sends B(k,j) down column j, and every tile accumulates
+ * A(i,k)*B(k,j) into its block of C with the cache-blocked kernel.
+ *
+ * @param nb    Side of the local blocks.
+ * @param A     Local block of A.
+ * @param B     Local block of B.
+ * @param C     Local block of C.
+ * @param stats Store location for statistics (optional).
+ *
+ * @returns Zero upon success and -1 otherwise.
+ */
+int summa_q16(int nb, const q16_t *A, const q16_t *B, q16_t *C, struct summa_stats *stats)
+{
+	int q, row, col;
+	int ret = -1;
+	uint64_t t0;
+	struct summa_stats dummy;
+
+	summa.stats = (stats != NULL) ? stats : &dummy;
+	memset(summa.stats, 0, sizeof(struct summa_stats));
+
+	q = summa_grid();
+	if (noc_tile() >= q*q)
+		return (0);
+	row = noc_tile()/q;
+	col = noc_tile()%q;
+	summa.epoch++;
+
+	if (nb < 1)
+	{
+		errno = EINVAL;
+		return (-1);
+	}
+
+	summa.size = (size_t) nb*nb*sizeof(q16_t);
+	summa.panel[SUMMA_PANEL_A] = malloc(summa.size);
+	summa.panel[SUMMA_PANEL_B] = malloc(summa.size);
+	if ((summa.panel[SUMMA_PANEL_A] == NULL) || (summa.panel[SUMMA_PANEL_B] == NULL))
+		goto out;
+
+	for (summa.step = 0; summa.step < q; summa.step++)
+	{
+		int k = summa.step;
+		const q16_t *a = A, *b = B;
+
+		summa.got[SUMMA_PANEL_A] = 0;
+		summa.got[SUMMA_PANEL_B] = 0;
+
+		/* Broadcast own blocks, starting with the nearest peers. */
+		for (int d = 1; d < q; d++)
+		{
+			if ((col == k) && (summa_xmit(row*q + (col + d) % q, SUMMA_PANEL_A, A) < 0))
+				goto out;
+			if ((row == k) && (summa_xmit(((row + d) % q)*q + col, SUMMA_PANEL_B, B) < 0))
+				goto out;
+		}
+
+		t0 = summa_now();
+		if (summa_wait(col != k, row != k) < 0)
+			goto out;
+		summa.stats->comm_time += summa_now() - t0;
+
+		if (col != k)
+			a = summa.panel[SUMMA_PANEL_A];
+		if (row != k)
+			b = summa.panel[SUMMA_PANEL_B];
+
+		t0 = summa_now();
+		gemm_q16(nb, nb, nb, a, nb, b, nb, C, nb);
+		summa.stats->compute_time += summa_now() - t0;
+	}
+
+	ret = 0;
+
+out:
+	free(summa.panel[SUMMA_PANEL_A]);
+	free(summa.panel[SUMMA_PANEL_B]);
+	summa.panel[SUMMA_PANEL_A] = NULL;
+	summa.panel[SUMMA_PANEL_B] = NULL;
+	return (ret);
+}
@@ -0,0 +1,701 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <mapreduce.h>
+#include <noc.h>
+
+/**
+ * @brief Size of a shuffle message (in bytes).
+ */
+#define MR_MSG_SIZE 4096
+
+/**
+ * @name Shuffle message types.
+ */
+/**@{*/
+#define MR_MSG_PAIRS 0 /**< Intermediate pairs.  */
+#define MR_MSG_EOS   1 /**< End of stream.       */
+/**@}*/
+
+/**
+ * @brief Shuffle message header.
+ */
+struct mr_msghdr
+{
+	uint8_t type; /**< Message type.           */
+	uint8_t job;  /**< Job, modulo 2^8.        */
+};
+
+/**
+ * @brief Number of slots in the map-side combine table.
+ */
+#define MR_COMBINE_SLOTS 1024
+
+/**
+ * @brief Initial number of slots in the reduce-side table.
+ */
+#define MR_REDUCE_SLOTS 1024
+
+/**
+ * @brief Maximum size of a serialized pair.
+ */
+#define MR_PAIR_MAX (1 + MR_KEY_MAX + sizeof(mr_value_t))
+
+/**
+ * @brief Combine table entry.
+ */
+struct centry
+{
+	uint32_t hash;              /**< Key hash (zero if free). */
+	uint8_t klen;               /**< Key length.              */
+	uint8_t key[MR_KEY_MAX];    /**< Key.                     */
+	mr_value_t value;           /**< Combined value.          */
+};
+
+/**
+ * @brief Reduce table entry.
+ */
+struct rentry
+{
+	uint32_t hash;           /**< Key hash (zero if free). */
+	uint8_t klen;            /**< Key length.              */
+	uint8_t *key;            /**< Key.                     */
+	mr_value_t *vals;        /**< Values.                  */
+	size_t nvals;            /**< Number of values.        */
+	size_t cap;              /**< Capacity of values.      */
+};
+
+/**
+ * @brief Message kept for a later job.
+ */
+struct msg
+{
+	struct msg *next; /**< Next message.   */
+	size_t len;       /**< Message length. */
+	uint8_t data[];   /**< Message data.   */
+};
+
+/**
+ * @brief Per-destination send buffer.
+ */
+struct sendbuf
+{
+	size_t len;                /**< Bytes used. */
+	uint8_t data[MR_MSG_SIZE]; /**< Pairs.      */
+};
+
+/**
+ * @brief Map context.
+ */
+struct mr_context
+{
+	const struct mr_job *job;  /**< Running job.                 */
+	struct mr_stats *stats;    /**< Job statistics.              */
+	int ntiles;                /**< Number of tiles.             */
+	struct sendbuf *bufs;      /**< Send buffers (one per tile). */
+	struct centry *ctable;     /**< Combine table.               */
+	size_t cused;              /**< Used combine slots.          */
+	struct rentry *rtable;     /**< Reduce table.                */
+	size_t rslots;             /**< Reduce table size.           */
+	size_t rused;              /**< Used reduce slots.           */
+	int eos;                   /**< End-of-stream markers seen.  */
+	int error;                 /**< Sticky error flag.           */
+};
+
+/**
+ * @brief MapReduce state, across jobs.
+ *
+ * @details A tile that is done with a job may start the next one, and
+ * its shuffle messages reach tiles still in the previous job.
+ */
+static struct
+{
+	uint8_t job;       /**< Current job.           */
+	struct msg *stash; /**< Messages of later jobs. */
+} mr;
+
+/**
+ * @brief Returns the current time in nanoseconds.
+ */
+static uint64_t mr_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((uint64_t) ts.tv_sec*1000000000ULL + ts.tv_nsec);
+}
+
+/**
+ * @brief Hashes a key (FNV-1a). Never returns zero.
+ */
+static uint32_t mr_hash(const void *key, size_t klen)
+{
+	const uint8_t *p = key;
+	uint32_t h = 2166136261u;
+
+	for (size_t i = 0; i < klen; i++)
+	{
+		h ^= p[i];
+		h *= 16777619u;
+	}
+
+	return ((h != 0) ? h : 1);
+}
+
+/**
+ * @brief Default partitioner.
+ */
+int mr_partition_hash(const void *key, size_t klen, int ntiles)
+{
+	return (mr_hash(key, klen) % ntiles);
+}
+
+/*============================================================================*
+ * Reduce side                                                                *
+ *============================================================================*/
+
+/**
+ * @brief Finds the reduce table slot of a key.
+ */
+static struct rentry *rtable_slot(
+	struct rentry *table, size_t nslots, uint32_t hash,
+	const void *key, size_t klen)
+{
+	size_t i = hash & (nslots - 1);
+
+	while (table[i].hash != 0)
+	{
+		if ((table[i].hash == hash) && (table[i].klen == klen) &&
+			(memcmp(table[i].key, key, klen) == 0))
+			break;
+		i = (i + 1) & (nslots - 1);
+	}
+
+	return (&table[i]);
+}
+
+/**
+ * @brief Doubles the reduce table.
+ */
+static int rtable_grow(struct mr_context *ctx)
+{
+	size_t nslots = ctx->rslots*2;
+	struct rentry *table;
+
+	if ((table = calloc(nslots, sizeof(struct rentry))) == NULL)
+		return (-1);
+
+	for (size_t i = 0; i < ctx->rslots; i++)
+	{
+		struct rentry *e = &ctx->rtable[i];
+		if (e->hash != 0)
+			*rtable_slot(table, nslots, e->hash, e->key, e->klen) = *e;
+	}
+
+	free(ctx->rtable);
+	ctx->rtable = table;
+	ctx->rslots = nslots;
+
+	return (0);
+}
+
+/**
+ * @brief Adds a received pair to the reduce table.
+ */
+static int rtable_insert(
+	struct mr_context *ctx, const void *key, size_t klen, mr_value_t val)
+{
+	uint32_t hash;
+	struct rentry *e;
+
+	/* Keep load factor under 3/4. */
+	if (4*(ctx->rused + 1) > 3*ctx->rslots)
+	{
+		if (rtable_grow(ctx) < 0)
+			return (-1);
+	}
+
+	hash = mr_hash(key, klen);
+	e = rtable_slot(ctx->rtable, ctx->rslots, hash, key, klen);
+
+	/* New key. */
+	if (e->hash == 0)
+	{
+		if ((e->key = malloc(klen + 1)) == NULL)
+			return (-1);
+		if ((e->vals = malloc(sizeof(mr_value_t))) == NULL)
+		{
+			free(e->key);
+			return (-1);
+		}
+		memcpy(e->key, key, klen);
+		e->hash = hash;
+		e->klen = klen;
+		e->vals[0] = val;
+		e->nvals = 1;
+		e->cap = 1;
+		ctx->rused++;
+		return (0);
+	}
+
+	if (ctx->job->combine != NULL)
+	{
+		e->vals[0] = ctx->job->combine(e->vals[0], val);
+		return (0);
+	}
+
+	if (e->nvals == e->cap)
+	{
+		mr_value_t *vals;
+
+		if ((vals = realloc(e->vals, 2*e->cap*sizeof(mr_value_t))) == NULL)
+			return (-1);
+		e->vals = vals;
+		e->cap *= 2;
+	}
+	e->vals[e->nvals++] = val;
+
+	return (0);
+}
+
+/**
+ * @brief Handles a shuffle message.
+ */
+static void mr_handle(struct mr_context *ctx, const uint8_t *msg, size_t len)
+{
+	struct mr_msghdr hdr;
+
+	if (len < sizeof(struct mr_msghdr))
+	{
+		ctx->error = EPROTO;
+		return;
+	}
+
+	memcpy(&hdr, msg, sizeof(struct mr_msghdr));
+
+	/* A peer has moved on to the next job. */
+	if (hdr.job != mr.job)
+	{
+		struct msg *m, **tail = &mr.stash;
+
+		if ((m = malloc(sizeof(struct msg) + len)) == NULL)
+		{
+			ctx->error = ENOMEM;
+			return;
+		}
+		m->next = NULL;
+		m->len = len;
+		memcpy(m->data, msg, len);
+
+		/* End of stream must come after the pairs it closes. */
+		while (*tail != NULL)
+			tail = &(*tail)->next;
+		*tail = m;
+
+		return;
+	}
+
+	/* End of stream. */
+	if (hdr.type == MR_MSG_EOS)
+	{
+		ctx->eos++;
+		return;
+	}
+
+	msg += sizeof(struct mr_msghdr);
+	len -= sizeof(struct mr_msghdr);
+
+	while (len > 0)
+	{
+		mr_value_t val;
+		size_t klen = msg[0];
+
+		if (len < 1 + klen + sizeof(mr_value_t))
+		{
+			ctx->error = EPROTO;
+			return;
+		}
+
+		memcpy(&val, msg + 1 + klen, sizeof(mr_value_t));
+		if (rtable_insert(ctx, msg + 1, klen, val) < 0)
+			ctx->error = ENOMEM;
+		ctx->stats->received++;
+
+		msg += 1 + klen + sizeof(mr_value_t);
+		len -= 1 + klen + sizeof(mr_value_t);
+	}
+}
+
+/**
+ * @brief Receives one shuffle message.
+ */
+static int mr_receive(struct mr_context *ctx, uint8_t *buf)
+{
+	int port;
+	ssize_t len;
+
+	if ((len = noc_recv(NULL, &port, buf, MR_MSG_SIZE)) < 0)
+		return (-1);
+
+	/* Not for us. */
+	if ((port != NOC_PORT_MAPREDUCE) || (len > MR_MSG_SIZE))
+		return (0);
+
+	mr_handle(ctx, buf, len);
+
+	return (0);
+}
+
+/**
+ * @brief Receives all pending shuffle messages without blocking.
+ */
+static int mr_drain(struct mr_context *ctx)
+{
+	static uint8_t buf[MR_MSG_SIZE];
+
+	while (noc_poll(0) > 0)
+	{
+		if (mr_receive(ctx, buf) < 0)
+			return (-1);
+	}
+
+	return (0);
+}
+
+/*============================================================================*
+ * Map side                                                                   *
+ *============================================================================*/
+
+/**
+ * @brief Sends the contents of a send buffer.
+ */
+static int mr_flush(struct mr_context *ctx, int dest)
+{
+	struct sendbuf *b = &ctx->bufs[dest];
+
+	if (b->len == 0)
+		return (0);
+
+	if (noc_send(dest, NOC_PORT_MAPREDUCE, b->data, b->len) < 0)
+		return (-1);
+
+	ctx->stats->msgs_sent++;
+	ctx->stats->bytes_sent += b->len;
+	b->len = 0;
+
+	/* Keep the network flowing. */
+	return (mr_drain(ctx));
+}
+
+/**
+ * @brief Appends a pair to the send buffer of its reducer.
+ */
+static int mr_push(
+	struct mr_context *ctx, const void *key, size_t klen, mr_value_t val)
+{
+	int dest;
+	struct sendbuf *b;
+	struct mr_msghdr hdr = { MR_MSG_PAIRS, mr.job };
+
+	dest = (ctx->job->partition != NULL) ?
+		ctx->job->partition(key, klen, ctx->ntiles) :
+		mr_partition_hash(key, klen, ctx->ntiles);
+	b = &ctx->bufs[dest];
+
+	if (b->len + MR_PAIR_MAX > MR_MSG_SIZE)
+	{
+		if (mr_flush(ctx, dest) < 0)
+			return (-1);
+	}
+
+	if (b->len == 0)
+	{
+		memcpy(b->data, &hdr, sizeof(struct mr_msghdr));
+		b->len = sizeof(struct mr_msghdr);
+	}
+
+	b->data[b->len] = klen;
+	memcpy(&b->data[b->len + 1], key, klen);
+	memcpy(&b->data[b->len + 1 + klen], &val, sizeof(mr_value_t));
+	b->len += 1 + klen + sizeof(mr_value_t);
+	ctx->stats->shuffled++;
+
+	return (0);
+}
+
+/**
+ * @brief Spills the combine table into the send buffers.
+ */
+static int mr_spill(struct mr_context *ctx)
+{
+	for (size_t i = 0; i < MR_COMBINE_SLOTS; i++)
+	{
+		struct centry *e = &ctx->ctable[i];
+
+		if (e->hash == 0)
+			continue;
+
+		if (mr_push(ctx, e->key, e->klen, e->value) < 0)
+			return (-1);
+		e->hash = 0;
+	}
+
+	ctx->cused = 0;
+
+	return (0);
+}
+
+/**
+ * @brief Emits an intermediate pair.
+ *
+ * @param ctx  Map context.
+ * @param key  Key.
+ * @param klen Key length (at most MR_KEY_MAX bytes).
+ * @param val  Value.
+ */
+void mr_emit(struct mr_context *ctx, const void *key, size_t klen, mr_value_t val)
+{
+	uint32_t hash;
+	size_t i;
+
+	if (ctx->error)
+		return;
+
+	if (klen > MR_KEY_MAX)
+	{
+		ctx->error = EINVAL;
+		return;
+	}
+
+	ctx->stats->emitted++;
+
+	/* No combining. */
+	if (ctx->job->combine == NULL)
+	{
+		if (mr_push(ctx, key, klen, val) < 0)
+			ctx->error = errno;
+		return;
+	}
+
+	hash = mr_hash(key, klen);
+	i = hash & (MR_COMBINE_SLOTS - 1);
+
+	while (ctx->ctable[i].hash != 0)
+	{
+		struct centry *e = &ctx->ctable[i];
+
+		if ((e->hash == hash) && (e->klen == klen) &&
+			(memcmp(e->key, key, klen) == 0))
+		{
+			e->value = ctx->job->combine(e->value, val);
+			return;
+		}
+
+		i = (i + 1) & (MR_COMBINE_SLOTS - 1);
+	}
+
+	ctx->ctable[i].hash = hash;
+	ctx->ctable[i].klen = klen;
+	memcpy(ctx->ctable[i].key, key, klen);
+	ctx->ctable[i].value = val;
+
+	/* Table is getting crowded. */
+	if (4*(++ctx->cused) > 3*MR_COMBINE_SLOTS)
+	{
+		if (mr_spill(ctx) < 0)
+			ctx->error = errno;
+	}
+}
+
+/*============================================================================*
+ * Job execution                                                              *
+ *============================================================================*/
+
+/**
+ * @brief Compares two reduce entries by key.
+ */
+static int mr_keycmp(const void *a, const void *b)
+{
+	int ret;
+	const struct rentry *e1 = *(const struct rentry * const *) a;
+	const struct rentry *e2 = *(const struct rentry * const *) b;
+
+	ret = memcmp(e1->key, e2->key, (e1->klen < e2->klen) ? e1->klen : e2->klen);
+	if (ret != 0)
+		return (ret);
+
+	return ((int) e1->klen - (int) e2->klen);
+}
+
+/**
+ * @brief Releases a map context.
+ */
+static void mr_cleanup(struct mr_context *ctx)
+{
+	if (ctx->rtable != NULL)
+	{
+		for (size_t i = 0; i < ctx->rslots; i++)
+		{
+			free(ctx->rtable[i].key);
+			free(ctx->rtable[i].vals);
+		}
+	}
+
+	free(ctx->rtable);
+	free(ctx->ctable);
+	free(ctx->bufs);
+}
+
+/**
+ * @brief Runs a MapReduce job.
+ *
+ * @details All tiles must call this function collectively. Each tile
+ * maps its local input split, shuffles the intermediate pairs over the
+ * NoC, and reduces the keys that the partitioner assigns to it.
+ *
+ * @param job   Job description.
+ * @param input Local input split.
+ * @param len   Length of the local input split.
+ * @param stats Store location for statistics (optional).
+ *
+ * @returns Zero upon success and -1 otherwise.
+ */
+int mr_run(const struct mr_job *job, const void *input, size_t len, struct mr_stats *stats)
+{
+	uint64_t t0, t1;
+	struct msg *m, *stash;
+	struct mr_stats dummy;
+	struct mr_context ctx;
+	struct rentry **sorted = NULL;
+	struct mr_msghdr eos = { MR_MSG_EOS, 0 };
+	static uint8_t buf[MR_MSG_SIZE];
+
+	if ((job == NULL) || (job->map == NULL) || (job->reduce == NULL))
+	{
+		errno = EINVAL;
+		return (-1);
+	}
+
+	if (stats == NULL)
+		stats = &dummy;
+	memset(stats, 0, sizeof(struct mr_stats));
+
+	memset(&ctx, 0, sizeof(struct mr_context));
+	ctx.job = job;
+	ctx.stats = stats;
+	ctx.ntiles = noc_ntiles();
+	ctx.rslots = MR_REDUCE_SLOTS;
+	ctx.bufs = calloc(ctx.ntiles, sizeof(struct sendbuf));
+	ctx.rtable = calloc(ctx.rslots, sizeof(struct rentry));
+	if (job->combine != NULL)
+		ctx.ctable = calloc(MR_COMBINE_SLOTS, sizeof(struct centry));
+
+	if ((ctx.bufs == NULL) || (ctx.rtable == NULL) ||
+		((job->combine != NULL) && (ctx.ctable == NULL)))
+	{
+		errno = ENOMEM;
+		goto error;
+	}
+
+	/* Messages that arrived early for this job. */
+	stash = mr.stash;
+	mr.stash = NULL;
+	while ((m = stash) != NULL)
+	{
+		stash = m->next;
+		mr_handle(&ctx, m->data, m->len);
+		free(m);
+	}
+
+	/* Map. */
+	t0 = mr_now();
+	job->map(&ctx, input, len, job->arg);
+	if ((job->combine != NULL) && (!ctx.error))
+	{
+		if (mr_spill(&ctx) < 0)
+			ctx.error = errno;
+	}
+	for (int i = 0; (i < ctx.ntiles) && (!ctx.error); i++)
+	{
+		if (mr_flush(&ctx, i) < 0)
+			ctx.error = errno;
+	}
+	t1 = mr_now();
+	stats->map_time = t1 - t0;
+
+	/*
+	 * Always send end-of-stream markers, even on error,
+	 * so that remote tiles do not hang.
+	 */
+	eos.job = mr.job;
+	for (int i = 0; i < ctx.ntiles; i++)
+		noc_send(i, NOC_PORT_MAPREDUCE, &eos, sizeof(struct mr_msghdr));
+
+	/* Shuffle. */
+	while (ctx.eos < ctx.ntiles)
+	{
+		if (mr_receive(&ctx, buf) < 0)
+		{
+			ctx.error = errno;
+			break;
+		}
+	}
+	t0 = mr_now();
+	stats->shuffle_time = t0 - t1;
+
+	if (ctx.error)
+	{
+		errno = ctx.error;
+		goto error;
+	}
+
+	/* Sort. */
+	if ((sorted = malloc((ctx.rused + 1)*sizeof(struct rentry *))) == NULL)
+	{
+		errno = ENOMEM;
+		goto error;
+	}
+	for (size_t i = 0, j = 0; i < ctx.rslots; i++)
+	{
+		if (ctx.rtable[i].hash != 0)
+			sorted[j++] = &ctx.rtable[i];
+	}
+	qsort(sorted, ctx.rused, sizeof(struct rentry *), mr_keycmp);
+
+	/* Reduce. */
+	for (size_t i = 0; i < ctx.rused; i++)
+		job->reduce(sorted[i]->key, sorted[i]->klen, sorted[i]->vals, sorted[i]->nvals, job->arg);
+	stats->keys = ctx.rused;
+	stats->reduce_time = mr_now() - t0;
+
+	free(sorted);
+	mr_cleanup(&ctx);
+	mr.job++;
+	return (0);
+
+error:
+	free(sorted);
+	mr_cleanup(&ctx);
+	mr.job++;
+	return (-1);
+}
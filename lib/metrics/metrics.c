@@ -0,0 +1,73 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <metrics.h>
+
+/**
+ * @brief Fetches the aggregated metrics from the collector.
+ *
+ * @details Must run on the collector tile.
+ *
+ * @param tiles Where to store the metrics, one entry per tile.
+ * @param max   Entries in @p tiles.
+ *
+ * @returns The number of tiles, or -1 on error.
+ */
+int metrics_fetch(struct metrics_tile *tiles, int max)
+{
+	int fd;
+	ssize_t n;
+	struct sockaddr_un addr;
+	static struct metrics_tile buf[NOC_MAX_TILES];
+	socklen_t len = offsetof(struct sockaddr_un, sun_path) + sizeof(METRICS_SOCKET) - 1;
+
+	if ((fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0)) < 0)
+		return (-1);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	memcpy(addr.sun_path, METRICS_SOCKET, sizeof(METRICS_SOCKET) - 1);
+
+	if (connect(fd, (struct sockaddr *) &addr, len) < 0)
+	{
+		close(fd);
+		return (-1);
+	}
+
+	n = recv(fd, buf, sizeof(buf), 0);
+	close(fd);
+
+	if (n < 0)
+		return (-1);
+	if ((n % sizeof(struct metrics_tile)) != 0)
+	{
+		errno = EPROTO;
+		return (-1);
+	}
+
+	n /= sizeof(struct metrics_tile);
+	memcpy(tiles, buf, ((n < max) ? n : max)*sizeof(struct metrics_tile));
+
+	return (n);
+}
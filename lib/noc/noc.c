@@ -0,0 +1,1055 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <alloca.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <noc.h>
+#include "pool.h"
+#include "rate.h"
+
+/**
+ * @brief Number of header words in a packet.
+ */
+#define NOC_HDR_WORDS 2
+
+/**
+ * @brief Maximum payload of a packet (in bytes).
+ */
+#define NOC_PAYLOAD_MAX ((NOC_PACKET_WORDS - NOC_HDR_WORDS)*sizeof(uint32_t))
+
+/**
+ * @brief Physical address of the message passing endpoint.
+ *
+ * @details The simple message passing buffer of the OpTiMSoC network
+ * adapter. Writing to it pushes a packet (its size in words, then the
+ * words) and reading from it pops one (its size, zero if none is
+ * pending, then the words). Can be overridden with NOC_NA_BASE.
+ */
+#define NOC_NA_BASE 0xe0100000
+
+/**
+ * @brief Size of the register window (in bytes).
+ */
+#define NOC_NA_SIZE 4096
+
+/**
+ * @brief Busy-wait iterations between two clock reads in noc_poll().
+ */
+#define NOC_SPIN_CHECK 1024
+
+/**
+ * @brief Empty polls of the adapter before a receiver starts yielding
+ * the CPU on every poll.
+ */
+#define NOC_RECV_SPIN 256
+
+/**
+ * @brief Most stack prefaulted by noc_profile() (in KB).
+ */
+#define NOC_PREFAULT_MAX 1024
+
+/**
+ * @name Message information word.
+ *
+ * @details The second word of every packet carries the destination
+ * port in bits 30:16 and the total message length in bits 15:0. Bit 31
+ * flags a traced message, whose first packet carries the trace context
+ * in the NOC_TRACE_WORDS words that follow the header.
+ */
+/**@{*/
+#define NOC_INFO(port, len) (((uint32_t)(port) << 16) | ((len) & 0xffff))
+#define NOC_INFO_PORT(i)    (((i) >> 16) & NOC_PORT_MAX)
+#define NOC_INFO_LEN(i)     ((i) & 0xffff)
+#define NOC_INFO_TRACED     (1u << 31)
+/**@}*/
+
+/**
+ * @brief Number of words of a trace context.
+ */
+#define NOC_TRACE_WORDS (sizeof(struct noc_trace)/sizeof(uint32_t))
+
+/**
+ * @brief Counter slot of a port.
+ */
+#define NOC_STATS_SLOT(port) (((port) < NOC_STATS_PORTS) ? (port) : NOC_STATS_PORTS - 1)
+
+/**
+ * @brief Message being reassembled.
+ */
+struct partial
+{
+	uint8_t *buf;    /**< Message data.      */
+	size_t len;      /**< Message length.    */
+	size_t received; /**< Bytes received.    */
+	int port;        /**< Destination port.  */
+	size_t discard;  /**< Bytes to drop.     */
+	struct noc_trace trace; /**< Trace context. */
+};
+
+/**
+ * @brief Trace context stamped on outgoing messages (zero for none).
+ */
+static __thread struct noc_trace noc_trace_tx;
+
+/**
+ * @brief Trace context of the last message received.
+ */
+static __thread struct noc_trace noc_trace_rx;
+
+/**
+ * @brief Traffic counters, when they cannot be shared.
+ */
+static struct noc_stats noc_private_stats;
+
+/**
+ * @brief NoC library state.
+ */
+static struct
+{
+	int mode;                    /**< Access mode (-1 if closed).    */
+	int fd;                      /**< NoC device file descriptor.    */
+	int lockfd;                  /**< Adapter lock (poll mode).      */
+	volatile uint32_t *na;       /**< Adapter registers (poll mode). */
+	size_t pending;              /**< Words in rxpkt (poll mode).    */
+	uint32_t rxpkt[NOC_PACKET_WORDS]; /**< Packet popped by noc_poll(). */
+	int loopfd[2];               /**< Loopback wake-up pipe.         */
+	int tile;                    /**< ID of the local tile.          */
+	int ntiles;                  /**< Number of tiles.               */
+	int width;                   /**< Mesh width (tiles per row).    */
+	pthread_mutex_t txlock;      /**< Serializes packet trains.      */
+	pthread_mutex_t rxlock;      /**< Serializes reassembly.         */
+	pthread_mutex_t looplock;    /**< Protects the loopback queue.   */
+	struct noc_bufhdr *loophead; /**< Loopback queue head.           */
+	struct noc_bufhdr *looptail; /**< Loopback queue tail.           */
+	struct partial partials[NOC_MAX_TILES]; /**< Reassembly buffers. */
+	struct noc_stats *stats;     /**< Traffic counters.              */
+} noc = {
+	.mode = -1,
+	.fd = -1,
+	.lockfd = -1,
+	.loopfd = { -1, -1 },
+	.tile = 0,
+	.ntiles = 1,
+	.width = 1,
+	.txlock = PTHREAD_MUTEX_INITIALIZER,
+	.rxlock = PTHREAD_MUTEX_INITIALIZER,
+	.looplock = PTHREAD_MUTEX_INITIALIZER,
+	.stats = &noc_private_stats,
+};
+
+/**
+ * @brief Reads an integer from the environment.
+ */
+static int getenv_int(const char *name, int def)
+{
+	char *end;
+	long val;
+	const char *str;
+
+	if ((str = getenv(name)) == NULL)
+		return (def);
+
+	val = strtol(str, &end, 0);
+	if ((*str == '\0') || (*end != '\0'))
+		return (def);
+
+	return ((int) val);
+}
+
+/**
+ * @brief Maps the registers of the network adapter.
+ *
+ * @details Goes through the physical memory device, UIO style, so the
+ * NoC driver is not involved at all. The driver must not be bound to
+ * the adapter at the same time, or its interrupt handler would steal
+ * packets: build it as a module and leave it unloaded.
+ *
+ * Packet trains are only serialized within a process, and the adapter
+ * has a single receive queue, so one process at a time may use it:
+ * the others fail with EBUSY, for as long as NOC_POLL_LOCK is held.
+ */
+static int noc_map(void)
+{
+	int fd;
+	void *p;
+	unsigned long base;
+	const char *str;
+	int cpu;
+
+	base = NOC_NA_BASE;
+	if ((str = getenv("NOC_NA_BASE")) != NULL)
+		base = strtoul(str, NULL, 0);
+
+	if ((noc.lockfd = open(NOC_POLL_LOCK, O_RDWR | O_CREAT | O_CLOEXEC, 0600)) < 0)
+		return (-1);
+	if (flock(noc.lockfd, LOCK_EX | LOCK_NB) < 0)
+	{
+		if (errno == EWOULDBLOCK)
+			errno = EBUSY;
+		goto error;
+	}
+
+	if ((fd = open(NOC_MEMDEV, O_RDWR | O_SYNC)) < 0)
+		goto error;
+
+	p = mmap(NULL, NOC_NA_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, (off_t) base);
+	close(fd);
+	if (p == MAP_FAILED)
+		goto error;
+	noc.na = p;
+	noc.pending = 0;
+
+	/* Pin the polling thread. */
+	if ((cpu = getenv_int("NOC_POLL_CPU", -1)) >= 0)
+	{
+		cpu_set_t set;
+
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		sched_setaffinity(0, sizeof(set), &set);
+	}
+
+	return (0);
+
+error:
+	close(noc.lockfd);
+	noc.lockfd = -1;
+	return (-1);
+}
+
+/**
+ * @brief Maps the traffic counters of the tile.
+ *
+ * @details Every process of the tile maps the same file, so the
+ * counters add up the traffic of the whole tile. The file can be moved
+ * with NOC_STATS, or the counters kept private to the process by
+ * setting it empty. Counting is best effort: if the file cannot be
+ * mapped, the counters stay private.
+ */
+static void noc_stats_map(void)
+{
+	int fd;
+	void *p;
+	const char *path;
+
+	if (noc.stats != &noc_private_stats)
+		return;
+
+	if ((path = getenv("NOC_STATS")) == NULL)
+		path = NOC_STATS_FILE;
+	if (*path == '\0')
+		return;
+
+	if ((fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600)) < 0)
+		return;
+
+	if (ftruncate(fd, sizeof(struct noc_stats)) == 0)
+	{
+		p = mmap(NULL, sizeof(struct noc_stats), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (p != MAP_FAILED)
+			noc.stats = p;
+	}
+
+	close(fd);
+}
+
+/**
+ * @brief Bumps a traffic counter or gauge.
+ */
+static inline void noc_count(uint32_t *counter, uint32_t n)
+{
+	__atomic_fetch_add(counter, n, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Accounts for a message.
+ */
+static void noc_account(int port, size_t len, int rx)
+{
+	struct noc_port_stats *s = &noc.stats->ports[NOC_STATS_SLOT(port)];
+
+	noc_count(rx ? &s->rx_msgs : &s->tx_msgs, 1);
+	noc_count(rx ? &s->rx_bytes : &s->tx_bytes, len);
+}
+
+/**
+ * @brief Applies the memory profile of the process.
+ *
+ * @details Set by init from the service manifest, since locks do not
+ * survive exec(). With NOC_MLOCK nonzero, every page of the process is
+ * locked, now and as it gets mapped, so the NoC path never waits for a
+ * page fault. NOC_PREFAULT touches that many KB of stack, which
+ * mlockall() leaves alone until first use. Best effort.
+ */
+static void noc_profile(void)
+{
+	int kb = getenv_int("NOC_PREFAULT", 0);
+
+	if (getenv_int("NOC_MLOCK", 0) != 0)
+		mlockall(MCL_CURRENT | MCL_FUTURE);
+
+	if (kb > 0)
+	{
+		volatile uint8_t *stack;
+
+		if (kb > NOC_PREFAULT_MAX)
+			kb = NOC_PREFAULT_MAX;
+
+		stack = alloca(kb*1024);
+		for (int i = 0; i < kb*1024; i += 1024)
+			stack[i] = 0;
+	}
+}
+
+/**
+ * @brief Opens the NoC in a given access mode.
+ *
+ * @details The local tile ID and the number of tiles are taken from
+ * the NOC_TILE and NOC_NTILES environment variables, which the kernel
+ * forwards to init from its command line. The mesh width comes from
+ * NOC_MESH_X and defaults to the smallest square mesh that fits.
+ *
+ * In NOC_MODE_SYSCALL, packets go through the /noc device and blocking
+ * calls sleep in poll(). In NOC_MODE_POLL, the registers of the network
+ * adapter are mapped into the process and packets are moved with plain
+ * loads and stores: sending and receiving take no system call, and
+ * receiving busy-waits.
+ *
+ * @param mode Access mode.
+ *
+ * @returns Zero upon success and -1 otherwise.
+ */
+int noc_init_mode(int mode)
+{
+	if (noc.mode >= 0)
+		return (0);
+
+	if ((mode != NOC_MODE_SYSCALL) && (mode != NOC_MODE_POLL))
+	{
+		errno = EINVAL;
+		return (-1);
+	}
+
+	noc.tile = getenv_int("NOC_TILE", 0);
+	noc.ntiles = getenv_int("NOC_NTILES", 1);
+	for (noc.width = 1; noc.width*noc.width < noc.ntiles; noc.width++)
+		/* noop */;
+	noc.width = getenv_int("NOC_MESH_X", noc.width);
+
+	if ((noc.ntiles < 1) || (noc.ntiles > NOC_MAX_TILES) ||
+		(noc.tile < 0) || (noc.tile >= noc.ntiles) ||
+		(noc.width < 1) || (noc.width > noc.ntiles))
+	{
+		errno = EINVAL;
+		return (-1);
+	}
+
+	if (pipe2(noc.loopfd, O_CLOEXEC | O_NONBLOCK) < 0)
+		return (-1);
+
+	if (((mode == NOC_MODE_POLL) && (noc_map() < 0)) ||
+		((mode == NOC_MODE_SYSCALL) && ((noc.fd = open(NOC_DEVNAME, O_RDWR | O_CLOEXEC)) < 0)))
+	{
+		close(noc.loopfd[0]);
+		close(noc.loopfd[1]);
+		return (-1);
+	}
+
+	noc.mode = mode;
+	noc_stats_map();
+	noc_rate_init();
+	noc_profile();
+
+	return (0);
+}
+
+/**
+ * @brief Opens the NoC.
+ *
+ * @details Uses NOC_MODE_POLL if the NOC_MODE environment variable is
+ * set to "poll", and NOC_MODE_SYSCALL otherwise.
+ *
+ * @returns Zero upon success and -1 otherwise.
+ */
+int noc_init(void)
+{
+	const char *str = getenv("NOC_MODE");
+
+	if ((str != NULL) && (strcmp(str, "poll") == 0))
+		return (noc_init_mode(NOC_MODE_POLL));
+
+	return (noc_init_mode(NOC_MODE_SYSCALL));
+}
+
+/**
+ * @brief Closes the NoC.
+ */
+void noc_finalize(void)
+{
+	struct noc_bufhdr *m;
+
+	if (noc.mode < 0)
+		return;
+
+	if (noc.mode == NOC_MODE_POLL)
+	{
+		munmap((void *) noc.na, NOC_NA_SIZE);
+		close(noc.lockfd);
+		noc.lockfd = -1;
+	}
+	else
+		close(noc.fd);
+	close(noc.loopfd[0]);
+	close(noc.loopfd[1]);
+	noc.na = NULL;
+	noc.fd = -1;
+	noc.mode = -1;
+
+	while ((m = noc.loophead) != NULL)
+	{
+		noc.loophead = m->next;
+		noc_buf_free(NOC_BUFDATA(m));
+		noc_count(&noc.stats->loop_depth, -1);
+	}
+	noc.looptail = NULL;
+
+	for (int i = 0; i < NOC_MAX_TILES; i++)
+	{
+		if (noc.partials[i].buf != NULL)
+			noc_count(&noc.stats->partials, -1);
+		noc_buf_free(noc.partials[i].buf);
+		memset(&noc.partials[i], 0, sizeof(struct partial));
+	}
+}
+
+/**
+ * @brief Returns the access mode.
+ */
+int noc_mode(void)
+{
+	return (noc.mode);
+}
+
+/**
+ * @brief Returns the ID of the local tile.
+ */
+int noc_tile(void)
+{
+	return (noc.tile);
+}
+
+/**
+ * @brief Returns the number of tiles.
+ */
+int noc_ntiles(void)
+{
+	return (noc.ntiles);
+}
+
+/**
+ * @brief Returns the width of the mesh.
+ *
+ * @details Tile IDs are assigned in row-major order, so tile t sits at
+ * column t % width and row t / width.
+ */
+int noc_mesh_width(void)
+{
+	return (noc.width);
+}
+
+/**
+ * @brief Queues a message that the local tile sends to itself.
+ */
+static ssize_t noc_loopback(int port, const void *buf, size_t len)
+{
+	void *data;
+	struct noc_bufhdr *m;
+
+	if ((data = noc_buf_alloc(len)) == NULL)
+		return (-1);
+	memcpy(data, buf, len);
+
+	m = NOC_BUFHDR(data);
+	m->src = noc.tile;
+	m->port = port;
+	m->len = len;
+	m->trace = noc_trace_tx;
+
+	pthread_mutex_lock(&noc.looplock);
+	if (noc.looptail != NULL)
+		noc.looptail->next = m;
+	else
+		noc.loophead = m;
+	noc.looptail = m;
+	pthread_mutex_unlock(&noc.looplock);
+	noc_count(&noc.stats->loop_depth, 1);
+
+	/* Wake up any reader (pollers see the queue anyway). */
+	if (noc.mode == NOC_MODE_SYSCALL)
+		(void) write(noc.loopfd[1], "", 1);
+
+	return ((ssize_t) len);
+}
+
+/**
+ * @brief Pushes a packet to the network adapter (poll mode).
+ */
+static void noc_na_send(const uint32_t *pkt, size_t nwords)
+{
+	noc.na[0] = nwords;
+	for (size_t i = 0; i < nwords; i++)
+		noc.na[0] = pkt[i];
+}
+
+/**
+ * @brief Locks the transmit path.
+ *
+ * @details Reassembly is keyed by source tile only, so no packet of
+ * the tile may come between the packets of a train: not those of other
+ * threads, and not those that other processes of the tile write through
+ * their own descriptors. In poll mode, the process is alone.
+ */
+static void noc_tx_lock(void)
+{
+	pthread_mutex_lock(&noc.txlock);
+
+	if (noc.mode == NOC_MODE_SYSCALL)
+	{
+		while ((flock(noc.fd, LOCK_EX) < 0) && (errno == EINTR))
+			/* noop */;
+	}
+}
+
+/**
+ * @brief Unlocks the transmit path.
+ */
+static void noc_tx_unlock(void)
+{
+	if (noc.mode == NOC_MODE_SYSCALL)
+		flock(noc.fd, LOCK_UN);
+
+	pthread_mutex_unlock(&noc.txlock);
+}
+
+/**
+ * @brief Pops a packet from the network adapter (poll mode).
+ *
+ * @details Called with the receive lock held. Words beyond
+ * NOC_PACKET_WORDS are dropped.
+ *
+ * @returns The packet size in bytes, or zero if none is pending.
+ */
+static ssize_t noc_na_recv(uint32_t *pkt)
+{
+	size_t n;
+
+	/* Popped by noc_poll(). */
+	if (noc.pending > 0)
+	{
+		n = noc.pending;
+		memcpy(pkt, noc.rxpkt, n*sizeof(uint32_t));
+		noc.pending = 0;
+		return ((ssize_t)(n*sizeof(uint32_t)));
+	}
+
+	if ((n = noc.na[0]) == 0)
+		return (0);
+
+	for (size_t i = 0; i < n; i++)
+	{
+		uint32_t word = noc.na[0];
+
+		if (i < NOC_PACKET_WORDS)
+			pkt[i] = word;
+	}
+
+	if (n > NOC_PACKET_WORDS)
+		n = NOC_PACKET_WORDS;
+
+	return ((ssize_t)(n*sizeof(uint32_t)));
+}
+
+/**
+ * @brief Sends a message.
+ *
+ * @details Waits first if the message exceeds a rate limit set with
+ * noc_rate_set().
+ *
+ * @param dest Destination tile.
+ * @param port Destination port.
+ * @param buf  Message data.
+ * @param len  Message length (at most NOC_MSG_MAX bytes).
+ *
+ * @returns The number of bytes sent upon success and -1 otherwise.
+ */
+ssize_t noc_send(int dest, int port, const void *buf, size_t len)
+{
+	const uint8_t *p = buf;
+	uint32_t pkt[NOC_PACKET_WORDS];
+
+	/* Closed, or given up to another process (poll mode). */
+	if (noc.mode < 0)
+	{
+		errno = EBADF;
+		return (-1);
+	}
+
+	if ((dest < 0) || (dest >= noc.ntiles) ||
+		(port < 0) || (port > NOC_PORT_MAX) || (len > NOC_MSG_MAX))
+	{
+		errno = EINVAL;
+		return (-1);
+	}
+
+	if (dest == noc.tile)
+	{
+		if (noc_loopback(port, buf, len) < 0)
+			return (-1);
+		noc_account(port, len, 0);
+		return ((ssize_t) len);
+	}
+
+	/* Split message into a train of packets. */
+	size_t left = len;
+	size_t ctx = (noc_trace_tx.trace != 0) ? NOC_TRACE_WORDS : 0;
+	size_t npkts = (len + ctx*sizeof(uint32_t) + NOC_PAYLOAD_MAX - 1)/NOC_PAYLOAD_MAX;
+
+	noc_rate_wait(dest, len + ctx*sizeof(uint32_t) +
+		((npkts > 0) ? npkts : 1)*NOC_HDR_WORDS*sizeof(uint32_t));
+
+	noc_tx_lock();
+
+	do
+	{
+		size_t max = NOC_PAYLOAD_MAX - ctx*sizeof(uint32_t);
+		size_t n = (left < max) ? left : max;
+		size_t nwords = NOC_HDR_WORDS + ctx + (n + sizeof(uint32_t) - 1)/sizeof(uint32_t);
+
+		pkt[0] = NOC_HDR(dest, NOC_CLASS_MSG, noc.tile);
+		pkt[1] = NOC_INFO(port, len);
+		if (ctx > 0)
+		{
+			pkt[1] |= NOC_INFO_TRACED;
+			memcpy(&pkt[NOC_HDR_WORDS], &noc_trace_tx, sizeof(struct noc_trace));
+		}
+		memcpy(&pkt[NOC_HDR_WORDS + ctx], p, n);
+
+		if (noc.mode == NOC_MODE_POLL)
+			noc_na_send(pkt, nwords);
+		else if (write(noc.fd, pkt, nwords*sizeof(uint32_t)) < 0)
+		{
+			noc_tx_unlock();
+			return (-1);
+		}
+
+		p += n;
+		left -= n;
+		ctx = 0;
+	} while (left > 0);
+
+	noc_tx_unlock();
+
+	noc_account(port, len, 0);
+
+	return ((ssize_t) len);
+}
+
+/**
+ * @brief Receives a complete message into a pool buffer.
+ */
+static ssize_t noc_recv_msg(int *src, int *port, void **bufp)
+{
+	ssize_t ret;
+	unsigned idle = 0;
+	struct noc_bufhdr *m;
+	uint32_t pkt[NOC_PACKET_WORDS];
+	struct pollfd fds[2];
+
+	/* Closed, or given up to another process (poll mode). */
+	if (noc.mode < 0)
+	{
+		errno = EBADF;
+		return (-1);
+	}
+
+	pthread_mutex_lock(&noc.rxlock);
+
+	while (1)
+	{
+		/* Local messages first. */
+		pthread_mutex_lock(&noc.looplock);
+		if ((m = noc.loophead) != NULL)
+		{
+			if ((noc.loophead = m->next) == NULL)
+				noc.looptail = NULL;
+		}
+		pthread_mutex_unlock(&noc.looplock);
+
+		if (m != NULL)
+		{
+			noc_count(&noc.stats->loop_depth, -1);
+			m->next = NULL;
+			*src = m->src;
+			*port = m->port;
+			*bufp = NOC_BUFDATA(m);
+			noc_trace_rx = m->trace;
+			ret = (ssize_t) m->len;
+			break;
+		}
+
+		/*
+		 * Busy-wait on the adapter, without holding the receive lock
+		 * in between, so that noc_poll() and other receivers get it,
+		 * and yielding the CPU once the adapter has been idle for a
+		 * while.
+		 */
+		if (noc.mode == NOC_MODE_POLL)
+		{
+			if ((ret = noc_na_recv(pkt)) > 0)
+			{
+				idle = 0;
+				goto reassemble;
+			}
+
+			pthread_mutex_unlock(&noc.rxlock);
+			if (++idle > NOC_RECV_SPIN)
+				sched_yield();
+			pthread_mutex_lock(&noc.rxlock);
+			continue;
+		}
+
+		fds[0].fd = noc.fd;
+		fds[0].events = POLLIN;
+		fds[1].fd = noc.loopfd[0];
+		fds[1].events = POLLIN;
+
+		if (poll(fds, 2, -1) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			ret = -1;
+			break;
+		}
+
+		/* Drain wake-up tokens. */
+		if (fds[1].revents & POLLIN)
+		{
+			char tmp[16];
+			while (read(noc.loopfd[0], tmp, sizeof(tmp)) > 0)
+				/* noop */;
+			continue;
+		}
+
+		if (!(fds[0].revents & POLLIN))
+			continue;
+
+		if ((ret = read(noc.fd, pkt, sizeof(pkt))) < 0)
+			break;
+
+reassemble:
+		/* Malformed packet. */
+		if (ret < (ssize_t)(NOC_HDR_WORDS*sizeof(uint32_t)))
+			continue;
+
+		struct partial *p = &noc.partials[NOC_HDR_SRC(pkt[0])];
+		size_t off = NOC_HDR_WORDS;
+
+		/*
+		 * Rest of a message that could not be taken in: its packets
+		 * carry a message header too, and must not be taken for the
+		 * first packet of another.
+		 */
+		if (p->discard > 0)
+		{
+			size_t n = ret - off*sizeof(uint32_t);
+
+			p->discard -= (n < p->discard) ? n : p->discard;
+			continue;
+		}
+
+		/* First packet of a message. */
+		if (p->buf == NULL)
+		{
+			memset(&p->trace, 0, sizeof(struct noc_trace));
+			if (pkt[1] & NOC_INFO_TRACED)
+			{
+				if (ret < (ssize_t)((NOC_HDR_WORDS + NOC_TRACE_WORDS)*sizeof(uint32_t)))
+					continue;
+				memcpy(&p->trace, &pkt[NOC_HDR_WORDS], sizeof(struct noc_trace));
+				off += NOC_TRACE_WORDS;
+			}
+
+			p->len = NOC_INFO_LEN(pkt[1]);
+			p->port = NOC_INFO_PORT(pkt[1]);
+			p->received = 0;
+			if ((p->buf = noc_buf_alloc(p->len)) == NULL)
+			{
+				size_t n = ret - off*sizeof(uint32_t);
+
+				p->discard = (n < p->len) ? p->len - n : 0;
+				ret = -1;
+				break;
+			}
+			noc_count(&noc.stats->partials, 1);
+		}
+
+		size_t n = ret - off*sizeof(uint32_t);
+		if (n > p->len - p->received)
+			n = p->len - p->received;
+		memcpy(p->buf + p->received, &pkt[off], n);
+		p->received += n;
+
+		if (p->received == p->len)
+		{
+			*src = NOC_HDR_SRC(pkt[0]);
+			*port = p->port;
+			*bufp = p->buf;
+			noc_trace_rx = p->trace;
+			ret = (ssize_t) p->len;
+			p->buf = NULL;
+			noc_count(&noc.stats->partials, -1);
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&noc.rxlock);
+
+	if (ret >= 0)
+		noc_account(*port, ret, 1);
+
+	return (ret);
+}
+
+/**
+ * @brief Receives a message.
+ *
+ * @param src  Store location for the source tile.
+ * @param port Store location for the destination port.
+ * @param buf  Target buffer.
+ * @param size Size of the target buffer.
+ *
+ * @returns The length of the received message upon success and -1
+ * otherwise. If the message is larger than @p size it is truncated,
+ * but its full length is still returned.
+ */
+ssize_t noc_recv(int *src, int *port, void *buf, size_t size)
+{
+	int s, pt;
+	void *data;
+	ssize_t len;
+
+	if ((len = noc_recv_msg(&s, &pt, &data)) < 0)
+		return (-1);
+
+	if (src != NULL)
+		*src = s;
+	if (port != NULL)
+		*port = pt;
+
+	memcpy(buf, data, ((size_t) len < size) ? (size_t) len : size);
+	noc_buf_free(data);
+
+	return (len);
+}
+
+/**
+ * @brief Receives a message without copying it.
+ *
+ * @details Hands over the pool buffer the message was reassembled in.
+ * The caller owns one reference and releases it with noc_buf_free().
+ *
+ * @param src  Store location for the source tile.
+ * @param port Store location for the destination port.
+ * @param bufp Store location for the message buffer.
+ *
+ * @returns The length of the received message upon success and -1
+ * otherwise.
+ */
+ssize_t noc_recv_buf(int *src, int *port, void **bufp)
+{
+	int s, pt;
+	void *data;
+	ssize_t len;
+
+	if ((len = noc_recv_msg(&s, &pt, &data)) < 0)
+		return (-1);
+
+	if (src != NULL)
+		*src = s;
+	if (port != NULL)
+		*port = pt;
+	*bufp = data;
+
+	return (len);
+}
+
+/**
+ * @brief Returns the current time in milliseconds.
+ */
+static uint64_t noc_now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((uint64_t) ts.tv_sec*1000 + ts.tv_nsec/1000000);
+}
+
+/**
+ * @brief Busy-waits for incoming traffic (poll mode).
+ *
+ * @details A packet found on the adapter is popped and kept for the
+ * next receive. The clock is only read every NOC_SPIN_CHECK rounds.
+ */
+static int noc_spin(int timeout)
+{
+	uint64_t deadline = 0;
+
+	if (timeout > 0)
+		deadline = noc_now_ms() + timeout;
+
+	for (unsigned i = 1; /* noop */; i++)
+	{
+		int ready;
+
+		pthread_mutex_lock(&noc.looplock);
+		ready = (noc.loophead != NULL);
+		pthread_mutex_unlock(&noc.looplock);
+
+		if (!ready)
+		{
+			pthread_mutex_lock(&noc.rxlock);
+			if (noc.pending == 0)
+				noc.pending = noc_na_recv(noc.rxpkt)/sizeof(uint32_t);
+			ready = (noc.pending > 0);
+			pthread_mutex_unlock(&noc.rxlock);
+		}
+
+		if (ready)
+			return (1);
+
+		if (timeout == 0)
+			return (0);
+
+		if ((timeout > 0) && ((i % NOC_SPIN_CHECK) == 0) && (noc_now_ms() >= deadline))
+			return (0);
+	}
+}
+
+/**
+ * @brief Waits for incoming traffic.
+ *
+ * @param timeout Timeout in milliseconds (-1 blocks forever).
+ *
+ * @returns A positive number if there is traffic to receive, zero on
+ * timeout, and -1 on error.
+ */
+int noc_poll(int timeout)
+{
+	char tmp[16];
+	struct pollfd fds[2];
+
+	/* Closed, or given up to another process (poll mode). */
+	if (noc.mode < 0)
+	{
+		errno = EBADF;
+		return (-1);
+	}
+
+	if (noc.mode == NOC_MODE_POLL)
+		return (noc_spin(timeout));
+
+	/* Drop stale wake-up tokens. */
+	while (read(noc.loopfd[0], tmp, sizeof(tmp)) > 0)
+		/* noop */;
+
+	pthread_mutex_lock(&noc.looplock);
+	if (noc.loophead != NULL)
+	{
+		pthread_mutex_unlock(&noc.looplock);
+		return (1);
+	}
+	pthread_mutex_unlock(&noc.looplock);
+
+	fds[0].fd = noc.fd;
+	fds[0].events = POLLIN;
+	fds[1].fd = noc.loopfd[0];
+	fds[1].events = POLLIN;
+
+	return (poll(fds, 2, timeout));
+}
+
+/**
+ * @brief Gets the traffic statistics of the tile.
+ *
+ * @details Covers every process of the tile, unless the counters could
+ * not be shared (see noc_stats_map()).
+ *
+ * @param stats Store location for the statistics.
+ */
+void noc_get_stats(struct noc_stats *stats)
+{
+	uint32_t *dst = (uint32_t *) stats;
+	uint32_t *src = (uint32_t *) noc.stats;
+
+	for (size_t i = 0; i < sizeof(struct noc_stats)/sizeof(uint32_t); i++)
+		dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Sets the trace context of outgoing messages.
+ *
+ * @details The context is per thread and travels in the first packet
+ * of every message the thread sends, until cleared with NULL or a zero
+ * trace ID. Untraced messages carry nothing extra.
+ *
+ * @param ctx Trace context.
+ */
+void noc_trace_set(const struct noc_trace *ctx)
+{
+	if (ctx != NULL)
+		noc_trace_tx = *ctx;
+	else
+		memset(&noc_trace_tx, 0, sizeof(struct noc_trace));
+}
+
+/**
+ * @brief Gets the trace context of the last message received.
+ *
+ * @details The context is per thread, and zero if the message was not
+ * traced.
+ *
+ * @param ctx Store location for the trace context.
+ */
+void noc_trace_get(struct noc_trace *ctx)
+{
+	*ctx = noc_trace_rx;
+}
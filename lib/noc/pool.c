@@ -0,0 +1,346 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <noc.h>
+#include "pool.h"
+
+/**
+ * @brief Log2 of the smallest size class.
+ */
+#define POOL_MIN_SHIFT 6
+
+/**
+ * @brief Number of size classes (64 B to 64 KB).
+ */
+#define POOL_NCLASSES 11
+
+/**
+ * @brief Slab size (in bytes).
+ *
+ * @details Classes whose buffers do not fit twice in a slab get one
+ * buffer per slab.
+ */
+#define POOL_SLAB_SIZE 16384
+
+/**
+ * @brief Bytes a thread may cache per size class.
+ */
+#define POOL_CACHE_BYTES 16384
+
+/**
+ * @brief Size class.
+ */
+struct pool_class
+{
+	pthread_mutex_t lock;    /**< Protects the free list.  */
+	struct noc_bufhdr *free; /**< Free buffers.            */
+	unsigned nfree;          /**< Number of free buffers.  */
+	uint64_t refills;        /**< Thread cache refills.    */
+	uint64_t flushes;        /**< Thread cache flushes.    */
+};
+
+/**
+ * @brief Pool state.
+ */
+static struct
+{
+	pthread_once_t once;     /**< Key creation.            */
+	pthread_key_t key;       /**< Thread exit hook.        */
+	pthread_mutex_t lock;    /**< Protects the counters.   */
+	uint64_t slabs;          /**< Slabs allocated.         */
+	uint64_t bytes;          /**< Bytes in slabs.          */
+	struct pool_class classes[POOL_NCLASSES]; /**< Size classes. */
+} pool = {
+	.once = PTHREAD_ONCE_INIT,
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.classes = {
+		[0 ... POOL_NCLASSES - 1] = { .lock = PTHREAD_MUTEX_INITIALIZER }
+	},
+};
+
+/**
+ * @brief Thread cache.
+ */
+static __thread struct
+{
+	int registered;                          /**< Exit hook set?  */
+	struct noc_bufhdr *head[POOL_NCLASSES];  /**< Free buffers.   */
+	unsigned count[POOL_NCLASSES];           /**< Cache sizes.    */
+} cache;
+
+/**
+ * @brief Returns the buffer size of a class.
+ */
+static inline size_t pool_size(int c)
+{
+	return ((size_t) 1 << (POOL_MIN_SHIFT + c));
+}
+
+/**
+ * @brief Returns the number of buffers a thread may cache in a class.
+ */
+static inline unsigned pool_limit(int c)
+{
+	unsigned n = POOL_CACHE_BYTES >> (POOL_MIN_SHIFT + c);
+
+	return ((n > 0) ? n : 1);
+}
+
+/**
+ * @brief Carves a new slab into buffers of a class.
+ *
+ * @details Called with the class lock held. Slabs are never given back.
+ */
+static int pool_grow(int c)
+{
+	size_t stride = NOC_CACHE_LINE + pool_size(c);
+	size_t n = (POOL_SLAB_SIZE/stride > 0) ? POOL_SLAB_SIZE/stride : 1;
+	uint8_t *slab;
+	void *p;
+
+	if (posix_memalign(&p, NOC_CACHE_LINE, n*stride) != 0)
+	{
+		errno = ENOMEM;
+		return (-1);
+	}
+	slab = p;
+
+	for (size_t i = 0; i < n; i++)
+	{
+		struct noc_bufhdr *h = (struct noc_bufhdr *)(slab + i*stride);
+
+		h->sclass = c;
+		h->next = pool.classes[c].free;
+		pool.classes[c].free = h;
+	}
+	pool.classes[c].nfree += n;
+
+	pthread_mutex_lock(&pool.lock);
+	pool.slabs++;
+	pool.bytes += n*stride;
+	pthread_mutex_unlock(&pool.lock);
+
+	return (0);
+}
+
+/**
+ * @brief Moves half a cache worth of buffers into the thread cache.
+ */
+static int pool_refill(int c)
+{
+	unsigned batch = (pool_limit(c) + 1)/2;
+	struct pool_class *pc = &pool.classes[c];
+
+	pthread_mutex_lock(&pc->lock);
+
+	if ((pc->nfree < batch) && (pool_grow(c) < 0) && (pc->nfree == 0))
+	{
+		pthread_mutex_unlock(&pc->lock);
+		return (-1);
+	}
+
+	pc->refills++;
+	for (unsigned i = 0; (i < batch) && (pc->free != NULL); i++)
+	{
+		struct noc_bufhdr *h = pc->free;
+
+		pc->free = h->next;
+		pc->nfree--;
+		h->next = cache.head[c];
+		cache.head[c] = h;
+		cache.count[c]++;
+	}
+
+	pthread_mutex_unlock(&pc->lock);
+
+	return (0);
+}
+
+/**
+ * @brief Moves buffers from the thread cache back to the pool.
+ */
+static void pool_flush(int c, unsigned keep)
+{
+	struct pool_class *pc = &pool.classes[c];
+
+	if (cache.count[c] <= keep)
+		return;
+
+	pthread_mutex_lock(&pc->lock);
+
+	pc->flushes++;
+	while (cache.count[c] > keep)
+	{
+		struct noc_bufhdr *h = cache.head[c];
+
+		cache.head[c] = h->next;
+		cache.count[c]--;
+		h->next = pc->free;
+		pc->free = h;
+		pc->nfree++;
+	}
+
+	pthread_mutex_unlock(&pc->lock);
+}
+
+/**
+ * @brief Returns the cache of an exiting thread to the pool.
+ */
+static void pool_exit(void *arg)
+{
+	((void) arg);
+
+	for (int c = 0; c < POOL_NCLASSES; c++)
+		pool_flush(c, 0);
+}
+
+/**
+ * @brief Creates the thread exit hook.
+ */
+static void pool_once(void)
+{
+	pthread_key_create(&pool.key, pool_exit);
+}
+
+/**
+ * @brief Hooks the thread cache to the exit of the calling thread.
+ *
+ * @details Done on the first allocation or release, whichever comes
+ * first: threads that only release buffers fill a cache too.
+ */
+static inline void pool_register(void)
+{
+	if (!cache.registered)
+	{
+		pthread_once(&pool.once, pool_once);
+		pthread_setspecific(pool.key, &cache);
+		cache.registered = 1;
+	}
+}
+
+/**
+ * @brief Allocates a message buffer.
+ *
+ * @details Buffers come in power-of-two size classes from 64 bytes up
+ * to 64 KB, are aligned to a cache line, and start with a reference
+ * count of one. Each thread keeps a small cache per class, so the
+ * common path takes no lock.
+ *
+ * @param size Buffer size (at most NOC_MSG_MAX + 1 bytes).
+ *
+ * @returns A pointer to the buffer upon success and NULL otherwise.
+ */
+void *noc_buf_alloc(size_t size)
+{
+	int c;
+	struct noc_bufhdr *h;
+
+	for (c = 0; (c < POOL_NCLASSES) && (pool_size(c) < size); c++)
+		/* noop */;
+
+	if (c == POOL_NCLASSES)
+	{
+		errno = EMSGSIZE;
+		return (NULL);
+	}
+
+	pool_register();
+
+	if ((cache.head[c] == NULL) && (pool_refill(c) < 0))
+		return (NULL);
+
+	h = cache.head[c];
+	cache.head[c] = h->next;
+	cache.count[c]--;
+
+	h->next = NULL;
+	h->refcount = 1;
+
+	return (NOC_BUFDATA(h));
+}
+
+/**
+ * @brief Takes an extra reference to a message buffer.
+ *
+ * @details Lets a buffer be handed over, without copying, to code that
+ * releases it on its own.
+ */
+void noc_buf_ref(void *buf)
+{
+	__atomic_add_fetch(&NOC_BUFHDR(buf)->refcount, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Drops a reference to a message buffer.
+ *
+ * @details The buffer goes back to the pool with the last reference.
+ */
+void noc_buf_free(void *buf)
+{
+	int c;
+	struct noc_bufhdr *h;
+
+	if (buf == NULL)
+		return;
+
+	h = NOC_BUFHDR(buf);
+	if (__atomic_sub_fetch(&h->refcount, 1, __ATOMIC_ACQ_REL) != 0)
+		return;
+
+	pool_register();
+
+	c = h->sclass;
+	h->next = cache.head[c];
+	cache.head[c] = h;
+	if (++cache.count[c] > pool_limit(c))
+		pool_flush(c, pool_limit(c)/2);
+}
+
+/**
+ * @brief Returns the usable size of a message buffer.
+ */
+size_t noc_buf_size(const void *buf)
+{
+	return (pool_size(NOC_BUFHDR(buf)->sclass));
+}
+
+/**
+ * @brief Returns statistics of the buffer pool.
+ */
+void noc_pool_get_stats(struct noc_pool_stats *stats)
+{
+	memset(stats, 0, sizeof(struct noc_pool_stats));
+
+	pthread_mutex_lock(&pool.lock);
+	stats->slabs = pool.slabs;
+	stats->bytes = pool.bytes;
+	pthread_mutex_unlock(&pool.lock);
+
+	for (int c = 0; c < POOL_NCLASSES; c++)
+	{
+		pthread_mutex_lock(&pool.classes[c].lock);
+		stats->free += pool.classes[c].nfree;
+		stats->refills += pool.classes[c].refills;
+		stats->flushes += pool.classes[c].flushes;
+		pthread_mutex_unlock(&pool.classes[c].lock);
+	}
+}
@@ -0,0 +1,56 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NOC_POOL_H_
+#define NOC_POOL_H_
+
+	#include <stdint.h>
+
+	#include <noc.h>
+
+	/**
+	 * @brief Buffer header.
+	 *
+	 * @details Sits in the cache line right before the data. While a
+	 * buffer is free, next links it in a free list; while it is in use,
+	 * libnoc may use next, src, port, len and trace to queue it as a
+	 * message.
+	 */
+	struct noc_bufhdr
+	{
+		struct noc_bufhdr *next; /**< Next buffer in a list.  */
+		uint32_t refcount;       /**< Reference count.        */
+		uint16_t sclass;         /**< Size class.             */
+		uint16_t port;           /**< Message port.           */
+		uint32_t len;            /**< Message length.         */
+		int32_t src;             /**< Message source tile.    */
+		struct noc_trace trace;  /**< Message trace context.  */
+	};
+
+	/**
+	 * @brief Returns the header of a buffer.
+	 */
+	#define NOC_BUFHDR(p) \
+		((struct noc_bufhdr *)((uint8_t *)(p) - NOC_CACHE_LINE))
+
+	/**
+	 * @brief Returns the data of a buffer.
+	 */
+	#define NOC_BUFDATA(h) \
+		((void *)((uint8_t *)(h) + NOC_CACHE_LINE))
+
+#endif /* NOC_POOL_H_ */
@@ -0,0 +1,270 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <noc.h>
+#include "rate.h"
+
+/**
+ * @brief Nanoseconds per second.
+ */
+#define NOC_NSEC 1000000000LL
+
+/**
+ * @brief Default burst, as a fraction of a second of traffic.
+ */
+#define NOC_RATE_HZ 100
+
+/**
+ * @brief Smallest burst (in bytes): one full packet.
+ */
+#define NOC_BURST_MIN (NOC_PACKET_WORDS*sizeof(uint32_t))
+
+/**
+ * @brief Token bucket.
+ *
+ * @details Tokens are kept in byte-nanoseconds, so refilling is one
+ * multiplication and no fraction of a byte is ever lost to rounding.
+ * Tokens go negative while senders wait for the ones they reserved.
+ */
+struct noc_bucket
+{
+	int64_t tokens;     /**< Tokens (byte-ns).              */
+	int64_t last;       /**< Last refill (ns).              */
+	struct noc_rate r;  /**< Limit and statistics.          */
+};
+
+/**
+ * @brief Rate limiter state.
+ */
+static struct
+{
+	int active;                              /**< Any limit set?           */
+	pthread_mutex_t lock;                    /**< Protects the buckets.    */
+	struct noc_bucket all;                   /**< All traffic.             */
+	struct noc_bucket dest[NOC_MAX_TILES];   /**< Traffic per destination. */
+} noc_rate = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/**
+ * @brief Reads the clock (in nanoseconds).
+ */
+static int64_t noc_rate_clock(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((int64_t) ts.tv_sec*NOC_NSEC + ts.tv_nsec);
+}
+
+/**
+ * @brief Configures a bucket, full.
+ */
+static void noc_bucket_set(struct noc_bucket *b, uint32_t rate, uint32_t burst)
+{
+	if ((rate > 0) && (burst == 0))
+		burst = rate/NOC_RATE_HZ;
+	if ((rate > 0) && (burst < NOC_BURST_MIN))
+		burst = NOC_BURST_MIN;
+
+	b->r.rate = rate;
+	b->r.burst = (rate > 0) ? burst : 0;
+	b->tokens = (int64_t) b->r.burst*NOC_NSEC;
+	b->last = noc_rate_clock();
+}
+
+/**
+ * @brief Takes tokens from a bucket.
+ *
+ * @returns How long the sender must wait for them (in ns).
+ */
+static int64_t noc_bucket_take(struct noc_bucket *b, int64_t now, size_t bytes)
+{
+	int64_t elapsed = now - b->last;
+	int64_t full = (int64_t) b->r.burst*NOC_NSEC;
+
+	if (b->r.rate == 0)
+		return (0);
+
+	/*
+	 * A long idle period only fills the bucket. The bound is the time
+	 * to refill from the current balance, which is negative while a
+	 * reservation is being paid back, not from empty.
+	 */
+	if (elapsed > (full - b->tokens)/b->r.rate)
+		elapsed = (full - b->tokens)/b->r.rate + 1;
+	b->last = now;
+	b->tokens += elapsed*b->r.rate;
+	if (b->tokens > full)
+		b->tokens = full;
+
+	b->tokens -= (int64_t) bytes*NOC_NSEC;
+	if (b->tokens >= 0)
+		return (0);
+
+	return ((-b->tokens + b->r.rate - 1)/b->r.rate);
+}
+
+/**
+ * @brief Parses a "rate[,burst]" limit.
+ */
+static void noc_rate_parse(const char *str, uint32_t *rate, uint32_t *burst)
+{
+	char *end;
+
+	*rate = strtoul(str, &end, 0);
+	*burst = (*end == ',') ? strtoul(end + 1, NULL, 0) : 0;
+}
+
+/**
+ * @brief Reads the limits set in the environment.
+ *
+ * @details NOC_RATE limits all traffic of the sender and NOC_RATE_DEST
+ * the traffic to each destination, both as "rate[,burst]" in bytes per
+ * second and bytes.
+ */
+void noc_rate_init(void)
+{
+	uint32_t rate, burst;
+	const char *str;
+
+	if ((str = getenv("NOC_RATE")) != NULL)
+	{
+		noc_rate_parse(str, &rate, &burst);
+		noc_rate_set(NOC_RATE_ALL, rate, burst);
+	}
+
+	if ((str = getenv("NOC_RATE_DEST")) != NULL)
+	{
+		noc_rate_parse(str, &rate, &burst);
+		for (int i = 0; i < NOC_MAX_TILES; i++)
+			noc_rate_set(i, rate, burst);
+	}
+}
+
+/**
+ * @brief Waits until a message may be sent.
+ *
+ * @details Tokens are reserved in both the sender and the destination
+ * buckets before waiting, so concurrent senders are served in order
+ * and the lock is not held while sleeping.
+ *
+ * @param dest  Destination tile.
+ * @param bytes Size of the message on the wire.
+ */
+void noc_rate_wait(int dest, size_t bytes)
+{
+	int64_t now, wait, w;
+	struct timespec ts;
+
+	if (!__atomic_load_n(&noc_rate.active, __ATOMIC_RELAXED))
+		return;
+
+	pthread_mutex_lock(&noc_rate.lock);
+
+	now = noc_rate_clock();
+	wait = noc_bucket_take(&noc_rate.all, now, bytes);
+	w = noc_bucket_take(&noc_rate.dest[dest], now, bytes);
+	if (w > wait)
+		wait = w;
+
+	if (wait > 0)
+	{
+		struct noc_bucket *b = (w == wait) ? &noc_rate.dest[dest] : &noc_rate.all;
+
+		b->r.throttled++;
+		b->r.waited += wait;
+	}
+
+	pthread_mutex_unlock(&noc_rate.lock);
+
+	if (wait <= 0)
+		return;
+
+	ts.tv_sec = wait/NOC_NSEC;
+	ts.tv_nsec = wait%NOC_NSEC;
+	while ((nanosleep(&ts, &ts) < 0) && (errno == EINTR))
+		/* noop */;
+}
+
+/**
+ * @brief Sets a rate limit.
+ *
+ * @details Messages that exceed the limit are delayed by noc_send(),
+ * never dropped. A message larger than the burst is sent once enough
+ * tokens have accumulated for it, so the average rate holds.
+ *
+ * @param dest  Destination tile, or NOC_RATE_ALL for all traffic.
+ * @param rate  Bytes per second, or zero to lift the limit.
+ * @param burst Bucket size in bytes, or zero for a hundredth of a
+ *              second of traffic.
+ *
+ * @returns Zero upon success and -1 otherwise.
+ */
+int noc_rate_set(int dest, uint32_t rate, uint32_t burst)
+{
+	int active;
+
+	if ((dest < NOC_RATE_ALL) || (dest >= NOC_MAX_TILES))
+	{
+		errno = EINVAL;
+		return (-1);
+	}
+
+	pthread_mutex_lock(&noc_rate.lock);
+
+	noc_bucket_set((dest == NOC_RATE_ALL) ? &noc_rate.all : &noc_rate.dest[dest], rate, burst);
+
+	active = (noc_rate.all.r.rate > 0);
+	for (int i = 0; i < NOC_MAX_TILES; i++)
+		active |= (noc_rate.dest[i].r.rate > 0);
+	__atomic_store_n(&noc_rate.active, active, __ATOMIC_RELAXED);
+
+	pthread_mutex_unlock(&noc_rate.lock);
+
+	return (0);
+}
+
+/**
+ * @brief Gets a rate limit and its statistics.
+ *
+ * @param dest Destination tile, or NOC_RATE_ALL for all traffic.
+ * @param rate Store location for the limit.
+ *
+ * @returns Zero upon success and -1 otherwise.
+ */
+int noc_rate_get(int dest, struct noc_rate *rate)
+{
+	if ((dest < NOC_RATE_ALL) || (dest >= NOC_MAX_TILES) || (rate == NULL))
+	{
+		errno = EINVAL;
+		return (-1);
+	}
+
+	pthread_mutex_lock(&noc_rate.lock);
+	*rate = (dest == NOC_RATE_ALL) ? noc_rate.all.r : noc_rate.dest[dest].r;
+	pthread_mutex_unlock(&noc_rate.lock);
+
+	return (0);
+}
@@ -0,0 +1,172 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include <noc.h>
+
+/**
+ * @brief Bytes of a file mapped at once.
+ */
+#define NOC_SENDFILE_WINDOW (1024*1024)
+
+/**
+ * @brief Sends from a pipe, socket, device or unmappable file.
+ *
+ * @details Reads into a pool buffer, one message at a time.
+ */
+static ssize_t noc_sendfile_read(int dest, int port, int fd, size_t count)
+{
+	int err = 0;
+	size_t sent = 0;
+	uint8_t *buf;
+
+	if ((buf = noc_buf_alloc(NOC_SENDFILE_CHUNK)) == NULL)
+		return (-1);
+
+	while (sent < count)
+	{
+		size_t want = (count - sent < NOC_SENDFILE_CHUNK) ? count - sent : NOC_SENDFILE_CHUNK;
+		ssize_t n;
+
+		if ((n = read(fd, buf, want)) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			err = 1;
+			break;
+		}
+
+		/* End of file. */
+		if (n == 0)
+			break;
+
+		if (noc_send(dest, port, buf, n) < 0)
+		{
+			err = 1;
+			break;
+		}
+
+		sent += n;
+	}
+
+	noc_buf_free(buf);
+
+	return ((err && (sent == 0)) ? -1 : (ssize_t) sent);
+}
+
+/**
+ * @brief Sends from a mapping of a regular file.
+ *
+ * @details Messages are built straight from the page cache, so the
+ * data is not first copied into a user buffer by read(). Files that
+ * cannot be mapped are read instead.
+ */
+static ssize_t noc_sendfile_map(int dest, int port, int fd, off_t off, size_t count)
+{
+	int err = 0;
+	size_t sent = 0;
+	long pagesize = sysconf(_SC_PAGESIZE);
+
+	while ((sent < count) && !err)
+	{
+		off_t base = (off + sent) & ~((off_t) pagesize - 1);
+		size_t skip = (off + sent) - base;
+		size_t n = (count - sent < NOC_SENDFILE_WINDOW) ? count - sent : NOC_SENDFILE_WINDOW;
+		uint8_t *p;
+
+		/* Not mappable after all: read the rest. */
+		if ((p = mmap(NULL, skip + n, PROT_READ, MAP_SHARED, fd, base)) == MAP_FAILED)
+		{
+			ssize_t r;
+
+			lseek(fd, off + sent, SEEK_SET);
+			if ((r = noc_sendfile_read(dest, port, fd, count - sent)) < 0)
+				err = 1;
+			else
+				sent += r;
+			break;
+		}
+		madvise(p, skip + n, MADV_SEQUENTIAL);
+
+		for (size_t i = 0; i < n; i += NOC_SENDFILE_CHUNK)
+		{
+			size_t m = (n - i < NOC_SENDFILE_CHUNK) ? n - i : NOC_SENDFILE_CHUNK;
+
+			if (noc_send(dest, port, p + skip + i, m) < 0)
+			{
+				err = 1;
+				break;
+			}
+			sent += m;
+		}
+
+		munmap(p, skip + n);
+	}
+
+	lseek(fd, off + sent, SEEK_SET);
+
+	return ((err && (sent == 0)) ? -1 : (ssize_t) sent);
+}
+
+/**
+ * @brief Sends data from a file descriptor.
+ *
+ * @details Counterpart of sendfile(2) for the NoC. Every packet starts
+ * with the libnoc header words, so raw file pages cannot be spliced
+ * into the NoC device. Instead, regular files are mapped and
+ * sent straight from the page cache, and anything else, including
+ * files that report no size or cannot be mapped, is read into a pool
+ * buffer. Data goes out as messages of up to NOC_SENDFILE_CHUNK
+ * bytes, starting at the current file offset, which is advanced.
+ *
+ * @param dest  Destination tile.
+ * @param port  Destination port.
+ * @param fd    Source file descriptor.
+ * @param count Maximum number of bytes to send.
+ *
+ * @returns The number of bytes sent (zero at end of file) upon success
+ * and -1 otherwise.
+ */
+ssize_t noc_sendfile(int dest, int port, int fd, size_t count)
+{
+	off_t off;
+	struct stat st;
+
+	if (fstat(fd, &st) < 0)
+		return (-1);
+
+	/*
+	 * Files of /proc and /sys report a zero size, and their contents
+	 * are only generated by read().
+	 */
+	if (S_ISREG(st.st_mode) && (st.st_size > 0) && ((off = lseek(fd, 0, SEEK_CUR)) >= 0))
+	{
+		if (off >= st.st_size)
+			return (0);
+		if (count > (size_t)(st.st_size - off))
+			count = st.st_size - off;
+
+		return (noc_sendfile_map(dest, port, fd, off, count));
+	}
+
+	return (noc_sendfile_read(dest, port, fd, count));
+}
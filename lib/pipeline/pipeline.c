@@ -0,0 +1,549 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <noc.h>
+#include <pipeline.h>
+
+/**
+ * @brief Maximum size of a batch (in bytes).
+ */
+#define PL_BATCH_MAX 2048
+
+/**
+ * @brief Batches a channel may buffer (credits per channel).
+ */
+#define PL_CREDITS 4
+
+/**
+ * @brief Age after which a partial batch is sent (in ns).
+ */
+#define PL_BATCH_AGE 1000000
+
+/**
+ * @name Message types.
+ */
+/**@{*/
+#define PL_MSG_DATA   0 /**< Batch of records.        */
+#define PL_MSG_CREDIT 1 /**< Batch consumed.          */
+#define PL_MSG_EOS    2 /**< End of stream.           */
+#define PL_MSG_STATS  3 /**< Statistics of one stage. */
+/**@}*/
+
+/**
+ * @brief Message header.
+ */
+struct pl_msghdr
+{
+	uint8_t type;   /**< Message type.      */
+	uint8_t stage;  /**< Stage index.       */
+	uint16_t nrecs; /**< Records in batch.  */
+};
+
+/**
+ * @brief Queued input batch.
+ */
+struct batch
+{
+	struct batch *next; /**< Next batch.        */
+	size_t len;         /**< Length of records. */
+	uint8_t data[];     /**< Records.           */
+};
+
+/**
+ * @brief Stage context.
+ */
+struct pl_context
+{
+	int stage; /**< Stage index. */
+};
+
+/**
+ * @brief Pipeline state of the local tile.
+ */
+static struct
+{
+	const struct pl_stage *stages;         /**< Stages.                    */
+	int nstages;                           /**< Number of stages.          */
+	int first;                             /**< First local stage.         */
+	int last;                              /**< Last local stage.          */
+	int upstream;                          /**< Upstream tile or -1.       */
+	int downstream;                        /**< Downstream tile or -1.     */
+	struct pl_context ctx[PL_MAX_STAGES];  /**< Stage contexts.            */
+	struct pl_stats *stats;                /**< Statistics.                */
+	int nstats;                            /**< Remote statistics received. */
+
+	/**
+	 * @name Output channel.
+	 */
+	/**@{*/
+	uint8_t batch[sizeof(struct pl_msghdr) + PL_BATCH_MAX]; /**< Batch.     */
+	size_t blen;                           /**< Batch length.              */
+	uint16_t nrecs;                        /**< Records in batch.          */
+	uint64_t bstart;                       /**< When the batch was opened. */
+	int credits;                           /**< Available credits.         */
+	/**@}*/
+
+	/**
+	 * @name Input channel.
+	 */
+	/**@{*/
+	struct batch *qhead;                   /**< Queue head.                */
+	struct batch *qtail;                   /**< Queue tail.                */
+	int qlen;                              /**< Queue length.              */
+	int eos;                               /**< End of stream received?    */
+	/**@}*/
+} pl;
+
+/**
+ * @brief Receive buffer.
+ */
+static uint8_t rxbuf[sizeof(struct pl_msghdr) + PL_BATCH_MAX + sizeof(struct pl_stats)];
+
+/**
+ * @brief Returns the current time in nanoseconds.
+ */
+static uint64_t pl_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((uint64_t) ts.tv_sec*1000000000ULL + ts.tv_nsec);
+}
+
+/**
+ * @brief Sends a control message.
+ */
+static int pl_control(int dest, int type, int stage, const void *data, size_t len)
+{
+	struct pl_msghdr hdr = { type, stage, 0 };
+	uint8_t buf[sizeof(struct pl_msghdr) + sizeof(struct pl_stats)];
+
+	memcpy(buf, &hdr, sizeof(struct pl_msghdr));
+	memcpy(buf + sizeof(struct pl_msghdr), data, len);
+
+	return ((noc_send(dest, NOC_PORT_PIPELINE, buf, sizeof(struct pl_msghdr) + len) < 0) ? -1 : 0);
+}
+
+/**
+ * @brief Receives and handles one message.
+ */
+static int pl_pump(void)
+{
+	int port;
+	ssize_t len;
+	struct pl_msghdr hdr;
+	struct batch *b;
+
+	if ((len = noc_recv(NULL, &port, rxbuf, sizeof(rxbuf))) < 0)
+		return (-1);
+
+	if ((port != NOC_PORT_PIPELINE) || (len < (ssize_t) sizeof(struct pl_msghdr)) ||
+		(len > (ssize_t) sizeof(rxbuf)))
+		return (0);
+
+	memcpy(&hdr, rxbuf, sizeof(struct pl_msghdr));
+
+	switch (hdr.type)
+	{
+		case PL_MSG_DATA:
+			len -= sizeof(struct pl_msghdr);
+			if ((b = malloc(sizeof(struct batch) + len)) == NULL)
+				return (-1);
+			b->next = NULL;
+			b->len = len;
+			memcpy(b->data, rxbuf + sizeof(struct pl_msghdr), len);
+			if (pl.qtail != NULL)
+				pl.qtail->next = b;
+			else
+				pl.qhead = b;
+			pl.qtail = b;
+			if (++pl.qlen > (int) pl.stats[pl.first].occupancy_max)
+				pl.stats[pl.first].occupancy_max = pl.qlen;
+			break;
+
+		case PL_MSG_CREDIT:
+			pl.credits++;
+			break;
+
+		case PL_MSG_EOS:
+			pl.eos = 1;
+			break;
+
+		case PL_MSG_STATS:
+			if ((hdr.stage < pl.nstages) &&
+				(len == sizeof(struct pl_msghdr) + sizeof(struct pl_stats)))
+			{
+				memcpy(&pl.stats[hdr.stage], rxbuf + sizeof(struct pl_msghdr),
+					sizeof(struct pl_stats));
+				pl.nstats++;
+			}
+			break;
+	}
+
+	return (0);
+}
+
+/**
+ * @brief Sends the current output batch downstream.
+ *
+ * @details Blocks while the downstream queue is full.
+ */
+static int pl_flush(void)
+{
+	uint64_t t0;
+	struct pl_msghdr hdr = { PL_MSG_DATA, pl.last + 1, pl.nrecs };
+	struct pl_stats *stats = &pl.stats[pl.first];
+
+	if (pl.nrecs == 0)
+		return (0);
+
+	/* Backpressure. */
+	t0 = pl_now();
+	while (pl.credits == 0)
+	{
+		if (pl_pump() < 0)
+			return (-1);
+	}
+	stats->block_time += pl_now() - t0;
+
+	memcpy(pl.batch, &hdr, sizeof(struct pl_msghdr));
+	if (noc_send(pl.downstream, NOC_PORT_PIPELINE, pl.batch, pl.blen) < 0)
+		return (-1);
+
+	pl.credits--;
+	pl.stats[pl.last].batches_out++;
+	pl.blen = sizeof(struct pl_msghdr);
+	pl.nrecs = 0;
+
+	return (0);
+}
+
+/**
+ * @brief Passes a record on to the next stage.
+ *
+ * @details Records cross tiles in batches. A batch is sent when it is
+ * full, when it gets old, or when the local stages run out of input,
+ * so batches grow under load and latency stays low when idle.
+ *
+ * @returns Zero upon success and -1 otherwise.
+ */
+int pl_emit(struct pl_context *ctx, const void *rec, size_t len)
+{
+	int next = ctx->stage + 1;
+
+	if (len > PL_RECORD_MAX)
+	{
+		errno = EMSGSIZE;
+		return (-1);
+	}
+
+	/* Sink. */
+	if (next == pl.nstages)
+		return (0);
+
+	pl.stats[ctx->stage].records_out++;
+
+	/* Fused stage. */
+	if (next <= pl.last)
+	{
+		pl.stats[next].records_in++;
+		return ((pl.stages[next].fn(&pl.ctx[next], rec, len, pl.stages[next].arg) < 0) ? -1 : 0);
+	}
+
+	if ((pl.blen + sizeof(uint16_t) + len > sizeof(pl.batch)) || (pl.nrecs == UINT16_MAX))
+	{
+		if (pl_flush() < 0)
+			return (-1);
+	}
+
+	if (pl.nrecs == 0)
+		pl.bstart = pl_now();
+
+	uint16_t rlen = len;
+	memcpy(pl.batch + pl.blen, &rlen, sizeof(uint16_t));
+	memcpy(pl.batch + pl.blen + sizeof(uint16_t), rec, len);
+	pl.blen += sizeof(uint16_t) + len;
+	pl.nrecs++;
+
+	/* Reading the clock is a system call here, so do it sparingly. */
+	if (((pl.nrecs & 63) == 0) && (pl_now() - pl.bstart > PL_BATCH_AGE))
+		return (pl_flush());
+
+	return (0);
+}
+
+/**
+ * @brief Runs the records of a batch through the local stages.
+ */
+static int pl_consume(struct batch *b)
+{
+	size_t off = 0;
+	const struct pl_stage *s = &pl.stages[pl.first];
+
+	pl.stats[pl.first].batches_in++;
+
+	while (off + sizeof(uint16_t) <= b->len)
+	{
+		uint16_t rlen;
+
+		memcpy(&rlen, b->data + off, sizeof(uint16_t));
+		off += sizeof(uint16_t);
+		if (off + rlen > b->len)
+			break;
+
+		pl.stats[pl.first].records_in++;
+		if (s->fn(&pl.ctx[pl.first], b->data + off, rlen, s->arg) < 0)
+			return (-1);
+		off += rlen;
+	}
+
+	return (pl_control(pl.upstream, PL_MSG_CREDIT, pl.first, NULL, 0));
+}
+
+/**
+ * @brief Runs the local stages.
+ */
+static int pl_loop(void)
+{
+	int ret;
+	uint64_t t0;
+	struct batch *b;
+	struct pl_stats *stats = &pl.stats[pl.first];
+	const struct pl_stage *s = &pl.stages[pl.first];
+
+	/* Source. */
+	if (pl.first == 0)
+	{
+		while ((ret = s->fn(&pl.ctx[0], NULL, 0, s->arg)) == PL_MORE)
+			/* noop */;
+		return ((ret < 0) ? -1 : 0);
+	}
+
+	while (1)
+	{
+		if (pl.qhead == NULL)
+		{
+			if (pl.eos)
+				break;
+
+			/* About to starve: do not sit on a partial batch. */
+			if ((pl.downstream >= 0) && (pl_flush() < 0))
+				return (-1);
+
+			t0 = pl_now();
+			while ((pl.qhead == NULL) && (!pl.eos))
+			{
+				if (pl_pump() < 0)
+					return (-1);
+			}
+			stats->starve_time += pl_now() - t0;
+			continue;
+		}
+
+		stats->occupancy_sum += pl.qlen;
+		stats->occupancy_count++;
+
+		b = pl.qhead;
+		if ((pl.qhead = b->next) == NULL)
+			pl.qtail = NULL;
+		pl.qlen--;
+
+		ret = pl_consume(b);
+		free(b);
+		if (ret < 0)
+			return (-1);
+	}
+
+	return (0);
+}
+
+/**
+ * @brief Returns the stage that limits throughput.
+ *
+ * @details That is the stage (group) that spends the largest share of
+ * its time computing rather than waiting for input or credits.
+ */
+int pl_bottleneck(const struct pl_stats *stats, int nstages)
+{
+	int worst = 0;
+	uint64_t worst_busy = 0;
+
+	for (int i = 0; i < nstages; i++)
+	{
+		uint64_t busy;
+
+		if (stats[i].elapsed == 0)
+			continue;
+
+		busy = (stats[i].busy_time*1000)/stats[i].elapsed;
+		if (busy > worst_busy)
+		{
+			worst = i;
+			worst_busy = busy;
+		}
+	}
+
+	return (worst);
+}
+
+/**
+ * @brief Runs a pipeline.
+ *
+ * @details All tiles call this function collectively with the same
+ * stages. Stages placed on the same tile must be consecutive; they are
+ * fused into direct calls. Channels between tiles are bounded: a tile
+ * may only have PL_CREDITS batches in flight to the next one, so a slow
+ * stage throttles the stages before it.
+ *
+ * @param stages  Pipeline stages.
+ * @param nstages Number of stages.
+ * @param stats   Statistics, one entry per stage (optional). On the
+ *                tile that runs the last stage, it is filled in for all
+ *                stages; elsewhere, only for local stages.
+ *
+ * @returns Zero upon success and -1 otherwise.
+ */
+int pl_run(const struct pl_stage *stages, int nstages, struct pl_stats *stats)
+{
+	int ret;
+	int tile;
+	uint64_t t0;
+	struct pl_stats *local = NULL;
+
+	if ((nstages < 1) || (nstages > PL_MAX_STAGES))
+	{
+		errno = EINVAL;
+		return (-1);
+	}
+
+	memset(&pl, 0, sizeof(pl));
+	pl.stages = stages;
+	pl.nstages = nstages;
+	pl.first = -1;
+	pl.last = -1;
+	pl.upstream = -1;
+	pl.downstream = -1;
+	pl.credits = PL_CREDITS;
+	pl.blen = sizeof(struct pl_msghdr);
+
+	/* Find local segment and its neighbours. */
+	tile = noc_tile();
+	for (int i = 0; i < nstages; i++)
+	{
+		if ((stages[i].tile < 0) || (stages[i].tile >= noc_ntiles()))
+		{
+			errno = EINVAL;
+			return (-1);
+		}
+
+		if (stages[i].tile != tile)
+			continue;
+
+		if ((pl.last >= 0) && (pl.last != i - 1))
+		{
+			errno = EINVAL;
+			return (-1);
+		}
+		if (pl.first < 0)
+			pl.first = i;
+		pl.last = i;
+		pl.ctx[i].stage = i;
+	}
+
+	/* Nothing to do here. */
+	if (pl.first < 0)
+		return (0);
+
+	if (pl.first > 0)
+		pl.upstream = stages[pl.first - 1].tile;
+	if (pl.last < nstages - 1)
+		pl.downstream = stages[pl.last + 1].tile;
+
+	if (stats == NULL)
+	{
+		if ((local = calloc(nstages, sizeof(struct pl_stats))) == NULL)
+			return (-1);
+		stats = local;
+	}
+	memset(stats, 0, nstages*sizeof(struct pl_stats));
+	pl.stats = stats;
+
+	t0 = pl_now();
+	ret = pl_loop();
+
+	/* Drain output channel. */
+	if ((ret == 0) && (pl.downstream >= 0))
+	{
+		uint64_t t1;
+
+		ret = pl_flush();
+		t1 = pl_now();
+		while ((ret == 0) && (pl.credits < PL_CREDITS))
+			ret = pl_pump();
+		stats[pl.first].block_time += pl_now() - t1;
+	}
+	if (pl.downstream >= 0)
+		pl_control(pl.downstream, PL_MSG_EOS, pl.last + 1, NULL, 0);
+
+	/* Group counters. */
+	stats[pl.first].elapsed = pl_now() - t0;
+	stats[pl.first].busy_time = stats[pl.first].elapsed -
+		stats[pl.first].starve_time - stats[pl.first].block_time;
+	for (int i = pl.first; i <= pl.last; i++)
+	{
+		stats[i].tile = tile;
+		if (i == pl.first)
+			continue;
+		stats[i].elapsed = stats[pl.first].elapsed;
+		stats[i].busy_time = stats[pl.first].busy_time;
+		stats[i].starve_time = stats[pl.first].starve_time;
+		stats[i].block_time = stats[pl.first].block_time;
+	}
+
+	/* Gather statistics at the sink. */
+	if (pl.downstream >= 0)
+	{
+		int sink = stages[nstages - 1].tile;
+
+		for (int i = pl.first; i <= pl.last; i++)
+			pl_control(sink, PL_MSG_STATS, i, &stats[i], sizeof(struct pl_stats));
+	}
+	else
+	{
+		int nremote = nstages - (pl.last - pl.first + 1);
+
+		while ((ret == 0) && (pl.nstats < nremote))
+			ret = pl_pump();
+	}
+
+	while (pl.qhead != NULL)
+	{
+		struct batch *b = pl.qhead;
+		pl.qhead = b->next;
+		free(b);
+	}
+
+	free(local);
+
+	return (ret);
+}
@@ -0,0 +1,166 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <place.h>
+
+/**
+ * @brief Placement client.
+ */
+static struct
+{
+	int fd;               /**< Connection to init, -1 if closed. */
+	pthread_mutex_t lock; /**< Serializes requests.               */
+} place = {
+	.fd = -1,
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/**
+ * @brief Connects to the placement service of this tile.
+ */
+static int place_connect(void)
+{
+	int fd;
+	struct sockaddr_un addr;
+	socklen_t len = offsetof(struct sockaddr_un, sun_path) + sizeof(PLACE_SOCKET) - 1;
+
+	if ((fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0)) < 0)
+		return (-1);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	memcpy(addr.sun_path, PLACE_SOCKET, sizeof(PLACE_SOCKET) - 1);
+
+	if (connect(fd, (struct sockaddr *) &addr, len) < 0)
+	{
+		close(fd);
+		return (-1);
+	}
+
+	return (fd);
+}
+
+/**
+ * @brief Issues a request.
+ *
+ * @details The connection is kept open across requests. If it breaks,
+ * it is reopened once, in case init dropped it.
+ */
+static int place_call(int op, int policy, struct place_rep *rep)
+{
+	ssize_t n = -1;
+	struct place_req req = { .op = op, .policy = policy };
+
+	pthread_mutex_lock(&place.lock);
+
+	for (int retry = 0; retry < 2; retry++)
+	{
+		if ((place.fd < 0) && ((place.fd = place_connect()) < 0))
+			break;
+
+		if ((send(place.fd, &req, sizeof(req), MSG_NOSIGNAL) == sizeof(req)) &&
+			((n = recv(place.fd, rep, sizeof(struct place_rep), 0)) == sizeof(struct place_rep)))
+			break;
+
+		close(place.fd);
+		place.fd = -1;
+		n = -1;
+	}
+
+	pthread_mutex_unlock(&place.lock);
+
+	if (n != sizeof(struct place_rep))
+	{
+		if (n >= 0)
+			errno = EPROTO;
+		return (-1);
+	}
+
+	return (0);
+}
+
+/**
+ * @brief Chooses a tile to run a new task on.
+ *
+ * @details The tile is charged one pending task until it next reports
+ * its load, so it is fine to call this once per task in a burst.
+ *
+ * @param policy Placement policy (PLACE_P2C, PLACE_LEAST or PLACE_LOCAL).
+ *
+ * @returns The chosen tile, or -1 on error.
+ */
+int place_pick(int policy)
+{
+	struct place_rep rep;
+
+	if (place_call(PLACE_OP_PICK, policy, &rep) < 0)
+		return (-1);
+
+	if (rep.tile < 0)
+	{
+		errno = EINVAL;
+		return (-1);
+	}
+
+	return (rep.tile);
+}
+
+/**
+ * @brief Gets the load table of the placement service.
+ *
+ * @param loads Where to store the table.
+ * @param max   Entries in @p loads.
+ *
+ * @returns The number of tiles, or -1 on error.
+ */
+int place_table(struct place_load *loads, int max)
+{
+	struct place_rep rep;
+
+	if (place_call(PLACE_OP_TABLE, 0, &rep) < 0)
+		return (-1);
+
+	if ((rep.ntiles > NOC_MAX_TILES) || (max < 0))
+	{
+		errno = EPROTO;
+		return (-1);
+	}
+
+	memcpy(loads, rep.loads, ((rep.ntiles < (unsigned) max) ? rep.ntiles : (unsigned) max)*sizeof(struct place_load));
+
+	return (rep.ntiles);
+}
+
+/**
+ * @brief Closes the connection to the placement service.
+ */
+void place_close(void)
+{
+	pthread_mutex_lock(&place.lock);
+	if (place.fd >= 0)
+		close(place.fd);
+	place.fd = -1;
+	pthread_mutex_unlock(&place.lock);
+}
@@ -0,0 +1,332 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <noc.h>
+#include <trace.h>
+
+/**
+ * @brief Builds an ID that is unique across tiles.
+ */
+#define TRACE_ID(tile, seq) (((uint32_t)(tile) << 24) | ((seq) & 0xffffff))
+
+/**
+ * @brief Tracing state of a process.
+ *
+ * @details Every process of a tile keeps its own ring and clock offset,
+ * so each one that traces must synchronize and dump on its own.
+ */
+static struct
+{
+	pthread_once_t once;                   /**< Seeds the ID sequence.   */
+	int64_t offset;                        /**< Clock offset (ns).       */
+	uint32_t seq;                          /**< Last ID handed out.      */
+	uint32_t head;                         /**< Events recorded so far.  */
+	struct trace_event ring[TRACE_RING];   /**< Event ring.              */
+} trace = {
+	.once = PTHREAD_ONCE_INIT,
+};
+
+/**
+ * @brief Open spans of a thread.
+ */
+static __thread struct
+{
+	int depth;                            /**< Nesting level.           */
+	struct
+	{
+		struct noc_trace ctx;             /**< Trace and span IDs.      */
+		uint32_t parent;                  /**< Parent span.             */
+		char name[TRACE_NAME_MAX];        /**< Span name.               */
+	} stack[TRACE_DEPTH];                 /**< Open spans.              */
+} spans;
+
+/**
+ * @brief Reads the local clock (in nanoseconds).
+ */
+static int64_t trace_clock(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((int64_t) ts.tv_sec*1000000000 + ts.tv_nsec);
+}
+
+/**
+ * @brief Seeds the ID sequence.
+ *
+ * @details Several processes of a tile may trace at once, so each one
+ * starts from a different point of the sequence.
+ */
+static void trace_seed(void)
+{
+	trace.seq = (uint32_t) getpid() << 12;
+}
+
+/**
+ * @brief Hands out a new trace or span ID.
+ */
+static uint32_t trace_id(void)
+{
+	uint32_t seq;
+
+	pthread_once(&trace.once, trace_seed);
+
+	/* Zero means "no trace". */
+	while ((seq = __atomic_add_fetch(&trace.seq, 1, __ATOMIC_RELAXED) & 0xffffff) == 0)
+		/* noop */;
+
+	return (TRACE_ID(noc_tile(), seq));
+}
+
+/**
+ * @brief Records an event.
+ */
+static void trace_record(char type, const struct noc_trace *ctx, uint32_t parent, const char *name)
+{
+	uint32_t i = __atomic_fetch_add(&trace.head, 1, __ATOMIC_RELAXED);
+	struct trace_event *ev = &trace.ring[i % TRACE_RING];
+
+	ev->time = trace_clock() + trace.offset;
+	ev->trace = ctx->trace;
+	ev->span = ctx->span;
+	ev->parent = parent;
+	ev->type = type;
+	memcpy(ev->name, name, TRACE_NAME_MAX);
+}
+
+/**
+ * @brief Synchronizes the trace clock with a reference tile.
+ *
+ * @details Must be called by every tile. Each tile measures a few
+ * round trips to the reference tile and keeps the offset seen by the
+ * fastest one, whose error is at most half its round trip time. Other
+ * messages that arrive meanwhile are dropped.
+ *
+ * @param ref Reference tile.
+ *
+ * @returns Zero upon success and -1 otherwise.
+ */
+int trace_sync(int ref)
+{
+	int src, port;
+	int64_t t0, t1, now, best = INT64_MAX;
+
+	if ((ref < 0) || (ref >= noc_ntiles()))
+	{
+		errno = EINVAL;
+		return (-1);
+	}
+
+	/* Do not trace the synchronization itself. */
+	noc_trace_set(NULL);
+
+	if (noc_tile() == ref)
+	{
+		for (int n = 0; n < (noc_ntiles() - 1)*TRACE_SYNC_ROUNDS; /* noop */)
+		{
+			if (noc_recv(&src, &port, &now, sizeof(now)) < 0)
+				return (-1);
+			if (port != NOC_PORT_TRACE)
+				continue;
+
+			now = trace_clock();
+			if (noc_send(src, NOC_PORT_TRACE, &now, sizeof(now)) < 0)
+				return (-1);
+			n++;
+		}
+
+		trace.offset = 0;
+	}
+	else
+	{
+		for (int r = 0; r < TRACE_SYNC_ROUNDS; r++)
+		{
+			t0 = trace_clock();
+			if (noc_send(ref, NOC_PORT_TRACE, &t0, sizeof(t0)) < 0)
+				return (-1);
+			do
+			{
+				if (noc_recv(&src, &port, &now, sizeof(now)) < 0)
+					return (-1);
+			} while ((port != NOC_PORT_TRACE) || (src != ref));
+			t1 = trace_clock();
+
+			if (t1 - t0 < best)
+			{
+				best = t1 - t0;
+				trace.offset = now + (t1 - t0)/2 - t1;
+			}
+		}
+	}
+
+	if (spans.depth > 0)
+		noc_trace_set(&spans.stack[(spans.depth < TRACE_DEPTH) ? spans.depth - 1 : TRACE_DEPTH - 1].ctx);
+
+	return (0);
+}
+
+/**
+ * @brief Returns the offset between the local and the trace clock.
+ */
+int64_t trace_offset(void)
+{
+	return (trace.offset);
+}
+
+/**
+ * @brief Opens a span.
+ */
+static uint32_t trace_open(const char *name, const struct noc_trace *from)
+{
+	uint32_t parent = 0;
+	struct noc_trace ctx;
+	char buf[TRACE_NAME_MAX];
+
+	/* Names end up in whitespace separated dumps. */
+	memset(buf, 0, sizeof(buf));
+	for (int i = 0; (i < TRACE_NAME_MAX - 1) && (name[i] != '\0'); i++)
+		buf[i] = ((name[i] == ' ') || (name[i] == '\t') || (name[i] == '\n')) ? '_' : name[i];
+
+	if ((from != NULL) && (from->trace != 0))
+	{
+		ctx.trace = from->trace;
+		parent = from->span;
+	}
+	else if (spans.depth > 0)
+	{
+		int top = (spans.depth < TRACE_DEPTH) ? spans.depth - 1 : TRACE_DEPTH - 1;
+
+		ctx.trace = spans.stack[top].ctx.trace;
+		parent = spans.stack[top].ctx.span;
+	}
+	else
+		ctx.trace = trace_id();
+	ctx.span = trace_id();
+
+	/* Too deep: count it, but do not record it. */
+	if (spans.depth++ >= TRACE_DEPTH)
+		return (ctx.span);
+
+	spans.stack[spans.depth - 1].ctx = ctx;
+	spans.stack[spans.depth - 1].parent = parent;
+	memcpy(spans.stack[spans.depth - 1].name, buf, TRACE_NAME_MAX);
+
+	trace_record(TRACE_BEGIN, &ctx, parent, buf);
+	noc_trace_set(&ctx);
+
+	return (ctx.span);
+}
+
+/**
+ * @brief Starts a span.
+ *
+ * @details The span is a child of the innermost open span of the
+ * thread, or else the root of a new trace. Until it ends, every
+ * message the thread sends carries its context.
+ *
+ * @param name Span name (truncated to TRACE_NAME_MAX - 1 characters).
+ *
+ * @returns The span ID.
+ */
+uint32_t trace_begin(const char *name)
+{
+	return (trace_open(name, NULL));
+}
+
+/**
+ * @brief Starts a span on behalf of the last message received.
+ *
+ * @details The span is a child of the span that sent the message the
+ * thread received last, so a server calls this right after receiving
+ * a request. Same as trace_begin() if that message was not traced.
+ *
+ * @param name Span name (truncated to TRACE_NAME_MAX - 1 characters).
+ *
+ * @returns The span ID.
+ */
+uint32_t trace_join(const char *name)
+{
+	struct noc_trace from;
+
+	noc_trace_get(&from);
+
+	return (trace_open(name, &from));
+}
+
+/**
+ * @brief Ends the innermost open span of the thread.
+ */
+void trace_end(void)
+{
+	if (spans.depth == 0)
+		return;
+
+	if (--spans.depth < TRACE_DEPTH)
+	{
+		trace_record(TRACE_END, &spans.stack[spans.depth].ctx,
+			spans.stack[spans.depth].parent, spans.stack[spans.depth].name);
+	}
+
+	if (spans.depth == 0)
+		noc_trace_set(NULL);
+	else if (spans.depth <= TRACE_DEPTH)
+		noc_trace_set(&spans.stack[spans.depth - 1].ctx);
+}
+
+/**
+ * @brief Empties the event ring.
+ */
+void trace_reset(void)
+{
+	__atomic_store_n(&trace.head, 0, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Dumps the event ring, oldest first.
+ *
+ * @details One event per line, in the format that the trace-stitch.sh
+ * host tool reads. Spans still open are dumped as they are. Only the
+ * events of the calling process are in the ring.
+ *
+ * @param f Output stream.
+ *
+ * @returns The number of events dumped.
+ */
+int trace_dump(FILE *f)
+{
+	uint32_t head = __atomic_load_n(&trace.head, __ATOMIC_RELAXED);
+	uint32_t first = (head > TRACE_RING) ? head - TRACE_RING : 0;
+
+	for (uint32_t i = first; i < head; i++)
+	{
+		const struct trace_event *ev = &trace.ring[i % TRACE_RING];
+
+		fprintf(f, "trace tile=%d time=%" PRIu64 " ev=%c trace=%08" PRIx32
+			" span=%08" PRIx32 " parent=%08" PRIx32 " name=%s\n",
+			noc_tile(), ev->time, ev->type, ev->trace, ev->span, ev->parent, ev->name);
+	}
+
+	return (head - first);
+}
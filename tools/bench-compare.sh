@@ -0,0 +1,127 @@
+#
+# Compares the benchmark numbers of runs.
+#
+# Reads the console logs of tools/runbench.sh. Benchmark lines are
+# "name [word...] key=value...": fields whose key names a time (_ns,
+# _us, _ms) or a rate (_sec, mops, kbps) are the numbers, averaged over
+# the lines of the same name and parameters, and the other fields are
+# the parameters. Runs are named after their logs, and every run after
+# the first gets a gain column: positive when it is faster than the
+# first one.
+#
+
+#==============================================================================
+# usage()
+#==============================================================================
+
+#
+# Prints script usage and exits.
+#
+function usage
+{
+	echo "bench-compare.sh <base log> <log>..."
+	exit 2
+}
+
+#==============================================================================
+# compare()
+#==============================================================================
+
+#
+# Compares logs.
+#
+function compare
+{
+	awk '
+	# Accumulates the numbers of a line.
+	function parse(    i, kv, label, n, keys)
+	{
+		label = $1
+		n = 0
+		for (i = 2; i <= NF; i++)
+		{
+			if ((split($i, kv, "=") == 2) && (kv[1] ~ /(_ns|_us|_ms|_sec|mops|kbps)$/))
+				keys[n++] = $i
+			else
+				label = label " " $i
+		}
+
+		for (i = 0; i < n; i++)
+		{
+			split(keys[i], kv, "=")
+			add(label " " kv[1], kv[2] + 0, kv[1] !~ /(_ns|_us|_ms)$/)
+		}
+	}
+
+	# Accumulates a sample.
+	function add(key, val, rate)
+	{
+		if (!(key in seen))
+		{
+			seen[key] = 1
+			higher[key] = rate
+			order[nkeys++] = key
+		}
+		sum[file, key] += val
+		cnt[file, key]++
+	}
+
+	# Prints a row.
+	function row(key,    b, n, i)
+	{
+		if (!((0, key) in cnt))
+			return
+
+		b = sum[0, key]/cnt[0, key]
+		printf("%-56s %12.0f", key, b)
+		for (i = 1; i < nfiles; i++)
+		{
+			if (!((i, key) in cnt))
+			{
+				printf(" %12s %8s", "-", "-")
+				continue
+			}
+			n = sum[i, key]/cnt[i, key]
+			printf(" %12.0f %+7.1f%%", n, (b > 0) ? 100*(higher[key] ? n - b : b - n)/b : 0)
+		}
+		printf("\n")
+	}
+
+	# Names a run after its log.
+	function name(path,    n, parts)
+	{
+		n = split(path, parts, "/")
+		sub(/\.log$/, "", parts[n])
+		return (parts[n])
+	}
+
+	FNR == 1 { file = nfiles++ }
+
+	/^[a-z]+ .*[a-z_]+=/ && !/^gcda / { parse() }
+
+	END {
+		printf("%-56s %12s", "benchmark", name(ARGV[1]))
+		for (i = 1; i < nfiles; i++)
+			printf(" %12s %8s", name(ARGV[i + 1]), "gain")
+		printf("\n")
+		for (i = 0; i < nkeys; i++)
+			row(order[i])
+	}' "$@"
+}
+
+#==============================================================================
+# MAIN
+#==============================================================================
+
+if [ $# -lt 2 ]; then
+	usage
+fi
+
+for log in "$@"; do
+	if [ ! -s "$log" ]; then
+		echo "bench-compare.sh: $log: empty or missing"
+		exit 1
+	fi
+done
+
+compare "$@"
@@ -0,0 +1,126 @@
+#
+# Compares the boot reports of two builds.
+#
+# Reports are the "boot ... mark=..." lines printed by init at the end
+# of boot, and may be interleaved with anything else, as in a console
+# log. Times are averaged over the tiles (and over the boots, if a log
+# has several). A marker that got slower by more than the threshold,
+# both in percent and in microseconds, is flagged as a regression, and
+# the script then exits with status 1.
+#
+
+# Regression thresholds.
+PCT=10
+MIN_US=1000
+
+#==============================================================================
+# usage()
+#==============================================================================
+
+#
+# Prints script usage and exits.
+#
+function usage
+{
+	echo "boot-compare.sh [-p percent] [-m min_us] <base log> <new log>"
+	exit 2
+}
+
+#==============================================================================
+# compare()
+#==============================================================================
+
+#
+# Compares two logs.
+#
+function compare
+{
+	awk -v pct="$PCT" -v min_us="$MIN_US" '
+	# Reads the key=value fields of a line.
+	function parse(    i, kv)
+	{
+		split("", f)
+		for (i = 2; i <= NF; i++)
+		{
+			split($i, kv, "=")
+			f[kv[1]] = kv[2]
+		}
+	}
+
+	# Accumulates a sample.
+	function add(key, val)
+	{
+		if (!(key in seen))
+		{
+			seen[key] = 1
+			order[nkeys++] = key
+		}
+		sum[file, key] += val
+		cnt[file, key]++
+	}
+
+	# Prints a row and flags regressions.
+	function row(key,    b, n, d)
+	{
+		if (!(((0, key) in cnt) && ((1, key) in cnt)))
+		{
+			printf("%-32s %12s %12s %12s %8s\n", key,
+				((0, key) in cnt) ? sprintf("%.0f", sum[0, key]/cnt[0, key]) : "-",
+				((1, key) in cnt) ? sprintf("%.0f", sum[1, key]/cnt[1, key]) : "-", "-", "-")
+			return
+		}
+
+		b = sum[0, key]/cnt[0, key]
+		n = sum[1, key]/cnt[1, key]
+		d = n - b
+		printf("%-32s %12.0f %12.0f %+12.0f %+7.1f%%%s\n", key, b, n, d,
+			(b > 0) ? 100*d/b : 0,
+			((d > min_us) && (b > 0) && (100*d/b > pct)) ? "  REGRESSION" : "")
+		if ((d > min_us) && (b > 0) && (100*d/b > pct))
+			regressions++
+	}
+
+	FNR == 1 { file = (FILENAME == ARGV[1]) ? 0 : 1 }
+
+	/^boot .* mark=/ {
+		parse()
+		add(f["mark"], f["t_us"] + 0)
+		if ("dur_us" in f)
+			add(f["mark"] " (dur)", f["dur_us"] + 0)
+	}
+
+	/^boot .* total_us=/ {
+		parse()
+		add("total", f["total_us"] + 0)
+	}
+
+	END {
+		printf("%-32s %12s %12s %12s %8s\n", "marker", "base_us", "new_us", "delta_us", "delta")
+		for (i = 0; i < nkeys; i++)
+			row(order[i])
+		if (regressions > 0)
+		{
+			printf("%d regression(s)\n", regressions)
+			exit 1
+		}
+	}' "$1" "$2"
+}
+
+#==============================================================================
+# MAIN
+#==============================================================================
+
+while getopts "p:m:h" opt; do
+	case $opt in
+		p) PCT=$OPTARG ;;
+		m) MIN_US=$OPTARG ;;
+		*) usage ;;
+	esac
+done
+shift $((OPTIND - 1))
+
+if [ $# -ne 2 ]; then
+	usage
+fi
+
+compare "$1" "$2"
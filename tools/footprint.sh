@@ -0,0 +1,113 @@
+#
+# Reports the footprint of every userland binary.
+#
+# For each program (and shared library), prints the sizes of its text, data and bss, which
+# are what it costs in tile RAM, the size of the binary before and
+# after stripping, and the size it adds to the compressed initramfs,
+# which is what it costs in boot time. Unstripped binaries are looked
+# up in the build directory, and stripped ones in the staging directory
+# of the initramfs. With -k, the kernel image is sized as well, out of
+# the totals.
+#
+
+# Size tool.
+SIZE=${SIZE:-size}
+
+#==============================================================================
+# usage()
+#==============================================================================
+
+#
+# Prints script usage and exits.
+#
+function usage
+{
+	echo "footprint.sh [-k vmlinux] <unstripped dir> <rootfs> [initramfs.cpio.gz]"
+	exit 2
+}
+
+#==============================================================================
+# installed()
+#==============================================================================
+
+#
+# Prints the path of a program in the staging directory.
+#
+function installed
+{
+	local name=$1
+
+	if [ -f "$root/$name" ]; then
+		echo "$root/$name"
+	else
+		echo "$root/bin/$name"
+	fi
+}
+
+#==============================================================================
+# MAIN
+#==============================================================================
+
+kernel=
+while getopts "k:h" opt; do
+	case $opt in
+		k) kernel=$OPTARG ;;
+		*) usage ;;
+	esac
+done
+shift $((OPTIND - 1))
+
+if [ $# -lt 2 ] || [ ! -d "$1" ] || [ ! -d "$2" ]; then
+	usage
+fi
+
+bins=$1
+root=$2
+initrd=$3
+
+printf "%-16s %10s %8s %8s %12s %10s %8s\n" \
+	"binary" "text" "data" "bss" "unstripped" "stripped" "gzip"
+
+# Programs, and the shared libraries of dynamically linked ones.
+(
+	for bin in "$bins"/*; do
+		name=$(basename "$bin")
+		file=$(installed "$name")
+
+		if [ ! -f "$file" ]; then
+			continue
+		fi
+
+		echo "$name $($SIZE "$file" | awk 'NR == 2 { print $1, $2, $3 }')" \
+			"$(stat -c %s "$bin") $(stat -c %s "$file") $(gzip -9n < "$file" | wc -c)"
+	done
+
+	for file in "$root"/lib/*; do
+		if [ ! -f "$file" ]; then
+			continue
+		fi
+
+		echo "$(basename "$file") $($SIZE "$file" | awk 'NR == 2 { print $1, $2, $3 }')" \
+			"$(stat -c %s "$file") $(stat -c %s "$file") $(gzip -9n < "$file" | wc -c)"
+	done
+) | awk '
+	{
+		printf("%-16s %10d %8d %8d %12d %10d %8d\n", $1, $2, $3, $4, $5, $6, $7)
+		for (i = 2; i <= 7; i++)
+			total[i] += $i
+	}
+
+	END {
+		printf("%-16s %10d %8d %8d %12d %10d %8d\n", "total",
+			total[2], total[3], total[4], total[5], total[6], total[7])
+	}'
+
+if [ -n "$kernel" ] && [ -e "$kernel" ]; then
+	echo "vmlinux $($SIZE "$kernel" | awk 'NR == 2 { print $1, $2, $3 }')" \
+		"$(stat -L -c %s "$kernel") $(stat -L -c %s "$kernel") $(gzip -9n < "$kernel" | wc -c)" |
+		awk '{ printf("%-16s %10d %8d %8d %12d %10d %8d\n", $1, $2, $3, $4, $5, $6, $7) }'
+fi
+
+if [ -n "$initrd" ] && [ -e "$initrd" ]; then
+	echo "initramfs: $(stat -L -c %s "$initrd") bytes"
+fi
@@ -0,0 +1,179 @@
+#
+# Builds the kernel out of tree, with a cache of kernel images.
+#
+# Objects live in one O= directory per defconfig, KCFLAGS and KCC (a
+# compiler command replacing the kernel's own), named after a hash of
+# them, so switching configurations does not throw objects away. Images
+# are cached under a key made of the actual .config, KCFLAGS, KCC, the
+# source revision, uncommitted changes to the source and, when userland is
+# embedded, the embedded tree: when nothing relevant changed, the
+# cached image is reused and the kernel build system is not even run.
+#
+# Runs from the top-level makefile, which passes its jobserver down;
+# when make was not given -j, the build uses every CPU.
+#
+
+# Kernel tree.
+LINUX=${LINUX:-linux}
+
+# Kernel build directory.
+KBUILD_DIR=${KBUILD_DIR:-build/kernel}
+
+# Configuration.
+DEFCONFIG=${DEFCONFIG:-optimsoc_defconfig}
+
+# Images kept.
+KEEP=8
+
+#==============================================================================
+# usage()
+#==============================================================================
+
+#
+# Prints script usage and exits.
+#
+function usage
+{
+	echo "kbuild.sh [-o image] [-e embedded dir] [defconfig | vmlinux | target...]"
+	exit 2
+}
+
+#==============================================================================
+# hash()
+#==============================================================================
+
+#
+# Hashes the standard input.
+#
+function hash
+{
+	sha256sum | cut -c1-16
+}
+
+#==============================================================================
+# kmake()
+#==============================================================================
+
+#
+# Runs the kernel build system out of tree.
+#
+function kmake
+{
+	local jobs=
+
+	case " $MAKEFLAGS" in
+		*jobserver*|*" -j"*) ;;
+		*) jobs=-j$(nproc) ;;
+	esac
+
+	make -C "$LINUX" O="$obj" $jobs ${KCC:+CC="$KCC"} "$@"
+}
+
+#==============================================================================
+# configure()
+#==============================================================================
+
+#
+# Generates the configuration of the build directory.
+#
+function configure
+{
+	local src
+
+	kmake "$DEFCONFIG" || exit 1
+
+	# A relative initramfs source would be looked up in the build directory.
+	src=$(sed -n 's/^CONFIG_INITRAMFS_SOURCE="\([^/].*\)"$/\1/p' "$obj/.config")
+	if [ -n "$src" ]; then
+		"$LINUX/scripts/config" --file "$obj/.config" \
+			--set-str INITRAMFS_SOURCE "$(cd "$LINUX" && pwd)/$src" || exit 1
+		kmake olddefconfig || exit 1
+	fi
+}
+
+#==============================================================================
+# key()
+#==============================================================================
+
+#
+# Prints the cache key of the image that would be built.
+#
+function key
+{
+	(
+		cat "$obj/.config"
+		echo "KCFLAGS=$KCFLAGS KCC=$KCC"
+		git -C "$LINUX" rev-parse HEAD 2>/dev/null || echo "no revision"
+		git -C "$LINUX" diff HEAD 2>/dev/null
+		git -C "$LINUX" ls-files -z --others --exclude-standard 2>/dev/null |
+			(cd "$LINUX" && xargs -0 -r cat)
+		if [ -n "$embed" ]; then
+			(cd "$embed" && find . -type f | LC_ALL=C sort | xargs -r sha256sum)
+		fi
+	) | hash
+}
+
+#==============================================================================
+# MAIN
+#==============================================================================
+
+out=
+embed=
+while getopts "o:e:h" opt; do
+	case $opt in
+		o) out=$OPTARG ;;
+		e) embed=$OPTARG ;;
+		*) usage ;;
+	esac
+done
+shift $((OPTIND - 1))
+
+targets=${@:-vmlinux}
+
+cfg=$LINUX/arch/$ARCH/configs/$DEFCONFIG
+if [ ! -f "$cfg" ]; then
+	echo "kbuild.sh: $cfg not found"
+	exit 1
+fi
+
+mkdir -p "$KBUILD_DIR/cache" || exit 1
+obj=$(cd "$KBUILD_DIR" && pwd)/obj-$( (cat "$cfg"; echo "KCFLAGS=$KCFLAGS KCC=$KCC") | hash)
+mkdir -p "$obj" || exit 1
+
+# O= builds need a clean source tree.
+if [ -f "$LINUX/.config" ]; then
+	echo "kbuild.sh: $LINUX holds an in-tree build, run 'make -C $LINUX mrproper' once"
+	exit 1
+fi
+
+if [ "$targets" == "defconfig" ]; then
+	configure
+	exit
+fi
+
+if [ ! -f "$obj/.config" ]; then
+	configure
+fi
+
+if [ "$targets" != "vmlinux" ]; then
+	kmake $targets
+	exit
+fi
+
+image=$KBUILD_DIR/cache/vmlinux-$(key)
+if [ -f "$image" ]; then
+	status=cached
+else
+	kmake vmlinux || exit 1
+	cp "$obj/vmlinux" "$image.tmp" && mv "$image.tmp" "$image" || exit 1
+	status=built
+fi
+
+touch "$image"
+ls -t "$KBUILD_DIR"/cache/vmlinux-* | tail -n +$((KEEP + 1)) | xargs -r rm -f
+
+if [ -n "$out" ]; then
+	ln -sfn "$(cd "$(dirname "$image")" && pwd)/$(basename "$image")" "$out"
+fi
+
+echo "kernel: $(basename "$image") ($status)"
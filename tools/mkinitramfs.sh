@@ -0,0 +1,111 @@
+#
+# Packs a userland staging directory into a compressed initramfs.
+#
+# The archive is named after a hash of its contents and kept in the
+# output directory, so packing an unchanged tree again costs a hash and
+# nothing else, and switching back and forth between builds reuses
+# their archives. The output path is a symbolic link to the archive in
+# use. Only the last few archives are kept.
+#
+# Archives are built with the gen_init_cpio tool of the kernel tree,
+# with every file owned by root and a fixed timestamp, so the same tree
+# always gives the same archive. /dev/console is added, since the kernel
+# opens it for init before anything else runs.
+#
+
+# Kernel tree.
+LINUX=${LINUX:-linux}
+
+# Host compiler.
+HOSTCC=${HOSTCC:-cc}
+
+# Archives kept.
+KEEP=4
+
+#==============================================================================
+# usage()
+#==============================================================================
+
+#
+# Prints script usage and exits.
+#
+function usage
+{
+	echo "mkinitramfs.sh <rootfs> <initramfs.cpio.gz>"
+	exit 2
+}
+
+#==============================================================================
+# cpio_list()
+#==============================================================================
+
+#
+# Writes the gen_init_cpio list of a directory.
+#
+function cpio_list
+{
+	local root=$1
+
+	echo "dir /dev 0755 0 0"
+	echo "nod /dev/console 0600 0 0 c 5 1"
+
+	(cd "$root" && find . -mindepth 1 | LC_ALL=C sort) | while read -r path; do
+		local name=${path#.}
+		local file=$root$name
+		local mode=$(stat -c %a "$file")
+
+		if [ -L "$file" ]; then
+			echo "slink $name $(readlink "$file") $mode 0 0"
+		elif [ -d "$file" ] && [ "$name" != "/dev" ]; then
+			echo "dir $name $mode 0 0"
+		elif [ -f "$file" ]; then
+			echo "file $name $file $mode 0 0"
+		fi
+	done
+}
+
+#==============================================================================
+# MAIN
+#==============================================================================
+
+if [ $# -ne 2 ] || [ ! -d "$1" ]; then
+	usage
+fi
+
+root=$(cd "$1" && pwd)
+out=$2
+outdir=$(dirname "$out")
+tool=$outdir/host/gen_init_cpio
+
+mkdir -p "$outdir/host" || exit 1
+
+list=$(cpio_list "$root") || exit 1
+
+# Hash of the list and of every file in it, in order.
+hash=$( (echo "$list"; echo "$list" | awk '$1 == "file" { print $3 }' |
+	while read -r file; do cat "$file"; done) | sha256sum | cut -c1-16)
+archive=$outdir/initramfs-$hash.cpio.gz
+
+if [ -f "$archive" ]; then
+	status=cached
+else
+	if [ ! -x "$tool" ] || [ "$LINUX/usr/gen_init_cpio.c" -nt "$tool" ]; then
+		$HOSTCC -O2 "$LINUX/usr/gen_init_cpio.c" -o "$tool" || exit 1
+	fi
+
+	echo "$list" > "$archive.list"
+	if ! "$tool" -t 0 "$archive.list" | gzip -9n > "$archive.tmp"; then
+		rm -f "$archive.list" "$archive.tmp"
+		exit 1
+	fi
+	rm -f "$archive.list"
+	mv "$archive.tmp" "$archive"
+	status=built
+fi
+
+# Point the output at it, and drop the oldest archives.
+touch "$archive"
+ln -sfn "$(basename "$archive")" "$out"
+ls -t "$outdir"/initramfs-*.cpio.gz | tail -n +$((KEEP + 1)) | xargs -r rm -f
+
+echo "initramfs: $out -> $(basename "$archive") ($status, $(stat -c %s "$archive") bytes)"
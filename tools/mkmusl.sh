@@ -0,0 +1,103 @@
+#
+# Builds the static C library of the musl toolchain.
+#
+# The or1k-linux-musl sysroot ships libc.so but no libc.a, so nothing
+# links statically against it. This builds musl, of the release that
+# libc.so comes from, from a source tree or a release tarball, and
+# installs libc.a next to libc.so. Headers and start files are left as
+# shipped, since they come from the same release; other releases are
+# refused.
+#
+# With -f, musl is built with extra compiler flags, for code generation
+# modes the toolchain has no multilib for, and libc.a is installed with
+# the start files of the mode into the directory given with -d.
+#
+
+# Musl compiler.
+CC=${CC:-or1k-linux-musl-gcc}
+
+# Musl sysroot.
+SYSROOT=${SYSROOT:-tools/toolchain/or1k-linux-musl/or1k-linux-musl}
+
+# Build directory.
+BUILDDIR=${BUILDDIR:-build}
+
+#==============================================================================
+# usage()
+#==============================================================================
+
+#
+# Prints script usage and exits.
+#
+function usage
+{
+	echo "mkmusl.sh [-f cflags -d dir] <musl source dir | musl-x.y.z.tar.gz>"
+	exit 2
+}
+
+#==============================================================================
+# MAIN
+#==============================================================================
+
+flags=
+dest=
+while getopts "f:d:h" opt; do
+	case $opt in
+		f) flags=$OPTARG ;;
+		d) dest=$OPTARG ;;
+		*) usage ;;
+	esac
+done
+shift $((OPTIND - 1))
+
+if [ $# -ne 1 ] || [ ! -e "$1" ] || { [ -n "$flags" ] && [ -z "$dest" ]; }; then
+	usage
+fi
+
+src=$1
+dir=$BUILDDIR/musl
+files=libc.a
+if [ -n "$flags" ]; then
+	files="libc.a crt1.o crti.o crtn.o"
+fi
+dest=${dest:-$SYSROOT/lib}
+
+version=$(tr -c '[:print:]' '\n' < "$SYSROOT/lib/libc.so" |
+	grep -m1 -x '[0-9][0-9]*\.[0-9][0-9]*\.[0-9][0-9]*')
+if [ -z "$version" ]; then
+	echo "mkmusl.sh: cannot tell the musl release of $SYSROOT/lib/libc.so"
+	exit 1
+fi
+
+# Release 1.1.16 does not build out of tree: build in a copy.
+rm -rf "$dir"
+mkdir -p "$dir" || exit 1
+if [ -d "$src" ]; then
+	cp -a "$src/." "$dir/" || exit 1
+else
+	tar -xzf "$src" -C "$dir" --strip-components=1 || exit 1
+fi
+
+if [ "$(cat "$dir/VERSION" 2>/dev/null)" != "$version" ]; then
+	echo "mkmusl.sh: $src is not musl $version, the release of the sysroot"
+	exit 1
+fi
+
+# Userland flags and tools of the top-level makefile are not for libc.
+unset CFLAGS CPPFLAGS LDFLAGS AR MAKEFLAGS
+export CROSS_COMPILE=${CC%gcc}
+
+cd "$dir" &&
+	CFLAGS="$flags" ./configure --target=or1k-linux-musl --prefix=/ --disable-shared CC="$CC" > configure.log &&
+	make -j$(nproc) $(for file in $files; do echo lib/$file; done) > make.log 2>&1 || {
+		echo "mkmusl.sh: build failed, see $dir/*.log"
+		exit 1
+	}
+cd - > /dev/null
+
+mkdir -p "$dest" || exit 1
+for file in $files; do
+	cp "$dir/lib/$file" "$dest/$file.tmp" && mv "$dest/$file.tmp" "$dest/$file" || exit 1
+done
+
+echo "musl: $dest/libc.a ($version${flags:+, $flags}, $(stat -c %s "$dest/libc.a") bytes)"
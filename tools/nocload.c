@@ -0,0 +1,383 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Host-side load generator for the NoC bridge. Built with the host
+ * compiler (make hosttools), not the cross toolchain.
+ */
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <bridge.h>
+
+/**
+ * @brief Default socket, as set up by tools/run.sh.
+ */
+#define NOCLOAD_SOCKET "noc-bridge.sock"
+
+/**
+ * @brief Gives up on outstanding messages after this long (in ms).
+ */
+#define NOCLOAD_TIMEOUT_MS 2000
+
+/**
+ * @brief Payload of a load message.
+ */
+struct nocload_msg
+{
+	uint32_t seq;   /**< Sequence number.     */
+	uint32_t pad;   /**< Unused.              */
+	uint64_t time;  /**< Send time (ns).      */
+};
+
+/**
+ * @brief Load generator state.
+ */
+static struct
+{
+	int fd;                       /**< Bridge socket.            */
+	int ntiles;                   /**< Tiles to load.            */
+	int first;                    /**< First tile to load.       */
+	uint32_t nmsgs;               /**< Messages to send.         */
+	size_t len;                   /**< Payload length.           */
+	unsigned batch;               /**< Records per batch.        */
+	unsigned window;              /**< Messages in flight.       */
+	uint32_t sent;                /**< Messages sent.            */
+	uint32_t done;                /**< Echoes received.          */
+	uint64_t *rtt;                /**< Round trip times (ns).    */
+	struct bridge_batch out;      /**< Batch being built.        */
+	struct bridge_reader in;      /**< Stream from the guest.    */
+} load = {
+	.ntiles = 1,
+	.first = 1,
+	.nmsgs = 10000,
+	.len = sizeof(struct nocload_msg),
+	.batch = 64,
+	.window = 256,
+};
+
+/**
+ * @brief Prints usage and exits.
+ */
+static void usage(void)
+{
+	fprintf(stderr, "usage: nocload [-s socket] [-f first] [-t ntiles] [-n msgs] [-l len] [-b batch] [-w window]\n");
+	fprintf(stderr, "       nocload [-s socket] -c\n");
+	exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Exits on error.
+ */
+static void die(const char *msg)
+{
+	perror(msg);
+	exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Reads the host clock (in nanoseconds).
+ */
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((uint64_t) ts.tv_sec*1000000000 + ts.tv_nsec);
+}
+
+/**
+ * @brief Connects to the bridge socket.
+ */
+static int connect_bridge(const char *path)
+{
+	int fd;
+	struct sockaddr_un addr;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+	{
+		errno = ENAMETOOLONG;
+		return (-1);
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+		return (-1);
+
+	if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0)
+	{
+		close(fd);
+		return (-1);
+	}
+
+	return (fd);
+}
+
+/**
+ * @brief Compares round trip times.
+ */
+static int cmp_rtt(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *) a;
+	uint64_t y = *(const uint64_t *) b;
+
+	return ((x > y) - (x < y));
+}
+
+/**
+ * @brief Sends as much of the load as the window allows.
+ */
+static void send_load(void)
+{
+	static uint8_t buf[NOC_MSG_MAX];
+	struct nocload_msg *msg = (struct nocload_msg *) buf;
+
+	while ((load.sent < load.nmsgs) && (load.sent - load.done < load.window))
+	{
+		msg->seq = load.sent;
+		msg->time = now_ns();
+
+		if ((load.out.count >= load.batch) ||
+			(bridge_batch_add(&load.out, load.first + load.sent % load.ntiles,
+				NOC_PORT_BRIDGE, buf, load.len) < 0))
+		{
+			if (bridge_batch_flush(&load.out, load.fd) < 0)
+				die("write");
+			continue;
+		}
+
+		load.sent++;
+	}
+
+	if (bridge_batch_flush(&load.out, load.fd) < 0)
+		die("write");
+}
+
+/**
+ * @brief Receives echoes.
+ *
+ * @returns Zero upon success, and -1 if nothing came back in time.
+ */
+static int recv_load(void)
+{
+	int tile, port, ret;
+	size_t len;
+	ssize_t n;
+	const void *data;
+	struct pollfd pfd = { .fd = load.fd, .events = POLLIN };
+
+	if ((ret = poll(&pfd, 1, NOCLOAD_TIMEOUT_MS)) < 0)
+		return ((errno == EINTR) ? 0 : -1);
+	if (ret == 0)
+		return (-1);
+
+	if ((n = bridge_read(&load.in, load.fd)) <= 0)
+	{
+		if (n == 0)
+			errno = ECONNRESET;
+		die("read");
+	}
+
+	while ((data = bridge_next(&load.in, &tile, &port, &len)) != NULL)
+	{
+		struct nocload_msg msg;
+
+		if ((port != NOC_PORT_BRIDGE) || (len < sizeof(msg)))
+			continue;
+
+		memcpy(&msg, data, sizeof(msg));
+		if ((msg.seq >= load.sent) || (load.rtt[msg.seq] != 0))
+			continue;
+
+		load.rtt[msg.seq] = now_ns() - msg.time;
+		load.done++;
+	}
+
+	return (0);
+}
+
+/**
+ * @brief Runs the load and reports it.
+ */
+static void run_load(void)
+{
+	uint64_t start, elapsed;
+	uint64_t sum = 0;
+	uint32_t n = 0;
+
+	if ((load.rtt = calloc(load.nmsgs, sizeof(uint64_t))) == NULL)
+		die("calloc");
+
+	start = now_ns();
+	while (load.done < load.nmsgs)
+	{
+		send_load();
+		if (recv_load() < 0)
+			break;
+	}
+	elapsed = now_ns() - start;
+
+	/* Lost messages have no round trip time. */
+	for (uint32_t i = 0; i < load.sent; i++)
+	{
+		if (load.rtt[i] != 0)
+		{
+			load.rtt[n++] = load.rtt[i];
+			sum += load.rtt[i];
+		}
+	}
+	qsort(load.rtt, n, sizeof(uint64_t), cmp_rtt);
+
+	printf("bridge tiles=%d msgs=%" PRIu32 " len=%zu batch=%u window=%u"
+		" lost=%" PRIu32 " batches_in=%" PRIu64 " resyncs=%" PRIu64 "\n",
+		load.ntiles, load.sent, load.len, load.batch, load.window,
+		load.sent - load.done, load.in.batches, load.in.resyncs);
+	printf("bridge msgs_per_s=%.0f mbps=%.2f rtt_avg_us=%.1f rtt_p50_us=%.1f rtt_p99_us=%.1f\n",
+		(elapsed > 0) ? n*1e9/elapsed : 0.0,
+		(elapsed > 0) ? n*load.len*8*1e3/elapsed : 0.0,
+		(n > 0) ? sum/1e3/n : 0.0,
+		(n > 0) ? load.rtt[n/2]/1e3 : 0.0,
+		(n > 0) ? load.rtt[(n*99)/100]/1e3 : 0.0);
+
+	free(load.rtt);
+}
+
+/**
+ * @brief Prints what the guest sends, per tile and port, every second.
+ */
+static void run_collect(void)
+{
+	static uint64_t msgs[256][NOC_STATS_PORTS];
+	static uint64_t bytes[256][NOC_STATS_PORTS];
+	uint64_t last = now_ns();
+	int tile, port;
+	size_t len;
+	ssize_t n;
+
+	while ((n = bridge_read(&load.in, load.fd)) > 0)
+	{
+		while (bridge_next(&load.in, &tile, &port, &len) != NULL)
+		{
+			port = (port < NOC_STATS_PORTS) ? port : NOC_STATS_PORTS - 1;
+			msgs[tile][port]++;
+			bytes[tile][port] += len;
+		}
+
+		if (now_ns() - last < 1000000000)
+			continue;
+		last = now_ns();
+
+		for (tile = 0; tile < 256; tile++)
+		{
+			for (port = 0; port < NOC_STATS_PORTS; port++)
+			{
+				if (msgs[tile][port] == 0)
+					continue;
+				printf("collect tile=%d port=%d msgs=%" PRIu64 " bytes=%" PRIu64 "\n",
+					tile, port, msgs[tile][port], bytes[tile][port]);
+			}
+		}
+		fflush(stdout);
+	}
+
+	if (n < 0)
+		die("read");
+}
+
+/**
+ * @brief Drives NoC traffic from the host through the bridge.
+ *
+ * @details Usage: nocload [-s socket] [-f first] [-t ntiles] [-n msgs]
+ * [-l len] [-b batch] [-w window] | nocload [-s socket] -c
+ *
+ * Sends msgs messages of len bytes, round robin, to tiles first to
+ * first + ntiles - 1, which echo them back (nocbridge -e). At most
+ * window messages are in flight, and at most batch of them share a
+ * batch. With -c, prints what the guest sends to the host instead.
+ */
+int main(int argc, char **argv)
+{
+	int opt;
+	int collect = 0;
+	const char *path = NOCLOAD_SOCKET;
+
+	while ((opt = getopt(argc, argv, "s:f:t:n:l:b:w:c")) != -1)
+	{
+		switch (opt)
+		{
+			case 's':
+				path = optarg;
+				break;
+			case 'f':
+				load.first = atoi(optarg);
+				break;
+			case 't':
+				load.ntiles = atoi(optarg);
+				break;
+			case 'n':
+				load.nmsgs = strtoul(optarg, NULL, 0);
+				break;
+			case 'l':
+				load.len = strtoul(optarg, NULL, 0);
+				break;
+			case 'b':
+				load.batch = strtoul(optarg, NULL, 0);
+				break;
+			case 'w':
+				load.window = strtoul(optarg, NULL, 0);
+				break;
+			case 'c':
+				collect = 1;
+				break;
+			default:
+				usage();
+		}
+	}
+
+	if ((load.first < 0) || (load.ntiles < 1) || (load.first + load.ntiles > 256) ||
+		(load.len < sizeof(struct nocload_msg)) || (load.len > NOC_MSG_MAX) ||
+		(load.nmsgs == 0) || (load.batch == 0) || (load.window == 0))
+		usage();
+
+	if ((load.fd = connect_bridge(path)) < 0)
+		die(path);
+
+	bridge_batch_init(&load.out);
+	bridge_reader_init(&load.in);
+
+	if (collect)
+		run_collect();
+	else
+		run_load();
+
+	close(load.fd);
+
+	return (EXIT_SUCCESS);
+}
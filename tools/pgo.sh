@@ -0,0 +1,147 @@
+#
+# Profile-guided optimization of userland.
+#
+# Builds userland instrumented and boots it in QEMU with the training
+# workload of init/bench.conf, which ends with gcdadump printing the
+# profiles on the console. The profiles are extracted from the console
+# log, and userland is then measured with the same workload, built
+# without and with them. Leaves the tree built with the profiles, and
+# prints the benchmark numbers of both builds side by side: gain is
+# positive when the profiled build is faster.
+#
+# Runs from the top of the tree. Every build goes through make, so the
+# kernel image is the cached one and only userland is rebuilt.
+#
+
+# Work directory: logs and profiles.
+PGO_DIR=${PGO_DIR:-build/pgo}
+
+# Time allowed for a run (in seconds).
+TIMEOUT=900
+
+#==============================================================================
+# usage()
+#==============================================================================
+
+#
+# Prints script usage and exits.
+#
+function usage
+{
+	echo "pgo.sh [-t timeout] [make arguments...]"
+	exit 2
+}
+
+#==============================================================================
+# build()
+#==============================================================================
+
+#
+# Builds the kernel and userland, with the given profiling mode.
+#
+function build
+{
+	local mode=$1
+
+	echo "pgo: building ${mode:-plain} userland"
+	if ! make PGO=$mode PGODIR="$profile" MANIFEST=init/bench.conf EMBED= \
+		"${MAKEARGS[@]}" all > "$PGO_DIR/make-${mode:-plain}.log" 2>&1; then
+		echo "pgo.sh: build failed, see $PGO_DIR/make-${mode:-plain}.log"
+		exit 1
+	fi
+}
+
+#==============================================================================
+# run()
+#==============================================================================
+
+#
+# Boots the current build with the workload, logging the console.
+#
+function run
+{
+	echo "pgo: running $(basename "$1" .log)"
+	bash tools/runbench.sh -t $TIMEOUT "$1" || exit 1
+}
+
+#==============================================================================
+# extract()
+#==============================================================================
+
+#
+# Extracts the profiles printed by gcdadump from a console log.
+#
+function extract
+{
+	local log=$1
+	local tag op arg size file bytes n=0
+
+	rm -rf "$profile"
+	mkdir -p "$profile" || exit 1
+
+	while read -r tag op arg size; do
+		if [ "$tag" != "gcda" ]; then
+			continue
+		fi
+
+		case $op in
+			begin)
+				case "/$arg/" in
+					*/../*) echo "pgo.sh: bad profile path $arg"; exit 1 ;;
+				esac
+				file=$profile/$arg
+				bytes=$size
+				mkdir -p "$(dirname "$file")" || exit 1
+				: > "$file.b64"
+				;;
+			+)
+				echo "$arg" >> "$file.b64"
+				;;
+			end)
+				if ! base64 -d "$file.b64" > "$file" || [ "$(stat -c %s "$file")" != "$bytes" ]; then
+					echo "pgo.sh: $arg: corrupted profile"
+					exit 1
+				fi
+				rm -f "$file.b64"
+				n=$((n + 1))
+				;;
+			done)
+				echo "pgo: $n profiles, $arg $size"
+				;;
+		esac
+	done < "$log"
+
+	if [ $n -eq 0 ]; then
+		echo "pgo.sh: no profiles in $log"
+		exit 1
+	fi
+}
+
+#==============================================================================
+# MAIN
+#==============================================================================
+
+while getopts "t:h" opt; do
+	case $opt in
+		t) TIMEOUT=$OPTARG ;;
+		*) usage ;;
+	esac
+done
+shift $((OPTIND - 1))
+
+MAKEARGS=("$@")
+
+mkdir -p "$PGO_DIR" || exit 1
+profile=$(cd "$PGO_DIR" && pwd)/profile
+
+build gen
+run "$PGO_DIR/train.log"
+extract "$PGO_DIR/train.log"
+
+build
+run "$PGO_DIR/plain.log"
+
+build use
+run "$PGO_DIR/pgo.log"
+
+bash tools/bench-compare.sh "$PGO_DIR/plain.log" "$PGO_DIR/pgo.log" | tee "$PGO_DIR/report.txt"
@@ -1,9 +1,24 @@
 export PATH=tools/toolchain/qemu/bin/:$PATH
 
-qemu-system-or1k \
+# Set NOC_BRIDGE to a socket path to wire the second UART to the host
+# (see utils/nocbridge and tools/nocload.c).
+
+# Userland, unless embedded into the kernel (make EMBED=1). Set INITRD
+# to boot another archive, or empty to boot without one.
+INITRD=${INITRD-build/initramfs.cpio.gz}
+if [ -n "$INITRD" ] && [ ! -e "$INITRD" ]; then
+	INITRD=
+fi
+
+# Kernel image, as left by make.
+KERNEL=${KERNEL:-build/vmlinux}
+
+exec qemu-system-or1k \
 	-cpu or1200 \
 	-M or1k-sim \
-	-kernel linux/vmlinux \
+	-kernel $KERNEL \
+	${INITRD:+-initrd $INITRD} \
 	-serial stdio \
+	${NOC_BRIDGE:+-serial unix:$NOC_BRIDGE,server,nowait} \
 	-nographic \
 	-monitor none
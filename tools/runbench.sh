@@ -0,0 +1,63 @@
+#
+# Boots the current build in QEMU and logs its console until the run ends.
+#
+# The build must have been made with MANIFEST=init/bench.conf, whose
+# last service, gcdadump, prints a "gcda done" line whether the build is
+# instrumented or not: the run ends there, or when QEMU exits, or after
+# the timeout. Carriage returns of the console are dropped from the log.
+# Exits with status 1 when the run did not end.
+#
+
+# Time allowed for a run (in seconds).
+TIMEOUT=900
+
+#==============================================================================
+# usage()
+#==============================================================================
+
+#
+# Prints script usage and exits.
+#
+function usage
+{
+	echo "runbench.sh [-t timeout] <log>"
+	exit 2
+}
+
+#==============================================================================
+# MAIN
+#==============================================================================
+
+while getopts "t:h" opt; do
+	case $opt in
+		t) TIMEOUT=$OPTARG ;;
+		*) usage ;;
+	esac
+done
+shift $((OPTIND - 1))
+
+if [ $# -ne 1 ]; then
+	usage
+fi
+
+log=$1
+
+bash tools/run.sh < /dev/null > "$log" 2>&1 &
+pid=$!
+
+for ((i = 0; i < TIMEOUT; i++)); do
+	if grep -q "^gcda done" "$log" || ! kill -0 $pid 2>/dev/null; then
+		break
+	fi
+	sleep 1
+done
+
+kill $pid 2>/dev/null
+wait $pid 2>/dev/null
+
+sed -i 's/\r$//' "$log"
+
+if ! grep -q "^gcda done" "$log"; then
+	echo "runbench.sh: $log: run did not end"
+	exit 1
+fi
@@ -0,0 +1,128 @@
+#
+# Stitches trace events dumped by the tiles into per-request timelines.
+#
+# Events are the "trace ... ev=..." lines written by trace_dump(), and
+# may be interleaved with anything else, as in a console log. Spans are
+# grouped by trace ID, ordered by start time and indented under their
+# parents. Times are relative to the start of each trace.
+#
+
+#==============================================================================
+# usage()
+#==============================================================================
+
+#
+# Prints script usage and exits.
+#
+function usage
+{
+	echo "trace-stitch.sh [log...]"
+	exit
+}
+
+#==============================================================================
+# stitch()
+#==============================================================================
+
+#
+# Stitches events read from the standard input.
+#
+function stitch
+{
+	awk '
+	# Reads the key=value fields of an event.
+	function parse(    i, kv)
+	{
+		for (i = 2; i <= NF; i++)
+		{
+			split($i, kv, "=")
+			f[kv[1]] = kv[2]
+		}
+	}
+
+	# Indentation of a span, two spaces per ancestor in its trace.
+	function indent(s,    str)
+	{
+		for (str = ""; (parent[s] in start) && (trace[parent[s]] == trace[s]); str = str "  ")
+			s = parent[s]
+		return str
+	}
+
+	/^trace .* ev=/ {
+		parse()
+		s = f["span"]
+		if (f["ev"] == "B")
+		{
+			start[s] = f["time"] + 0
+			trace[s] = f["trace"]
+			parent[s] = f["parent"]
+			name[s] = f["name"]
+			tile[s] = f["tile"]
+			if (!(f["trace"] in first))
+			{
+				first[f["trace"]] = start[s]
+				order[ntraces++] = f["trace"]
+			}
+			else if (start[s] < first[f["trace"]])
+				first[f["trace"]] = start[s]
+			spans[f["trace"]] = spans[f["trace"]] " " s
+		}
+		else if (f["ev"] == "E")
+			end[s] = f["time"] + 0
+	}
+
+	END {
+		# Traces by start time.
+		for (i = 1; i < ntraces; i++)
+		{
+			t = order[i]
+			for (j = i - 1; (j >= 0) && (first[order[j]] > first[t]); j--)
+				order[j + 1] = order[j]
+			order[j + 1] = t
+		}
+
+		for (i = 0; i < ntraces; i++)
+		{
+			t = order[i]
+			n = split(spans[t], list, " ")
+
+			# Spans by start time.
+			for (a = 2; a <= n; a++)
+			{
+				s = list[a]
+				for (b = a - 1; (b >= 1) && (start[list[b]] > start[s]); b--)
+					list[b + 1] = list[b]
+				list[b + 1] = s
+			}
+
+			last = first[t]
+			for (a = 1; a <= n; a++)
+			{
+				if ((list[a] in end) && (end[list[a]] > last))
+					last = end[list[a]]
+			}
+
+			printf("trace %s: %d spans, %.1f us\n", t, n, (last - first[t])/1000)
+			for (a = 1; a <= n; a++)
+			{
+				s = list[a]
+				if (s in end)
+					dur = sprintf("%10.1f us", (end[s] - start[s])/1000)
+				else
+					dur = sprintf("%13s", "open")
+				printf("  %10.1f us %s  tile %-2s  %s%s\n",
+					(start[s] - first[t])/1000, dur, tile[s], indent(s), name[s])
+			}
+		}
+	}'
+}
+
+#==============================================================================
+# MAIN
+#==============================================================================
+
+if [ "$1" == "-h" ]; then
+	usage
+fi
+
+cat "$@" | stitch
@@ -0,0 +1,128 @@
+#
+# Benchmarks build variants.
+#
+# Builds the kernel and userland for each value of a make variable (ISA
+# profiles, delay slot modes), boots each build in QEMU with the
+# workload of init/bench.conf, and compares the builds with the first
+# one: code size, from the footprint report, and benchmark numbers.
+# Values given with -b are only built and sized, for builds QEMU cannot
+# run. Kernel images are cached per build, so only the first run of a
+# variant pays for its kernel.
+#
+# Runs from the top of the tree, and leaves it built for the last
+# value. Logs and the report are kept in the work directory.
+#
+
+# Work directory.
+VARIANT_DIR=${VARIANT_DIR:-build/variant}
+
+# Time allowed for a run (in seconds).
+TIMEOUT=900
+
+#==============================================================================
+# usage()
+#==============================================================================
+
+#
+# Prints script usage and exits.
+#
+function usage
+{
+	echo "variantbench.sh [-t timeout] [-b value]... [-m make arg]... <variable> <value>..."
+	exit 2
+}
+
+#==============================================================================
+# build()
+#==============================================================================
+
+#
+# Builds the kernel and userland for a value.
+#
+function build
+{
+	local value=$1
+
+	echo "variant: building $var=$value"
+	if ! make $var=$value "${MAKEARGS[@]}" MANIFEST=init/bench.conf EMBED= \
+		kernel footprint > "$VARIANT_DIR/make-$value.log" 2>&1; then
+		echo "variantbench.sh: build failed, see $VARIANT_DIR/make-$value.log"
+		exit 1
+	fi
+}
+
+#==============================================================================
+# sizes()
+#==============================================================================
+
+#
+# Prints the footprint of every build.
+#
+function sizes
+{
+	local value
+
+	for value in "$@"; do
+		echo "$value" \
+			"$(awk '$1 == "total" { print $2, $3, $4, $6, $7 }' "$VARIANT_DIR/make-$value.log")" \
+			"$(awk '$1 == "vmlinux" { print $2 }' "$VARIANT_DIR/make-$value.log")"
+	done | awk -v var="$var" '
+	{
+		if (NR == 1)
+		{
+			base = $2
+			kbase = $7
+		}
+		printf("%-12s %10d %8d %8d %10d %8d %+7.1f%% %10d %+7.1f%%\n", $1, $2, $3, $4, $5, $6,
+			(base > 0) ? 100*($2 - base)/base : 0, $7, (kbase > 0) ? 100*($7 - kbase)/kbase : 0)
+	}
+
+	BEGIN {
+		printf("%-12s %10s %8s %8s %10s %8s %8s %10s %8s\n",
+			var, "text", "data", "bss", "stripped", "gzip", "text", "kernel", "kernel")
+	}'
+}
+
+#==============================================================================
+# MAIN
+#==============================================================================
+
+MAKEARGS=()
+buildonly=" "
+while getopts "b:m:t:h" opt; do
+	case $opt in
+		b) buildonly="$buildonly$OPTARG " ;;
+		m) MAKEARGS+=("$OPTARG") ;;
+		t) TIMEOUT=$OPTARG ;;
+		*) usage ;;
+	esac
+done
+shift $((OPTIND - 1))
+
+if [ $# -lt 3 ]; then
+	usage
+fi
+
+var=$1
+shift
+
+mkdir -p "$VARIANT_DIR" || exit 1
+
+logs=()
+for value in "$@"; do
+	build $value
+	if [[ "$buildonly" == *" $value "* ]]; then
+		continue
+	fi
+	echo "variant: running $var=$value"
+	bash tools/runbench.sh -t $TIMEOUT "$VARIANT_DIR/$value.log" || exit 1
+	logs+=("$VARIANT_DIR/$value.log")
+done
+
+(
+	sizes "$@"
+	if [ ${#logs[@]} -ge 2 ]; then
+		echo
+		bash tools/bench-compare.sh "${logs[@]}"
+	fi
+) | tee "$VARIANT_DIR/report-$var.txt"
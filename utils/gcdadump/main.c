@@ -0,0 +1,149 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _XOPEN_SOURCE 500
+
+#include <sys/stat.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Default profile directory.
+ */
+#define GCDA_DIR "/pgo"
+
+/**
+ * @brief Bytes encoded per output line.
+ */
+#define GCDA_LINE 57
+
+/**
+ * @brief Dump state.
+ */
+static struct
+{
+	size_t prefix;   /**< Length of the directory name. */
+	long files;      /**< Files dumped.                 */
+	long bytes;      /**< Bytes dumped.                 */
+	int errors;      /**< Files that could not be read. */
+} dump;
+
+/**
+ * @brief Prints a chunk of a file in base64.
+ */
+static void encode(const unsigned char *buf, size_t n)
+{
+	static const char digits[] =
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	char line[(GCDA_LINE/3)*4 + 1];
+	char *p = line;
+
+	for (size_t i = 0; i < n; i += 3)
+	{
+		unsigned v = buf[i] << 16;
+
+		if (i + 1 < n)
+			v |= buf[i + 1] << 8;
+		if (i + 2 < n)
+			v |= buf[i + 2];
+
+		*p++ = digits[(v >> 18) & 63];
+		*p++ = digits[(v >> 12) & 63];
+		*p++ = (i + 1 < n) ? digits[(v >> 6) & 63] : '=';
+		*p++ = (i + 2 < n) ? digits[v & 63] : '=';
+	}
+	*p = '\0';
+
+	printf("gcda + %s\n", line);
+}
+
+/**
+ * @brief Dumps a profile file.
+ */
+static int dump_file(const char *path, const struct stat *st, int type, struct FTW *ftw)
+{
+	FILE *fp;
+	size_t n;
+	unsigned char buf[GCDA_LINE];
+	const char *name = path + dump.prefix;
+
+	((void) ftw);
+
+	if ((type != FTW_F) || (strstr(name, ".gcda") == NULL))
+		return (0);
+
+	while (*name == '/')
+		name++;
+
+	if ((fp = fopen(path, "rb")) == NULL)
+	{
+		perror(path);
+		dump.errors++;
+		return (0);
+	}
+
+	printf("gcda begin %s %lld\n", name, (long long) st->st_size);
+	while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+		encode(buf, n);
+	printf("gcda end %s\n", name);
+
+	fclose(fp);
+
+	dump.files++;
+	dump.bytes += st->st_size;
+
+	return (0);
+}
+
+/**
+ * @brief Dumps gcov profiles to the standard output.
+ *
+ * @details Usage: gcdadump [dir]
+ *
+ * Prints every .gcda file under dir (by default, where instrumented
+ * userland writes them) as "gcda begin path size", base64 lines of
+ * "gcda + data" and "gcda end path", with paths relative to dir, and
+ * then a "gcda done" line. tools/pgo.sh reads them back from the
+ * console log. A missing directory dumps nothing, so a build that is
+ * not instrumented still ends its run with the "gcda done" line.
+ */
+int main(int argc, char **argv)
+{
+	const char *dir = GCDA_DIR;
+	struct stat st;
+
+	if (argc > 2)
+	{
+		fprintf(stderr, "usage: gcdadump [dir]\n");
+		return (EXIT_FAILURE);
+	}
+	if (argc == 2)
+		dir = argv[1];
+
+	dump.prefix = strlen(dir);
+	if ((stat(dir, &st) == 0) && (nftw(dir, dump_file, 16, FTW_PHYS) < 0))
+	{
+		perror(dir);
+		dump.errors++;
+	}
+
+	printf("gcda done files=%ld bytes=%ld errors=%d\n", dump.files, dump.bytes, dump.errors);
+
+	return ((dump.errors > 0) ? EXIT_FAILURE : EXIT_SUCCESS);
+}
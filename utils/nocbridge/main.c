@@ -0,0 +1,229 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/types.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <bridge.h>
+#include <noc.h>
+
+/**
+ * @brief Bridge state.
+ */
+static struct
+{
+	int fd;                      /**< Serial line.            */
+	uint64_t tx;                 /**< Messages to the host.   */
+	uint64_t rx;                 /**< Messages from the host. */
+	struct bridge_batch batch;   /**< Batch to the host.      */
+	struct bridge_reader reader; /**< Stream from the host.   */
+} bridge;
+
+/**
+ * @brief Prints usage and exits.
+ */
+static void usage(void)
+{
+	fprintf(stderr, "usage: nocbridge [-d device]\n");
+	fprintf(stderr, "       nocbridge -e\n");
+	exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Exits on error.
+ */
+static void die(const char *msg)
+{
+	perror(msg);
+	exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Forwards NoC messages to the host.
+ *
+ * @details Messages are batched for as long as more traffic is
+ * pending, so a burst costs a few large writes to the serial line
+ * rather than one per message.
+ */
+static void *to_host(void *arg)
+{
+	int src, port;
+	void *data;
+	ssize_t len;
+
+	((void) arg);
+
+	while ((len = noc_recv_buf(&src, &port, &data)) >= 0)
+	{
+		if (bridge_batch_add(&bridge.batch, src, port, data, len) < 0)
+		{
+			if (bridge_batch_flush(&bridge.batch, bridge.fd) < 0)
+				die("write");
+			bridge_batch_add(&bridge.batch, src, port, data, len);
+		}
+		noc_buf_free(data);
+		bridge.tx++;
+
+		if (noc_poll(0) == 0)
+		{
+			if (bridge_batch_flush(&bridge.batch, bridge.fd) < 0)
+				die("write");
+		}
+	}
+
+	die("noc_recv_buf");
+
+	return (NULL);
+}
+
+/**
+ * @brief Forwards host messages to the NoC.
+ */
+static void from_host(void)
+{
+	int tile, port;
+	size_t len;
+	ssize_t n;
+	const void *data;
+
+	while ((n = bridge_read(&bridge.reader, bridge.fd)) > 0)
+	{
+		while ((data = bridge_next(&bridge.reader, &tile, &port, &len)) != NULL)
+		{
+			if (noc_send(tile, port, data, len) < 0)
+			{
+				perror("noc_send");
+				continue;
+			}
+			bridge.rx++;
+		}
+	}
+
+	/* A pseudo terminal reports a hang up as EIO. */
+	if ((n < 0) && (errno != EIO))
+		die("read");
+}
+
+/**
+ * @brief Echoes bridge traffic back to its sender.
+ */
+static void echo(void)
+{
+	int src, port;
+	void *data;
+	ssize_t len;
+
+	while ((len = noc_recv_buf(&src, &port, &data)) >= 0)
+	{
+		if ((port == NOC_PORT_BRIDGE) && (noc_send(src, NOC_PORT_BRIDGE, data, len) < 0))
+			perror("noc_send");
+		noc_buf_free(data);
+	}
+
+	die("noc_recv_buf");
+}
+
+/**
+ * @brief Bridges the NoC to the host.
+ *
+ * @details Usage: nocbridge [-d device] | nocbridge -e
+ *
+ * Runs on the tile whose serial line is wired to the host. Messages
+ * batched by the host are sent to the tiles they are addressed to,
+ * and every message that reaches this tile is batched back to the host
+ * with its source tile and port. With -e, the utility instead echoes
+ * NOC_PORT_BRIDGE messages to their sender, which is how the other
+ * tiles answer the host load generator (tools/nocload.c).
+ */
+int main(int argc, char **argv)
+{
+	int opt;
+	int echoing = 0;
+	pthread_t tid;
+	struct termios tio;
+	const char *device = BRIDGE_DEVICE;
+
+	while ((opt = getopt(argc, argv, "d:e")) != -1)
+	{
+		switch (opt)
+		{
+			case 'd':
+				device = optarg;
+				break;
+			case 'e':
+				echoing = 1;
+				break;
+			default:
+				usage();
+		}
+	}
+
+	if (noc_init() < 0)
+		die("noc_init");
+
+	if (echoing)
+		echo();
+
+	/* The initramfs only comes with a console. */
+	if (strcmp(device, BRIDGE_DEVICE) == 0)
+	{
+		if ((mkdir("/dev", S_IRWXU) != 0) && (errno != EEXIST))
+			die("/dev");
+		if ((mknod(device, S_IFCHR | S_IRUSR | S_IWUSR, makedev(BRIDGE_MAJOR, BRIDGE_MINOR)) != 0) &&
+			(errno != EEXIST))
+			die(device);
+	}
+
+	if ((bridge.fd = open(device, O_RDWR | O_NOCTTY)) < 0)
+		die(device);
+
+	/* Binary data: no line discipline. */
+	if (tcgetattr(bridge.fd, &tio) == 0)
+	{
+		cfmakeraw(&tio);
+		tcsetattr(bridge.fd, TCSANOW, &tio);
+	}
+
+	bridge_batch_init(&bridge.batch);
+	bridge_reader_init(&bridge.reader);
+
+	if ((errno = pthread_create(&tid, NULL, to_host, NULL)) != 0)
+		die("pthread_create");
+
+	from_host();
+
+	fprintf(stderr, "nocbridge: host hung up, rx=%" PRIu64 " tx=%" PRIu64
+		" batches=%" PRIu64 " resyncs=%" PRIu64 "\n",
+		bridge.rx, bridge.tx, bridge.reader.batches, bridge.reader.resyncs);
+
+	/*
+	 * The other thread may still be receiving from the NoC or writing
+	 * to the host, and a poll mode receiver cannot be cancelled: exit
+	 * without finalizing, and let the kernel release the NoC.
+	 */
+	return (EXIT_SUCCESS);
+}
@@ -0,0 +1,193 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <noc.h>
+
+/**
+ * @brief Prints usage and exits.
+ */
+static void usage(void)
+{
+	fprintf(stderr, "usage: noccat [-c] tile [file]\n");
+	fprintf(stderr, "       noccat -l\n");
+	exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Sends with a plain read/send loop.
+ */
+static int send_copy(int dest, int fd)
+{
+	ssize_t n;
+	static uint8_t buf[NOC_SENDFILE_CHUNK];
+
+	while ((n = read(fd, buf, sizeof(buf))) != 0)
+	{
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return (-1);
+		}
+
+		if (noc_send(dest, NOC_PORT_CAT, buf, n) < 0)
+			return (-1);
+	}
+
+	return (0);
+}
+
+/**
+ * @brief Sends with noc_sendfile().
+ */
+static int send_file(int dest, int fd)
+{
+	ssize_t n;
+
+	while ((n = noc_sendfile(dest, NOC_PORT_CAT, fd, SIZE_MAX)) != 0)
+	{
+		if (n < 0)
+			return (-1);
+	}
+
+	return (0);
+}
+
+/**
+ * @brief Writes incoming streams to the standard output.
+ *
+ * @details Stops at the first end of stream (an empty message).
+ */
+static int listen_noc(void)
+{
+	int port;
+	void *data;
+	ssize_t len;
+
+	while ((len = noc_recv_buf(NULL, &port, &data)) >= 0)
+	{
+		ssize_t off = 0;
+
+		if (port != NOC_PORT_CAT)
+		{
+			noc_buf_free(data);
+			continue;
+		}
+
+		/* End of stream. */
+		if (len == 0)
+		{
+			noc_buf_free(data);
+			return (0);
+		}
+
+		while (off < len)
+		{
+			ssize_t n = write(STDOUT_FILENO, (uint8_t *) data + off, len - off);
+
+			if (n < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				noc_buf_free(data);
+				return (-1);
+			}
+			off += n;
+		}
+
+		noc_buf_free(data);
+	}
+
+	return (-1);
+}
+
+/**
+ * @brief Copies a file or the standard input to another tile.
+ *
+ * @details Usage: noccat [-c] tile [file] | noccat -l
+ *
+ * The sender uses noc_sendfile(), or a read/send copy loop with -c. The
+ * end of the stream is marked by an empty message. With -l, the
+ * received stream is written to the standard output.
+ */
+int main(int argc, char **argv)
+{
+	int opt, ret;
+	int copy = 0, listen = 0;
+	int fd = STDIN_FILENO;
+	int dest;
+
+	while ((opt = getopt(argc, argv, "cl")) != -1)
+	{
+		switch (opt)
+		{
+			case 'c':
+				copy = 1;
+				break;
+			case 'l':
+				listen = 1;
+				break;
+			default:
+				usage();
+		}
+	}
+
+	if (listen ? (optind != argc) : ((optind == argc) || (argc - optind > 2)))
+		usage();
+
+	if (noc_init() < 0)
+	{
+		perror("noccat: noc_init");
+		return (EXIT_FAILURE);
+	}
+
+	if (listen)
+	{
+		ret = listen_noc();
+		noc_finalize();
+		if (ret < 0)
+			perror("noccat");
+		return ((ret < 0) ? EXIT_FAILURE : EXIT_SUCCESS);
+	}
+
+	dest = atoi(argv[optind]);
+	if ((optind + 1 < argc) && ((fd = open(argv[optind + 1], O_RDONLY)) < 0))
+	{
+		perror(argv[optind + 1]);
+		return (EXIT_FAILURE);
+	}
+
+	ret = copy ? send_copy(dest, fd) : send_file(dest, fd);
+	if ((ret == 0) && (noc_send(dest, NOC_PORT_CAT, NULL, 0) < 0))
+		ret = -1;
+
+	if (ret < 0)
+		perror("noccat");
+
+	if (fd != STDIN_FILENO)
+		close(fd);
+	noc_finalize();
+
+	return ((ret < 0) ? EXIT_FAILURE : EXIT_SUCCESS);
+}
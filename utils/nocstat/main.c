@@ -0,0 +1,111 @@
+/**
+ * Copyright(C) 2017 Pedro H. Penna <pedrohenriquepenna@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <metrics.h>
+
+/**
+ * @brief Prints usage and exits.
+ */
+static void usage(void)
+{
+	fprintf(stderr, "usage: nocstat [-p] [interval]\n");
+	exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Prints the metrics of every tile.
+ */
+static void print(const struct metrics_tile *tiles, int n, int ports)
+{
+	printf("tile  cpu%%  iow%%  run  blk  mem_kb/free_kb  loop part  tx_Bps  rx_Bps   age  lost\n");
+
+	for (int i = 0; i < n; i++)
+	{
+		const struct metrics_tile *t = &tiles[i];
+
+		if (t->records == 0)
+		{
+			printf("%4d  -\n", i);
+			continue;
+		}
+
+		printf("%4d %5.1f %5.1f %4u %4u %7" PRIu32 "/%-7" PRIu32 " %4u %4u %7" PRIu32 " %7" PRIu32 " %5" PRIu32 " %5" PRIu32 "\n",
+			i, t->busy/10.0, t->iowait/10.0, t->procs_running, t->procs_blocked,
+			t->mem_total, t->mem_free, t->loop_depth, t->partials,
+			t->tx_rate, t->rx_rate, t->age, t->lost);
+
+		if (!ports)
+			continue;
+
+		for (int p = 0; p < NOC_STATS_PORTS; p++)
+		{
+			if ((t->ports[p].tx_msgs | t->ports[p].rx_msgs) == 0)
+				continue;
+
+			printf("      port %2d tx %" PRIu64 " msgs %" PRIu64 " bytes, rx %" PRIu64 " msgs %" PRIu64 " bytes\n",
+				p, t->ports[p].tx_msgs, t->ports[p].tx_bytes,
+				t->ports[p].rx_msgs, t->ports[p].rx_bytes);
+		}
+	}
+}
+
+/**
+ * @brief Shows the metrics gathered by the collector.
+ *
+ * @details Usage: nocstat [-p] [interval]
+ *
+ * Must run on the collector tile. Prints the table once, or every
+ * interval seconds. With -p, lists the traffic of each port.
+ */
+int main(int argc, char **argv)
+{
+	int n;
+	int ports = 0;
+	long interval = 0;
+	static struct metrics_tile tiles[NOC_MAX_TILES];
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-p") == 0)
+			ports = 1;
+		else if ((interval = atol(argv[i])) <= 0)
+			usage();
+	}
+
+	do
+	{
+		if ((n = metrics_fetch(tiles, NOC_MAX_TILES)) < 0)
+		{
+			perror("nocstat");
+			return (EXIT_FAILURE);
+		}
+
+		print(tiles, n, ports);
+		fflush(stdout);
+
+		if (interval > 0)
+			sleep(interval);
+	} while (interval > 0);
+
+	return (EXIT_SUCCESS);
+}